@@ -0,0 +1,341 @@
+// Microbenchmarks for the Message and NetworkManager hot paths.
+//
+// Every benchmark is data-driven over increasing input sizes, so the
+// results show how the cost grows, not just a single point.
+//
+//   ./build/benchmarks/benchmarks                        # QtTest text output
+//   ./build/benchmarks/benchmarks --json results.json    # plus machine-readable JSON
+//
+// Any other QtTest option (-iterations, -minimumvalue, -tickcounter, ...) is passed through.
+
+#include <QtTest/QtTest>
+#include <QLoggingCategory>
+#include <QXmlStreamReader>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include "message.h"
+#include "networkmanager.h"
+
+class BenchNetworkManager : public QObject {
+    Q_OBJECT
+
+private:
+    static const quint16 BENCH_PORT = 47901;
+    static const quint16 SINK_PORT = 47902;  // Replies are sent here and never read
+
+    // Fill the store with `count` messages spread over ten origins
+    static void fillStore(NetworkManager& nm, int count) {
+        for (int i = 0; i < count; ++i) {
+            Message message(QString("payload %1").arg(i), QString("Origin%1").arg(i % 10), "broadcast", i / 10 + 1);
+            message.setMessageId(message.generateMessageId());
+            nm.storeMessage(message);
+            nm.updateVectorClock(message.getOrigin(), message.getSequenceNumber());
+        }
+    }
+
+    // `count` destinations, all reachable through one neighbour
+    static void fillRoutes(NetworkManager& nm, int count) {
+        nm.addPeer("Neighbor", "127.0.0.1", SINK_PORT);
+        for (int i = 0; i < count; ++i) {
+            nm.updateRoutingTable(QString("Dest%1").arg(i), 2, "Neighbor", "127.0.0.1", SINK_PORT, false, 2);
+        }
+    }
+
+private slots:
+    void initTestCase() {
+        // Per-message qDebug() lines would dominate the hot paths being measured
+        QLoggingCategory::setFilterRules("default.debug=false");
+    }
+
+    // ---- Message serialization ----
+
+    void messageToDatagram_data() {
+        QTest::addColumn<int>("size");
+        for (int size : {16, 256, 4096}) {
+            QTest::newRow(QByteArray::number(size)) << size;
+        }
+    }
+
+    void messageToDatagram() {
+        QFETCH(int, size);
+        Message message(QString(size, QChar('x')), "Node1", "Node2", 1);
+        message.setMessageId(message.generateMessageId());
+        message.setVectorClock(QVariantMap{{"Node1", 1}, {"Node2", 5}, {"Node3", 9}});
+        QBENCHMARK {
+            QByteArray datagram = message.toDatagram();
+            Q_UNUSED(datagram);
+        }
+    }
+
+    void messageFromDatagram_data() {
+        messageToDatagram_data();
+    }
+
+    void messageFromDatagram() {
+        QFETCH(int, size);
+        Message message(QString(size, QChar('x')), "Node1", "Node2", 1);
+        message.setMessageId(message.generateMessageId());
+        message.setVectorClock(QVariantMap{{"Node1", 1}, {"Node2", 5}, {"Node3", 9}});
+        QByteArray datagram = message.toDatagram();
+        QBENCHMARK {
+            Message parsed = Message::fromDatagram(datagram);
+            Q_UNUSED(parsed);
+        }
+    }
+
+    void routeAdvertisementFromDatagram_data() {
+        QTest::addColumn<int>("size");
+        for (int size : {10, 50, 200}) {
+            QTest::newRow(QByteArray::number(size)) << size;
+        }
+    }
+
+    void routeAdvertisementFromDatagram() {
+        QFETCH(int, size);
+        Message advertisement("", "Node1", "Node2", 2, Message::ROUTE_ADVERTISEMENT);
+        QVariantList entries;
+        for (int i = 0; i < size; ++i) {
+            entries.append(QVariantMap{{"Dest", QString("Dest%1").arg(i)}, {"SeqNo", 2}, {"Hops", 1}});
+        }
+        advertisement.setRouteEntries(entries);
+        QByteArray datagram = advertisement.toDatagram();
+        QBENCHMARK {
+            Message parsed = Message::fromDatagram(datagram);
+            Q_UNUSED(parsed);
+        }
+    }
+
+    // ---- Receive path, one row per message type ----
+
+    void processReceivedMessage_data() {
+        QTest::addColumn<QByteArray>("datagram");
+
+        Message chat("already seen", "Node2", "broadcast", 1);
+        chat.setMessageId(chat.generateMessageId());
+        QTest::newRow("CHAT_MESSAGE (duplicate)") << chat.toDatagram();
+
+        Message ack("", "Node2", "BenchNode", 1, Message::ACK);
+        ack.setMessageId("BenchNode_1");
+        QTest::newRow("ACK") << ack.toDatagram();
+
+        Message request("", "Node2", "BenchNode", 0, Message::ANTI_ENTROPY_REQUEST);
+        request.setVectorClock(QVariantMap{{"Node2", 1}});
+        QTest::newRow("ANTI_ENTROPY_REQUEST") << request.toDatagram();
+
+        Message rumor("", "Node2", "broadcast", 2, Message::ROUTE_RUMOR);
+        QTest::newRow("ROUTE_RUMOR (duplicate)") << rumor.toDatagram();
+
+        Message advertisement("", "Node2", "BenchNode", 2, Message::ROUTE_ADVERTISEMENT);
+        QVariantList entries;
+        for (int i = 0; i < 20; ++i) {
+            entries.append(QVariantMap{{"Dest", QString("Dest%1").arg(i)}, {"SeqNo", 2}, {"Hops", 1}});
+        }
+        advertisement.setRouteEntries(entries);
+        QTest::newRow("ROUTE_ADVERTISEMENT (20 routes)") << advertisement.toDatagram();
+
+        Message probe("", "Node2", "BenchNode", 7, Message::LINK_PROBE);
+        QTest::newRow("LINK_PROBE") << probe.toDatagram();
+
+        Message ihave("", "Node2", "BenchNode", 0, Message::GOSSIP_IHAVE);
+        ihave.setMessageIds(QStringList() << chat.getMessageId());
+        QTest::newRow("GOSSIP_IHAVE (known)") << ihave.toDatagram();
+    }
+
+    void processReceivedMessage() {
+        QFETCH(QByteArray, datagram);
+        NetworkManager nm;
+        nm.setNodeId("BenchNode");
+        QVERIFY(nm.startServer(BENCH_PORT));
+
+        // Prime the state so repeated deliveries take the steady-state path
+        Message message = Message::fromDatagram(datagram);
+        QHostAddress sender(QHostAddress::LocalHost);
+        Message chat("already seen", "Node2", "broadcast", 1);
+        chat.setMessageId(chat.generateMessageId());
+        nm.processReceivedMessage(chat, sender, SINK_PORT);
+        nm.processReceivedMessage(message, sender, SINK_PORT);
+
+        QBENCHMARK {
+            nm.processReceivedMessage(message, sender, SINK_PORT);
+        }
+    }
+
+    // ---- Anti-entropy: planning what a peer is missing (replaces getMissingMessages) ----
+
+    void catchUpPlanning_data() {
+        QTest::addColumn<int>("size");
+        for (int size : {100, 1000, 10000}) {
+            QTest::newRow(QByteArray::number(size)) << size;
+        }
+    }
+
+    void catchUpPlanning() {
+        QFETCH(int, size);
+        NetworkManager nm;
+        nm.setNodeId("BenchNode");
+        fillStore(nm, size);
+
+        // The peer has the first half of every origin
+        QVariantMap remoteClock;
+        for (int origin = 0; origin < 10; ++origin) {
+            remoteClock[QString("Origin%1").arg(origin)] = size / 20;
+        }
+
+        QHostAddress peer(QHostAddress::LocalHost);
+        QBENCHMARK {
+            nm.queueCatchUp("Peer", peer, SINK_PORT, remoteClock, QVariantMap());
+            nm.catchUpStreams.clear();
+        }
+    }
+
+    void ibltBuild_data() {
+        catchUpPlanning_data();
+    }
+
+    void ibltBuild() {
+        QFETCH(int, size);
+        NetworkManager nm;
+        nm.setNodeId("BenchNode");
+        fillStore(nm, size);
+
+        QBENCHMARK {
+            Iblt table = nm.buildIblt(QVariantMap(), NetworkManager::INITIAL_IBLT_CELLS);
+            Q_UNUSED(table);
+        }
+    }
+
+    // ---- Routing ----
+
+    void updateRoutingTable_data() {
+        QTest::addColumn<int>("size");
+        for (int size : {10, 100, 1000, 10000}) {
+            QTest::newRow(QByteArray::number(size)) << size;
+        }
+    }
+
+    void updateRoutingTable() {
+        QFETCH(int, size);
+        NetworkManager nm;
+        nm.setNodeId("BenchNode");
+        fillRoutes(nm, size);
+
+        // A fresher sequence number for an existing destination over the same path
+        QString destination = QString("Dest%1").arg(size / 2);
+        int seqNo = 2;
+        QBENCHMARK {
+            seqNo += 2;
+            nm.updateRoutingTable(destination, seqNo, "Neighbor", "127.0.0.1", SINK_PORT, false, 2);
+        }
+    }
+
+    void forwardMessage_data() {
+        updateRoutingTable_data();
+    }
+
+    void forwardMessage() {
+        QFETCH(int, size);
+        NetworkManager nm;
+        nm.setNodeId("BenchNode");
+        QVERIFY(nm.startServer(BENCH_PORT));
+        fillRoutes(nm, size);
+
+        Message message("in transit", "Node2", QString("Dest%1").arg(size / 2), 1);
+        message.setMessageId(message.generateMessageId());
+        QBENCHMARK {
+            Message copy = message;  // forwardMessage() decrements the hop limit
+            nm.forwardMessage(copy);
+        }
+    }
+};
+
+namespace {
+
+// QtTest has no JSON logger; convert its XML benchmark results
+bool writeJsonResults(const QString& xmlPath, const QString& jsonPath) {
+    QFile xmlFile(xmlPath);
+    if (!xmlFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QJsonArray results;
+    QString function;
+    QXmlStreamReader xml(&xmlFile);
+    while (!xml.atEnd()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement) {
+            continue;
+        }
+        if (xml.name() == QLatin1String("TestFunction")) {
+            function = xml.attributes().value("name").toString();
+        } else if (xml.name() == QLatin1String("BenchmarkResult")) {
+            QXmlStreamAttributes attributes = xml.attributes();
+            QString tag = attributes.value("tag").toString();
+            double value = attributes.value("value").toDouble();
+            double iterations = attributes.value("iterations").toDouble();
+
+            QJsonObject result;
+            result["benchmark"] = function;
+            result["tag"] = tag;
+            bool numeric = false;
+            int size = tag.toInt(&numeric);
+            if (numeric) {
+                result["n"] = size;  // Input size, for plotting growth
+            }
+            result["metric"] = attributes.value("metric").toString();
+            result["iterations"] = iterations;
+            result["total"] = value;
+            result["perIteration"] = iterations > 0 ? value / iterations : value;
+            results.append(result);
+        }
+    }
+    if (xml.hasError()) {
+        return false;
+    }
+
+    QJsonObject root;
+    root["suite"] = "BenchNetworkManager";
+    root["qtVersion"] = QString(qVersion());
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["results"] = results;
+
+    QFile jsonFile(jsonPath);
+    if (!jsonFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    jsonFile.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QStringList arguments = app.arguments();
+    QString jsonPath;
+    int jsonIndex = arguments.indexOf("--json");
+    if (jsonIndex >= 0 && jsonIndex + 1 < arguments.size()) {
+        jsonPath = arguments.at(jsonIndex + 1);
+        arguments.removeAt(jsonIndex + 1);
+        arguments.removeAt(jsonIndex);
+    }
+
+    BenchNetworkManager bench;
+    if (jsonPath.isEmpty()) {
+        return QTest::qExec(&bench, arguments);
+    }
+
+    // Keep the usual console output and capture XML alongside it
+    QString xmlPath = jsonPath + ".xml";
+    arguments << "-o" << "-,txt" << "-o" << xmlPath + ",xml";
+    int status = QTest::qExec(&bench, arguments);
+
+    if (!writeJsonResults(xmlPath, jsonPath)) {
+        qWarning("Could not convert %s to JSON", qPrintable(xmlPath));
+        return status != 0 ? status : 1;
+    }
+    QFile::remove(xmlPath);
+    return status;
+}
+
+#include "benchmarks.moc"
@@ -21,6 +21,7 @@ make -j$(nproc 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || echo 4) || { echo
 echo ""
 echo "Build successful!"
 echo "Executable: build/SimpleChat_PA3"
+echo "Headless daemon: build/SimpleChat_PA3_headless"
 echo ""
 echo "To run a single node:"
 echo "  ./build/SimpleChat_PA3 -p 9001"
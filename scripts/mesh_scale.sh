@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Release validation: run the mesh harness at increasing node counts and
+# keep one JSON report per size.
+#
+#   ./scripts/mesh_scale.sh                      # 10 50 100 200 nodes, random topology
+#   TOPOLOGY=grid ./scripts/mesh_scale.sh 25 100 400
+
+HARNESS=./build/tools/simplechat_meshharness
+TOPOLOGY=${TOPOLOGY:-random}
+DURATION=${DURATION:-20}
+RATE=${RATE:-50}
+RESTARTS=${RESTARTS:-2}
+OUT_DIR=${OUT_DIR:-mesh-results}
+SIZES=${@:-10 50 100 200}
+
+if [ ! -x "$HARNESS" ]; then
+    echo "Harness not found at $HARNESS - run ./scripts/build.sh first"
+    exit 1
+fi
+
+# Every node holds a socket, a control connection and its log open
+ulimit -n 8192 2>/dev/null || echo "Warning: could not raise the open file limit"
+
+mkdir -p "$OUT_DIR"
+STATUS=0
+for NODES in $SIZES; do
+    REPORT="$OUT_DIR/mesh-$TOPOLOGY-$NODES.json"
+    echo "Running $NODES nodes ($TOPOLOGY)..."
+    "$HARNESS" --nodes "$NODES" --topology "$TOPOLOGY" --duration "$DURATION" --rate "$RATE" \
+        --restarts "$RESTARTS" --json > "$REPORT" || STATUS=1
+    python3 - "$REPORT" <<'PY' 2>/dev/null || echo "  report: $REPORT"
+import json, sys
+r = json.load(open(sys.argv[1]))
+t = r["traffic"]
+print("  converged in %.1f s, delivery %.2f%%, p99 %.1f ms" % (r["convergenceMs"] / 1000.0, t["deliveryRatio"] * 100, t["latencyP99Ms"]))
+PY
+done
+
+echo ""
+echo "Reports in $OUT_DIR/"
+exit $STATUS
@@ -0,0 +1,167 @@
+#include "chatdaemon.h"
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QDateTime>
+#include <QFile>
+#include <QDebug>
+#include <cstdio>
+
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+FILE* logStream = stdout;
+
+void writeLogLine(QtMsgType type, const QMessageLogContext&, const QString& text) {
+    static const char* const levels[] = {"DEBUG", "WARN", "CRIT", "FATAL", "INFO"};
+    int level = static_cast<int>(type);
+    QByteArray line = QString("%1 %2 %3\n")
+                          .arg(QDateTime::currentDateTime().toString(Qt::ISODateWithMs))
+                          .arg(level >= 0 && level <= 4 ? levels[level] : "LOG")
+                          .arg(text)
+                          .toUtf8();
+    std::fwrite(line.constData(), 1, static_cast<size_t>(line.size()), logStream);
+    std::fflush(logStream);
+}
+
+#ifdef Q_OS_UNIX
+int signalPipe[2] = {-1, -1};
+
+void forwardSignal(int) {
+    // Only async-signal-safe work here; the event loop picks it up from the pipe
+    char byte = 1;
+    ssize_t ignored = ::write(signalPipe[0], &byte, 1);
+    (void)ignored;
+}
+#endif
+
+}
+
+ChatDaemon::ChatDaemon(const NodeConfig& nodeConfig, QObject* parent)
+    : QObject(parent), config(nodeConfig), networkManager(nullptr), controlServer(nullptr),
+      metricsServer(nullptr), signalNotifier(nullptr) {
+
+    networkManager = new NetworkManager(this);
+    networkManager->setNodeId(config.nodeId());
+
+    if (config.noForwardMode) {
+        networkManager->setNoForwardMode(true);
+    }
+
+    // Connected first: the warm start below announces restored peers
+    connect(networkManager, &NetworkManager::messageReceived, this, &ChatDaemon::onMessageReceived);
+    connect(networkManager, &NetworkManager::peerDiscovered, this, &ChatDaemon::onPeerDiscovered);
+    connect(networkManager, &NetworkManager::peerStatusChanged, this, &ChatDaemon::onPeerStatusChanged);
+
+    // Resume from the on-disk log, if enabled
+    if (!config.dataDir.isEmpty() && !networkManager->enablePersistence(config.dataDir, config.syncPolicy)) {
+        qDebug() << "Failed to open message log in" << config.dataDir << "- running without persistence";
+    }
+
+    if (!config.captureFile.isEmpty() && !networkManager->enableCapture(config.captureFile)) {
+        qDebug() << "Failed to open capture file" << config.captureFile;
+    }
+
+    networkManager->setPacketLogging(config.verbose);
+    networkManager->setDeliveryTraceRate(config.deliveryTraceRate);
+    if (!config.traceFile.isEmpty()) {
+        networkManager->enableTrace(config.traceFile);
+    }
+}
+
+bool ChatDaemon::start() {
+    if (!networkManager->startServer(config.port)) {
+        qDebug() << "Failed to start server on port" << config.port;
+        return false;
+    }
+
+    if (!config.controlSocket.isEmpty()) {
+        controlServer = new ControlServer(networkManager, this);
+        if (!controlServer->listen(config.controlSocket)) {
+            return false;
+        }
+    }
+
+    if (config.metricsPort > 0 || !config.metricsFile.isEmpty()) {
+        metricsServer = new MetricsServer(networkManager, this);
+        if (config.metricsPort > 0 && !metricsServer->listen(static_cast<quint16>(config.metricsPort))) {
+            return false;
+        }
+        if (!config.metricsFile.isEmpty()) {
+            metricsServer->setDumpFile(config.metricsFile);
+        }
+    }
+
+    QString modeStr = config.noForwardMode ? " (RENDEZVOUS SERVER MODE)" : " with DSDV Routing";
+    qDebug().noquote() << QString("[DAEMON] SimpleChat P2P Node %1 started headless on port %2%3")
+                           .arg(config.nodeId()).arg(config.port).arg(modeStr);
+
+    QList<int> discoveryPorts = config.discoveryPorts();
+    if (discoveryPorts.isEmpty()) {
+        qDebug().noquote() << "[DAEMON] Waiting for incoming connections (rendezvous mode)...";
+    } else {
+        networkManager->discoverLocalPeers(discoveryPorts);
+    }
+    return true;
+}
+
+bool ChatDaemon::installLogHandler(const QString& logFile) {
+    if (!logFile.isEmpty()) {
+        FILE* file = std::fopen(QFile::encodeName(logFile).constData(), "a");
+        if (!file) {
+            return false;
+        }
+        logStream = file;
+    }
+
+    qInstallMessageHandler(writeLogLine);
+    return true;
+}
+
+void ChatDaemon::installSignalHandlers() {
+#ifdef Q_OS_UNIX
+    if (signalNotifier || ::socketpair(AF_UNIX, SOCK_STREAM, 0, signalPipe) != 0) {
+        return;
+    }
+
+    signalNotifier = new QSocketNotifier(signalPipe[1], QSocketNotifier::Read, this);
+    connect(signalNotifier, &QSocketNotifier::activated, this, &ChatDaemon::onTerminationSignal);
+
+    struct sigaction action = {};
+    action.sa_handler = forwardSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+#endif
+}
+
+void ChatDaemon::onTerminationSignal() {
+#ifdef Q_OS_UNIX
+    char byte;
+    ssize_t ignored = ::read(signalPipe[1], &byte, 1);
+    (void)ignored;
+#endif
+    qDebug().noquote() << "[DAEMON] Shutting down";
+    QCoreApplication::quit();
+}
+
+void ChatDaemon::onMessageReceived(const Message& message) {
+    if (message.isBroadcast()) {
+        qDebug().noquote() << QString("[RECV] Broadcast from %1: %2").arg(message.getOrigin(), message.getChatText());
+    } else {
+        qDebug().noquote() << QString("[RECV] Message from %1: %2").arg(message.getOrigin(), message.getChatText());
+    }
+}
+
+void ChatDaemon::onPeerDiscovered(const QString& peerId, const QString& host, int port) {
+    qDebug().noquote() << QString("[DAEMON] Discovered peer: %1 at %2:%3").arg(peerId).arg(host).arg(port);
+}
+
+void ChatDaemon::onPeerStatusChanged(const QString& peerId, bool active) {
+    qDebug().noquote() << QString("[DAEMON] Peer %1 is now %2").arg(peerId, active ? "active" : "inactive");
+}
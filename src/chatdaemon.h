@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QObject>
+#include "networkmanager.h"
+#include "nodeconfig.h"
+#include "controlserver.h"
+#include "metrics.h"
+
+class QSocketNotifier;
+
+// Headless node: NetworkManager under QCoreApplication, no widgets.
+// Used for relays and rendezvous servers on machines without a display.
+class ChatDaemon : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ChatDaemon(const NodeConfig& nodeConfig, QObject* parent = nullptr);
+
+    bool start();
+    NetworkManager* getNetworkManager() const { return networkManager; }
+
+    // Route qDebug() output to stdout, or append it to logFile, with timestamps
+    static bool installLogHandler(const QString& logFile);
+
+    // Quit the event loop on SIGINT/SIGTERM so the store and topology are snapshotted on the way out
+    void installSignalHandlers();
+
+private slots:
+    void onMessageReceived(const Message& message);
+    void onPeerDiscovered(const QString& peerId, const QString& host, int port);
+    void onPeerStatusChanged(const QString& peerId, bool active);
+    void onTerminationSignal();
+
+private:
+    NodeConfig config;
+    NetworkManager* networkManager;
+    ControlServer* controlServer;
+    MetricsServer* metricsServer;
+    QSocketNotifier* signalNotifier;
+};
@@ -0,0 +1,356 @@
+#include "controlserver.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QDebug>
+
+ControlServer::ControlServer(NetworkManager* manager, QObject* parent)
+    : QObject(parent), networkManager(manager) {
+
+    server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(server, &QLocalServer::newConnection, this, &ControlServer::onNewConnection);
+    connect(networkManager, &NetworkManager::messageReceived, this, &ControlServer::onMessageReceived);
+}
+
+ControlServer::~ControlServer() {
+    server->close();
+}
+
+bool ControlServer::listen(const QString& name) {
+    // A socket file left behind by a crashed node would otherwise block the bind
+    QLocalServer::removeServer(name);
+    if (!server->listen(name)) {
+        qDebug() << "Control socket: cannot listen on" << name << ":" << server->errorString();
+        return false;
+    }
+
+    qDebug().noquote() << QString("[CONTROL] Listening on %1").arg(server->fullServerName());
+    return true;
+}
+
+QString ControlServer::serverName() const {
+    return server->fullServerName();
+}
+
+void ControlServer::onNewConnection() {
+    while (QLocalSocket* socket = server->nextPendingConnection()) {
+        clients.insert(socket, Client());
+        connect(socket, &QLocalSocket::readyRead, this, &ControlServer::onReadyRead);
+        connect(socket, &QLocalSocket::disconnected, this, &ControlServer::onDisconnected);
+    }
+}
+
+void ControlServer::onDisconnected() {
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+
+    clients.remove(socket);
+    socket->deleteLater();
+}
+
+void ControlServer::onReadyRead() {
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+    auto clientIt = clients.find(socket);
+    if (clientIt == clients.end()) {
+        return;
+    }
+
+    clientIt->buffer.append(socket->readAll());
+
+    // Answer every complete line from this read with one write
+    QByteArray responses;
+    int start = 0;
+    int newline;
+    while ((newline = clientIt->buffer.indexOf('\n', start)) >= 0) {
+        QByteArray line = clientIt->buffer.mid(start, newline - start).trimmed();
+        start = newline + 1;
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        QJsonParseError parseError;
+        QJsonDocument document = QJsonDocument::fromJson(line, &parseError);
+        QJsonObject response;
+        if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+            response["ok"] = false;
+            response["error"] = QString("invalid JSON: %1").arg(parseError.errorString());
+        } else {
+            QJsonObject request = document.object();
+            response = handleRequest(socket, request);
+            if (request.contains("id")) {
+                response["id"] = request.value("id");
+            }
+        }
+        responses.append(QJsonDocument(response).toJson(QJsonDocument::Compact));
+        responses.append('\n');
+
+        // subscribe/unsubscribe write to the client table; look the client up again
+        clientIt = clients.find(socket);
+        if (clientIt == clients.end()) {
+            return;
+        }
+    }
+    clientIt->buffer.remove(0, start);
+
+    if (!responses.isEmpty()) {
+        socket->write(responses);
+    }
+
+    if (clientIt->buffer.size() > MAX_REQUEST_LINE) {
+        qDebug().noquote() << "[CONTROL] Request line too long, dropping client";
+        socket->disconnectFromServer();
+    }
+}
+
+QJsonObject ControlServer::handleRequest(QLocalSocket* socket, const QJsonObject& request) {
+    QString command = request.value("cmd").toString();
+
+    if (command == "send") {
+        return sendCommand(request);
+    }
+    if (command == "subscribe" || command == "unsubscribe") {
+        clients[socket].subscribed = (command == "subscribe");
+        QJsonObject response;
+        response["ok"] = true;
+        return response;
+    }
+    if (command == "dump-routes") {
+        return dumpRoutes();
+    }
+    if (command == "dump-peers") {
+        return dumpPeers();
+    }
+    if (command == "stats") {
+        return stats();
+    }
+    if (command == "capture") {
+        return captureCommand(request);
+    }
+    if (command == "trace") {
+        return traceCommand(request);
+    }
+    if (command == "delivery-traces") {
+        return dumpDeliveryTraces();
+    }
+
+    QJsonObject response;
+    response["ok"] = false;
+    response["error"] = QString("unknown command '%1'").arg(command);
+    return response;
+}
+
+QJsonObject ControlServer::sendCommand(const QJsonObject& request) {
+    QJsonObject response;
+    QString text = request.value("text").toString();
+    QString destination = request.value("dest").toString("broadcast");
+    if (text.isEmpty() || destination.isEmpty()) {
+        response["ok"] = false;
+        response["error"] = QString("send needs non-empty \"text\" and \"dest\"");
+        return response;
+    }
+
+    QString messageId = networkManager->sendMessage(Message(text, networkManager->getNodeId(), destination, 1));
+    response["ok"] = !messageId.isEmpty();
+    response["messageId"] = messageId;
+    return response;
+}
+
+QJsonObject ControlServer::dumpRoutes() const {
+    QJsonArray routes;
+    const QMap<QString, RouteInfo> table = networkManager->getRoutingTable();
+    for (auto it = table.begin(); it != table.end(); ++it) {
+        const RouteInfo& route = it.value();
+        QJsonObject entry;
+        entry["dest"] = it.key();
+        entry["nextHop"] = route.nextHop;
+        entry["nextHopAddress"] = QString("%1:%2").arg(route.nextHopIP).arg(route.nextHopPort);
+        entry["seqNo"] = route.seqNo;
+        entry["hops"] = route.hopCount;
+        entry["reachable"] = route.isReachable();
+        entry["direct"] = route.isDirect;
+        entry["provisional"] = route.provisional;
+        entry["ageMs"] = static_cast<double>(networkClockMs() - route.lastUpdated);
+
+        QJsonArray alternates;
+        for (const NextHopInfo& alternate : route.alternates) {
+            alternates.append(alternate.peerId);
+        }
+        entry["alternates"] = alternates;
+        routes.append(entry);
+    }
+
+    QJsonObject response;
+    response["ok"] = true;
+    response["routes"] = routes;
+    return response;
+}
+
+QJsonObject ControlServer::dumpPeers() const {
+    QJsonArray peers;
+    const QMap<QString, PeerInfo> known = networkManager->getPeers();
+    for (auto it = known.begin(); it != known.end(); ++it) {
+        const PeerInfo& peer = it.value();
+        QJsonObject entry;
+        entry["peerId"] = it.key();
+        entry["address"] = QString("%1:%2").arg(peer.host).arg(peer.port);
+        entry["active"] = peer.isActive;
+        entry["provisional"] = peer.provisional;
+        entry["rttMs"] = peer.rttEwma;
+        entry["loss"] = peer.lossEwma;
+        entry["linkCost"] = networkManager->getLinkCost(it.key());
+        entry["lastSeenMs"] = static_cast<double>(networkClockMs() - peer.lastSeen);
+        peers.append(entry);
+    }
+
+    QJsonObject response;
+    response["ok"] = true;
+    response["peers"] = peers;
+    return response;
+}
+
+QJsonObject ControlServer::captureCommand(const QJsonObject& request) {
+    QJsonObject response;
+    QString file = request.value("file").toString();
+    if (file.isEmpty()) {
+        networkManager->disableCapture();
+        response["ok"] = true;
+        response["capturing"] = false;
+        return response;
+    }
+
+    if (!networkManager->enableCapture(file)) {
+        response["ok"] = false;
+        response["error"] = QString("cannot open capture file '%1'").arg(file);
+        return response;
+    }
+    response["ok"] = true;
+    response["capturing"] = true;
+    response["file"] = file;
+    return response;
+}
+
+QJsonObject ControlServer::traceCommand(const QJsonObject& request) {
+    QJsonObject response;
+    if (!networkManager->getTrace().isEnabled()) {
+        networkManager->enableTrace();
+    }
+
+    // Without a file this only makes sure recording is on
+    QString file = request.value("file").toString();
+    if (!file.isEmpty() && !networkManager->saveTrace(file)) {
+        response["ok"] = false;
+        response["error"] = QString("cannot write trace file '%1'").arg(file);
+        return response;
+    }
+    response["ok"] = true;
+    response["tracing"] = true;
+    if (!file.isEmpty()) {
+        response["file"] = file;
+    }
+    return response;
+}
+
+QJsonObject ControlServer::dumpDeliveryTraces() const {
+    QJsonArray traces;
+    for (const DeliveryTrace& trace : networkManager->getDeliveryTraces()) {
+        QJsonObject entry;
+        entry["messageId"] = trace.messageId;
+        entry["origin"] = trace.origin;
+        entry["sentUs"] = static_cast<double>(trace.sentUs);
+        entry["deliveredUs"] = static_cast<double>(trace.deliveredUs);
+        entry["latencyMs"] = (trace.deliveredUs - trace.sentUs) / 1000.0;
+
+        // Each hop: time on the wire since the previous departure, then time queued at the relay
+        QJsonArray hops;
+        qint64 previousDepartureUs = trace.sentUs;
+        for (const DeliveryTrace::Hop& hop : trace.hops) {
+            QJsonObject hopJson;
+            hopJson["node"] = hop.nodeId;
+            hopJson["arrivalUs"] = static_cast<double>(hop.arrivalUs);
+            hopJson["departureUs"] = static_cast<double>(hop.departureUs);
+            hopJson["linkMs"] = (hop.arrivalUs - previousDepartureUs) / 1000.0;
+            hopJson["queueMs"] = (hop.departureUs - hop.arrivalUs) / 1000.0;
+            hops.append(hopJson);
+            previousDepartureUs = hop.departureUs;
+        }
+        entry["hops"] = hops;
+        entry["lastLinkMs"] = (trace.deliveredUs - previousDepartureUs) / 1000.0;
+        traces.append(entry);
+    }
+
+    QJsonObject response;
+    response["ok"] = true;
+    response["traces"] = traces;
+    return response;
+}
+
+QJsonObject ControlServer::stats() const {
+    GossipStats gossip = networkManager->getGossipStats();
+    QJsonObject gossipJson;
+    gossipJson["rumorsSent"] = static_cast<double>(gossip.rumorsSent);
+    gossipJson["rumorsReceived"] = static_cast<double>(gossip.rumorsReceived);
+    gossipJson["duplicateRumors"] = static_cast<double>(gossip.duplicateRumors);
+    gossipJson["broadcastDuplicates"] = static_cast<double>(gossip.broadcastDuplicates);
+    gossipJson["ihavesSent"] = static_cast<double>(gossip.ihavesSent);
+    gossipJson["grafts"] = static_cast<double>(gossip.grafts);
+    gossipJson["prunes"] = static_cast<double>(gossip.prunes);
+    gossipJson["digestMismatches"] = static_cast<double>(gossip.digestMismatches);
+    gossipJson["catchUpMessagesSent"] = static_cast<double>(gossip.catchUpMessagesSent);
+    gossipJson["catchUpBytesSent"] = static_cast<double>(gossip.catchUpBytesSent);
+    gossipJson["transitForwarded"] = static_cast<double>(gossip.transitForwarded);
+    gossipJson["transitDuplicates"] = static_cast<double>(gossip.transitDuplicates);
+    gossipJson["nacksSent"] = static_cast<double>(gossip.nacksSent);
+    gossipJson["nackRetransmits"] = static_cast<double>(gossip.nackRetransmits);
+    gossipJson["ackRetransmits"] = static_cast<double>(gossip.ackRetransmits);
+    gossipJson["ackFailures"] = static_cast<double>(gossip.ackFailures);
+
+    StoreStats store = networkManager->getStoreStats();
+    QJsonObject storeJson;
+    storeJson["liveMessages"] = store.liveMessages;
+    storeJson["liveBytes"] = static_cast<double>(store.liveBytes);
+    storeJson["reclaimedMessages"] = static_cast<double>(store.reclaimedMessages);
+    storeJson["reclaimedBytes"] = static_cast<double>(store.reclaimedBytes);
+    storeJson["compactedOrigins"] = store.compactedOrigins;
+
+    TrafficStats traffic = networkManager->getTrafficStats();
+    QJsonObject trafficJson;
+    trafficJson["datagramsSent"] = static_cast<double>(traffic.datagramsSent);
+    trafficJson["bytesSent"] = static_cast<double>(traffic.bytesSent);
+    trafficJson["datagramsReceived"] = static_cast<double>(traffic.datagramsReceived);
+    trafficJson["bytesReceived"] = static_cast<double>(traffic.bytesReceived);
+
+    QJsonObject response;
+    response["ok"] = true;
+    response["nodeId"] = networkManager->getNodeId();
+    response["gossip"] = gossipJson;
+    response["store"] = storeJson;
+    response["traffic"] = trafficJson;
+    response["vectorClock"] = QJsonObject::fromVariantMap(networkManager->getVectorClock());
+    response["antiEntropyIntervalMs"] = networkManager->getAntiEntropyInterval();
+    response["transitCacheSize"] = networkManager->getTransitCacheSize();
+    response["routes"] = networkManager->getRoutingTable().size();
+    response["peers"] = networkManager->getPeers().size();
+    return response;
+}
+
+void ControlServer::onMessageReceived(const Message& message) {
+    QJsonObject event;
+    event["event"] = "delivered";
+    event["messageId"] = message.getMessageId();
+    event["origin"] = message.getOrigin();
+    event["dest"] = message.getDestination();
+    event["seq"] = message.getSequenceNumber();
+    event["text"] = message.getChatText();
+    QByteArray line = QJsonDocument(event).toJson(QJsonDocument::Compact);
+    line.append('\n');
+
+    for (auto it = clients.begin(); it != clients.end(); ++it) {
+        if (it->subscribed) {
+            it.key()->write(line);
+        }
+    }
+}
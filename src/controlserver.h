@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QJsonObject>
+#include "networkmanager.h"
+
+class QLocalServer;
+class QLocalSocket;
+
+// Local control API over a Unix domain socket (a named pipe on Windows).
+//
+// Line-delimited JSON: each request is one object per line,
+//   {"id": 7, "cmd": "send", "dest": "Node2", "text": "hi"}
+// and gets exactly one response line carrying the same "id". Requests may be
+// pipelined: every complete line in a read is answered, in order, with the
+// responses coalesced into a single write. Subscribed clients additionally
+// receive {"event": "delivered", ...} lines as messages are delivered.
+//
+// Commands: send, subscribe, unsubscribe, dump-routes, dump-peers, stats, capture, trace,
+// delivery-traces.
+class ControlServer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ControlServer(NetworkManager* manager, QObject* parent = nullptr);
+    ~ControlServer();
+
+    // name is a socket path, or a bare name placed in the system temp directory
+    bool listen(const QString& name);
+    QString serverName() const;
+    int clientCount() const { return clients.size(); }
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void onMessageReceived(const Message& message);
+
+private:
+    struct Client {
+        QByteArray buffer;  // Bytes after the last complete line
+        bool subscribed;
+
+        Client() : subscribed(false) {}
+    };
+
+    QJsonObject handleRequest(QLocalSocket* socket, const QJsonObject& request);
+    QJsonObject sendCommand(const QJsonObject& request);
+    QJsonObject dumpRoutes() const;
+    QJsonObject dumpPeers() const;
+    QJsonObject stats() const;
+    QJsonObject captureCommand(const QJsonObject& request);
+    QJsonObject traceCommand(const QJsonObject& request);
+    QJsonObject dumpDeliveryTraces() const;
+
+    NetworkManager* networkManager;
+    QLocalServer* server;
+    QHash<QLocalSocket*, Client> clients;
+
+    static const int MAX_REQUEST_LINE = 64 * 1024;  // Longer lines drop the client
+};
@@ -0,0 +1,162 @@
+#include "eventtrace.h"
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+
+namespace {
+
+const quint32 TRACE_MAGIC = 0x53435452;  // "SCTR"
+const quint32 TRACE_VERSION = 1;
+const int MAX_NODES = EventTrace::NO_NODE;  // Index 0xffff is reserved for "none"
+
+const char* const EVENT_NAMES[] = {
+    "UNKNOWN", "SEND", "RECEIVE", "FORWARD", "DROP_HOP_LIMIT", "DROP_NO_ROUTE",
+    "RUMOR_RECEIVED", "RUMOR_FORWARDED", "ROUTE_CHANGED", "ROUTE_UNREACHABLE"};
+static_assert(sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]) == EventTrace::EVENT_COUNT,
+              "EVENT_NAMES must cover every EventTrace::Event");
+static_assert(sizeof(TraceEvent) == 24, "TraceEvent is stored as fixed 24-byte records");
+
+}
+
+EventTrace::EventTrace() : enabled(false), mask(0), written(0), startEpochNs(0) {}
+
+void EventTrace::enable(const QString& ownerId, int capacity) {
+    int size = 1;
+    while (size < capacity && size < (1 << 24)) {
+        size <<= 1;
+    }
+
+    owner = ownerId;
+    ring = QVector<TraceEvent>(size);
+    mask = static_cast<quint64>(size - 1);
+    written.store(0, std::memory_order_relaxed);
+    nodeIndex.clear();
+    nodeNames.clear();
+    startEpochNs = QDateTime::currentMSecsSinceEpoch() * 1000000;
+    monotonic.start();
+    enabled = true;
+}
+
+void EventTrace::disable() {
+    enabled = false;
+}
+
+quint16 EventTrace::intern(const QString& nodeId) {
+    if (nodeId.isEmpty()) {
+        return NO_NODE;
+    }
+    auto it = nodeIndex.constFind(nodeId);
+    if (it != nodeIndex.constEnd()) {
+        return it.value();
+    }
+    if (nodeNames.size() >= MAX_NODES) {
+        return NO_NODE;
+    }
+    quint16 index = static_cast<quint16>(nodeNames.size());
+    nodeNames.append(nodeId);
+    nodeIndex.insert(nodeId, index);
+    return index;
+}
+
+void EventTrace::append(Event event, const QString& node, const QString& peer, quint32 sequence, quint16 value) {
+    quint64 position = written.load(std::memory_order_relaxed);
+    TraceEvent& slot = ring[static_cast<int>(position & mask)];
+    slot.timestampNs = monotonic.nsecsElapsed();
+    slot.sequence = sequence;
+    slot.event = static_cast<quint16>(event);
+    slot.node = intern(node);
+    slot.peer = intern(peer);
+    slot.value = value;
+    written.store(position + 1, std::memory_order_release);
+}
+
+EventTrace::Snapshot EventTrace::snapshot() const {
+    Snapshot snapshot;
+    snapshot.ownerId = owner;
+    snapshot.startEpochNs = startEpochNs;
+    snapshot.nodes = nodeNames;
+
+    quint64 end = written.load(std::memory_order_acquire);
+    quint64 capacity = static_cast<quint64>(ring.size());
+    quint64 begin = end > capacity ? end - capacity : 0;
+    snapshot.overwritten = begin;
+    snapshot.events.reserve(static_cast<int>(end - begin));
+    for (quint64 position = begin; position < end; ++position) {
+        snapshot.events.append(ring[static_cast<int>(position & mask)]);
+    }
+    return snapshot;
+}
+
+bool EventTrace::save(const QString& path) const {
+    Snapshot data = snapshot();
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << TRACE_MAGIC << TRACE_VERSION << data.ownerId << data.startEpochNs << data.overwritten;
+    out << static_cast<quint32>(data.nodes.size());
+    for (const QString& node : data.nodes) {
+        out << node;
+    }
+    out << static_cast<quint32>(data.events.size());
+    for (const TraceEvent& event : data.events) {
+        out << event.timestampNs << event.sequence << event.event << event.node << event.peer << event.value;
+    }
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+bool EventTrace::load(const QString& path, Snapshot* snapshot, QString* error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != TRACE_MAGIC || version != TRACE_VERSION) {
+        if (error) {
+            *error = "not a SimpleChat trace file";
+        }
+        return false;
+    }
+
+    Snapshot result;
+    quint32 nodeCount = 0;
+    in >> result.ownerId >> result.startEpochNs >> result.overwritten >> nodeCount;
+    for (quint32 i = 0; i < nodeCount && in.status() == QDataStream::Ok; ++i) {
+        QString node;
+        in >> node;
+        result.nodes.append(node);
+    }
+
+    quint32 eventCount = 0;
+    in >> eventCount;
+    for (quint32 i = 0; i < eventCount && in.status() == QDataStream::Ok; ++i) {
+        TraceEvent event;
+        in >> event.timestampNs >> event.sequence >> event.event >> event.node >> event.peer >> event.value;
+        result.events.append(event);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        if (error) {
+            *error = "truncated trace file";
+        }
+        return false;
+    }
+    *snapshot = result;
+    return true;
+}
+
+const char* EventTrace::eventName(quint16 event) {
+    return event < EVENT_COUNT ? EVENT_NAMES[event] : EVENT_NAMES[0];
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QElapsedTimer>
+#include <atomic>
+
+// One fixed-size binary trace record. Node names are interned once per trace
+// and referenced by index, so recording never formats or copies a string.
+struct TraceEvent {
+    qint64 timestampNs;  // Monotonic, since the trace was enabled
+    quint32 sequence;  // Message or route sequence number
+    quint16 event;  // EventTrace::Event
+    quint16 node;  // Subject: origin or destination (EventTrace::NO_NODE if none)
+    quint16 peer;  // Neighbour involved: next hop or sender (EventTrace::NO_NODE if none)
+    quint16 value;  // Event-specific: message type, hop limit or hop count
+    quint32 reserved;
+
+    TraceEvent() : timestampNs(0), sequence(0), event(0), node(0), peer(0), value(0), reserved(0) {}
+};
+
+// Ring buffer of TraceEvents for post-mortem debugging of the per-packet paths.
+//
+// Disabled, record() is one branch on a bool. Enabled, it interns the node
+// names (a hash lookup) and writes one preallocated slot, with no lock and no
+// allocation; when the ring is full the oldest events are overwritten. There
+// is a single writer, the NetworkManager's thread, which also takes snapshots.
+// save() writes one that simplechat_tracedecode turns into text or Chrome
+// trace JSON.
+class EventTrace {
+public:
+    enum Event {
+        SEND = 1,  // node = destination, value = message type
+        RECEIVE,  // node = origin, value = message type
+        FORWARD,  // node = destination, peer = next hop, value = remaining hop limit
+        DROP_HOP_LIMIT,  // node = destination
+        DROP_NO_ROUTE,  // node = destination
+        RUMOR_RECEIVED,  // node = origin, peer = sender, value = remaining hop limit
+        RUMOR_FORWARDED,  // node = origin, peer = neighbour, value = remaining hop limit
+        ROUTE_CHANGED,  // node = destination, peer = next hop, value = hop count
+        ROUTE_UNREACHABLE,  // node = destination, peer = last next hop
+        EVENT_COUNT
+    };
+
+    static const quint16 NO_NODE = 0xffff;
+    static const int DEFAULT_CAPACITY = 65536;  // Events; 1.5 MB
+
+    // A saved trace, as read back by load()
+    struct Snapshot {
+        QString ownerId;  // Node that recorded the trace
+        qint64 startEpochNs;  // Wall-clock time of timestampNs == 0
+        QStringList nodes;  // Indexed by TraceEvent::node and ::peer
+        QVector<TraceEvent> events;  // Oldest first
+        quint64 overwritten;  // Events lost to ring wraparound
+
+        Snapshot() : startEpochNs(0), overwritten(0) {}
+    };
+
+    EventTrace();
+
+    void enable(const QString& ownerId, int capacity = DEFAULT_CAPACITY);  // Rounded up to a power of two
+    void disable();
+    bool isEnabled() const { return enabled; }
+
+    inline void record(Event event, const QString& node, const QString& peer, quint32 sequence, quint16 value = 0) {
+        if (enabled) {
+            append(event, node, peer, sequence, value);
+        }
+    }
+
+    Snapshot snapshot() const;
+    bool save(const QString& path) const;
+
+    static bool load(const QString& path, Snapshot* snapshot, QString* error = nullptr);
+    static const char* eventName(quint16 event);
+
+private:
+    void append(Event event, const QString& node, const QString& peer, quint32 sequence, quint16 value);
+    quint16 intern(const QString& nodeId);
+
+    bool enabled;
+    QString owner;
+    QVector<TraceEvent> ring;
+    quint64 mask;
+    std::atomic<quint64> written;  // Events ever appended; the next slot is written & mask
+    QElapsedTimer monotonic;
+    qint64 startEpochNs;
+    QHash<QString, quint16> nodeIndex;
+    QStringList nodeNames;
+};
@@ -0,0 +1,130 @@
+#include "iblt.h"
+#include <QDataStream>
+#include <QIODevice>
+
+namespace {
+
+quint64 mix64(quint64 x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+}
+
+Iblt::Iblt(int cellCount) : cells(roundCellCount(cellCount)) {}
+
+int Iblt::roundCellCount(int cellCount) {
+    // One equal sub-table per hash function, so a key never hits the same cell twice
+    int perTable = qMax(1, (cellCount + HASH_COUNT - 1) / HASH_COUNT);
+    return perTable * HASH_COUNT;
+}
+
+void Iblt::insert(quint64 key) {
+    update(key, 1);
+}
+
+void Iblt::erase(quint64 key) {
+    update(key, -1);
+}
+
+void Iblt::update(quint64 key, int delta) {
+    quint64 check = checkHash(key);
+    for (int i = 0; i < HASH_COUNT; ++i) {
+        Cell& cell = cells[cellIndex(key, i)];
+        cell.count += delta;
+        cell.keySum ^= key;
+        cell.hashSum ^= check;
+    }
+}
+
+void Iblt::subtract(const Iblt& other) {
+    if (other.cells.size() != cells.size()) {
+        return;
+    }
+
+    for (int i = 0; i < cells.size(); ++i) {
+        cells[i].count -= other.cells[i].count;
+        cells[i].keySum ^= other.cells[i].keySum;
+        cells[i].hashSum ^= other.cells[i].hashSum;
+    }
+}
+
+bool Iblt::decode(QList<quint64>* localOnly, QList<quint64>* remoteOnly) const {
+    Iblt work = *this;
+
+    // Peel pure cells until none are left
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (int i = 0; i < work.cells.size(); ++i) {
+            const Cell cell = work.cells[i];
+            if (!isPure(cell)) {
+                continue;
+            }
+
+            if (cell.count == 1) {
+                localOnly->append(cell.keySum);
+            } else {
+                remoteOnly->append(cell.keySum);
+            }
+            work.update(cell.keySum, -cell.count);
+            progress = true;
+        }
+    }
+
+    for (const Cell& cell : work.cells) {
+        if (cell.count != 0 || cell.keySum != 0 || cell.hashSum != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QByteArray Iblt::toByteArray() const {
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    for (const Cell& cell : cells) {
+        stream << cell.count << cell.keySum << cell.hashSum;
+    }
+    return data;
+}
+
+Iblt Iblt::fromByteArray(const QByteArray& data, int cellCount, bool* ok) {
+    // Check the size before allocating: cellCount comes off the wire
+    if (cellCount <= 0 || cellCount > MAX_CELL_COUNT ||
+        static_cast<qint64>(data.size()) != static_cast<qint64>(roundCellCount(cellCount)) * SERIALIZED_CELL_SIZE) {
+        if (ok) {
+            *ok = false;
+        }
+        return Iblt(1);
+    }
+
+    Iblt table(cellCount);
+    QDataStream stream(data);
+    for (Cell& cell : table.cells) {
+        stream >> cell.count >> cell.keySum >> cell.hashSum;
+    }
+
+    if (ok) {
+        *ok = table.cells.size() == cellCount && stream.status() == QDataStream::Ok && stream.atEnd();
+    }
+    return table;
+}
+
+int Iblt::cellIndex(quint64 key, int hashIndex) const {
+    int perTable = cells.size() / HASH_COUNT;
+    quint64 h = mix64(key + 0x9e3779b97f4a7c15ULL * (hashIndex + 1));
+    return hashIndex * perTable + static_cast<int>(h % static_cast<quint64>(perTable));
+}
+
+quint64 Iblt::checkHash(quint64 key) {
+    return mix64(key ^ 0x5851f42d4c957f2dULL);
+}
+
+bool Iblt::isPure(const Cell& cell) {
+    return (cell.count == 1 || cell.count == -1) && cell.hashSum == checkHash(cell.keySum);
+}
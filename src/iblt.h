@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+
+// Invertible Bloom lookup table over 64-bit keys.
+// Two peers each insert their message ID hashes into a table of the same
+// size; subtracting one table from the other cancels the shared keys, and
+// the remaining O(difference) cells can be peeled back into the keys each
+// side is missing.
+class Iblt {
+public:
+    static const int HASH_COUNT = 3;  // Each key lands in one cell of each sub-table
+    static const int SERIALIZED_CELL_SIZE = 20;  // count (4) + keySum (8) + hashSum (8)
+    static const int MAX_CELL_COUNT = 1 << 20;  // Hard cap on deserialized tables
+
+    explicit Iblt(int cellCount);
+
+    int cellCount() const { return cells.size(); }
+
+    void insert(quint64 key);
+    void erase(quint64 key);
+    void subtract(const Iblt& other);
+
+    // Peel the table back into keys. Returns false if it is too full to decode
+    // completely; keys recovered so far are still returned.
+    bool decode(QList<quint64>* localOnly, QList<quint64>* remoteOnly) const;
+
+    QByteArray toByteArray() const;
+    static Iblt fromByteArray(const QByteArray& data, int cellCount, bool* ok = nullptr);
+
+    static int roundCellCount(int cellCount);
+
+private:
+    struct Cell {
+        qint32 count;
+        quint64 keySum;  // XOR of keys
+        quint64 hashSum;  // XOR of checkHash(key), to recognise pure cells
+
+        Cell() : count(0), keySum(0), hashSum(0) {}
+    };
+
+    void update(quint64 key, int delta);
+    int cellIndex(quint64 key, int hashIndex) const;
+    static quint64 checkHash(quint64 key);
+    static bool isPure(const Cell& cell);
+
+    QVector<Cell> cells;
+};
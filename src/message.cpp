@@ -2,10 +2,12 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 
-Message::Message() : sequenceNumber(0), type(CHAT_MESSAGE), hopLimit(10), lastPort(0) {}
+Message::Message() : sequenceNumber(0), type(CHAT_MESSAGE), hopLimit(DEFAULT_HOP_LIMIT), lastPort(0), previousBroadcast(0),
+                     repair(false) {}
 
 Message::Message(const QString& chatText, const QString& origin, const QString& destination, int sequenceNumber, MessageType type)
-    : chatText(chatText), origin(origin), destination(destination), sequenceNumber(sequenceNumber), type(type), hopLimit(10), lastPort(0) {
+    : chatText(chatText), origin(origin), destination(destination), sequenceNumber(sequenceNumber), type(type), hopLimit(DEFAULT_HOP_LIMIT), lastPort(0),
+      previousBroadcast(0), repair(false) {
     messageId = generateMessageId();
 }
 
@@ -18,9 +20,19 @@ Message Message::fromVariantMap(const QVariantMap& map) {
     msg.type = static_cast<MessageType>(map.value("Type", CHAT_MESSAGE).toInt());
     msg.vectorClock = map.value("VectorClock").toMap();
     msg.messageId = map.value("MessageId").toString();
-    msg.hopLimit = map.value("HopLimit", 10).toUInt();
+    msg.hopLimit = map.value("HopLimit", DEFAULT_HOP_LIMIT).toUInt();
     msg.lastIP = map.value("LastIP").toString();
     msg.lastPort = map.value("LastPort", 0).toUInt();
+    msg.routeEntries = map.value("Routes").toList();
+    msg.messageIds = map.value("MessageIds").toStringList();
+    msg.storeDigest = map.value("StoreDigest").toString();
+    msg.digests = map.value("Digests").toMap();
+    msg.sketch = QByteArray::fromBase64(map.value("Sketch").toString().toLatin1());
+    msg.ranges = map.value("Ranges").toList();
+    msg.lowWaterMarks = map.value("LowWater").toMap();
+    msg.deliveryTrace = map.value("Trace").toMap();
+    msg.previousBroadcast = map.value("PrevBroadcast", 0).toInt();
+    msg.repair = map.value("Repair", false).toBool();
 
     // Generate message ID if not present
     if (msg.messageId.isEmpty()) {
@@ -60,6 +72,36 @@ QVariantMap Message::toVariantMap() const {
     if (lastPort > 0) {
         map["LastPort"] = lastPort;
     }
+    if (!routeEntries.isEmpty()) {
+        map["Routes"] = routeEntries;
+    }
+    if (!messageIds.isEmpty()) {
+        map["MessageIds"] = messageIds;
+    }
+    if (!storeDigest.isEmpty()) {
+        map["StoreDigest"] = storeDigest;
+    }
+    if (!digests.isEmpty()) {
+        map["Digests"] = digests;
+    }
+    if (!sketch.isEmpty()) {
+        map["Sketch"] = QString::fromLatin1(sketch.toBase64());
+    }
+    if (!ranges.isEmpty()) {
+        map["Ranges"] = ranges;
+    }
+    if (!lowWaterMarks.isEmpty()) {
+        map["LowWater"] = lowWaterMarks;
+    }
+    if (!deliveryTrace.isEmpty()) {
+        map["Trace"] = deliveryTrace;
+    }
+    if (previousBroadcast > 0) {
+        map["PrevBroadcast"] = previousBroadcast;
+    }
+    if (repair) {
+        map["Repair"] = true;
+    }
 
     return map;
 }
@@ -78,6 +120,39 @@ QString Message::generateMessageId() const {
     return QString("%1_%2").arg(origin).arg(sequenceNumber);
 }
 
+QString Message::typeName(MessageType type) {
+    static const char* const names[] = {
+        "CHAT_MESSAGE", "ANTI_ENTROPY_REQUEST", "ANTI_ENTROPY_RESPONSE", "ACK", "ROUTE_RUMOR",
+        "ROUTE_ADVERTISEMENT", "LINK_PROBE", "LINK_PROBE_REPLY", "ROUTE_REQUEST", "ROUTE_REPLY",
+        "RUMOR_FEEDBACK", "RUMOR_PULL", "GOSSIP_IHAVE", "GOSSIP_GRAFT", "GOSSIP_PRUNE",
+        "ANTI_ENTROPY_DIGEST", "ANTI_ENTROPY_IBLT", "ANTI_ENTROPY_FETCH", "GAP_NACK"
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == TYPE_COUNT, "one name per message type");
+    int index = static_cast<int>(type);
+    if (index < 0 || index >= TYPE_COUNT) {
+        return QString("TYPE_%1").arg(index);
+    }
+    return QString(names[index]);
+}
+
+quint64 Message::hashMessageId(const QString& messageId) {
+    // FNV-1a over the UTF-8 bytes, then a 64-bit finalizer so that
+    // similar IDs ("A_1", "A_2") don't produce correlated bits under XOR
+    quint64 hash = 14695981039346656037ULL;
+    const QByteArray bytes = messageId.toUtf8();
+    for (char c : bytes) {
+        hash ^= static_cast<quint8>(c);
+        hash *= 1099511628211ULL;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
 QDataStream& operator<<(QDataStream& stream, const Message& message) {
     QVariantMap map = message.toVariantMap();
     stream << map;
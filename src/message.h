@@ -11,8 +11,25 @@ public:
         ANTI_ENTROPY_REQUEST,
         ANTI_ENTROPY_RESPONSE,
         ACK,
-        ROUTE_RUMOR
+        ROUTE_RUMOR,
+        ROUTE_ADVERTISEMENT,
+        LINK_PROBE,
+        LINK_PROBE_REPLY,
+        ROUTE_REQUEST,
+        ROUTE_REPLY,
+        RUMOR_FEEDBACK,
+        RUMOR_PULL,
+        GOSSIP_IHAVE,
+        GOSSIP_GRAFT,
+        GOSSIP_PRUNE,
+        ANTI_ENTROPY_DIGEST,
+        ANTI_ENTROPY_IBLT,
+        ANTI_ENTROPY_FETCH,
+        GAP_NACK
     };
+    static const int TYPE_COUNT = GAP_NACK + 1;  // Keep in step with the last enumerator
+
+    static const quint32 DEFAULT_HOP_LIMIT = 10;
 
     Message();
     Message(const QString& chatText, const QString& origin, const QString& destination, int sequenceNumber, MessageType type = CHAT_MESSAGE);
@@ -32,6 +49,17 @@ public:
     quint32 getHopLimit() const { return hopLimit; }
     QString getLastIP() const { return lastIP; }
     quint16 getLastPort() const { return lastPort; }
+    QVariantList getRouteEntries() const { return routeEntries; }
+    QStringList getMessageIds() const { return messageIds; }
+    QString getStoreDigest() const { return storeDigest; }
+    QVariantMap getDigests() const { return digests; }
+    QByteArray getSketch() const { return sketch; }
+    QVariantList getRanges() const { return ranges; }
+    QVariantMap getLowWaterMarks() const { return lowWaterMarks; }
+    QVariantMap getDeliveryTrace() const { return deliveryTrace; }
+    int getPreviousBroadcast() const { return previousBroadcast; }
+    bool isRepair() const { return repair; }
+    bool hasDeliveryTrace() const { return !deliveryTrace.isEmpty(); }
 
     void setChatText(const QString& text) { chatText = text; }
     void setOrigin(const QString& org) { origin = org; }
@@ -43,12 +71,28 @@ public:
     void setHopLimit(quint32 limit) { hopLimit = limit; }
     void setLastIP(const QString& ip) { lastIP = ip; }
     void setLastPort(quint16 port) { lastPort = port; }
+    void setRouteEntries(const QVariantList& entries) { routeEntries = entries; }
+    void setMessageIds(const QStringList& ids) { messageIds = ids; }
+    void setStoreDigest(const QString& digest) { storeDigest = digest; }
+    void setDigests(const QVariantMap& map) { digests = map; }
+    void setSketch(const QByteArray& data) { sketch = data; }
+    void setRanges(const QVariantList& list) { ranges = list; }
+    void setLowWaterMarks(const QVariantMap& marks) { lowWaterMarks = marks; }
+    void setDeliveryTrace(const QVariantMap& trace) { deliveryTrace = trace; }
+    void setPreviousBroadcast(int seq) { previousBroadcast = seq; }
+    void setRepair(bool resent) { repair = resent; }
 
     bool isValid() const;
     bool isBroadcast() const { return destination == "-1" || destination == "broadcast"; }
 
     QString generateMessageId() const;
 
+    // 64-bit hash of a message ID; store digests are the XOR of these
+    static quint64 hashMessageId(const QString& messageId);
+
+    // Enumerator name without a prefix, e.g. "ROUTE_RUMOR" (for logs and reports)
+    static QString typeName(MessageType type);
+
 private:
     QString chatText;
     QString origin;
@@ -60,6 +104,16 @@ private:
     quint32 hopLimit;  // For forwarding with hop limit
     QString lastIP;  // Last hop IP address (for NAT traversal)
     quint16 lastPort;  // Last hop port (for NAT traversal)
+    QVariantList routeEntries;  // Route advertisement: list of {Dest, SeqNo, Hops}
+    QStringList messageIds;  // Broadcast tree control: IDs announced (IHAVE) or requested (GRAFT)
+    QString storeDigest;  // Anti-entropy: hex digest of the sender's whole store
+    QVariantMap digests;  // Anti-entropy: origin -> hex digest (or the origins a sync is scoped to)
+    QByteArray sketch;  // Set reconciliation: serialized IBLT cells
+    QVariantList ranges;  // Gap repair: list of {Origin, From, To} missing sequence ranges
+    QVariantMap lowWaterMarks;  // Anti-entropy: origin -> highest compacted sequence number
+    QVariantMap deliveryTrace;  // Latency tracing: {Sent: us, Hops: [[node, arrival us, departure us], ...]}
+    int previousBroadcast;  // Gap repair: the origin's broadcast before this one (0 = none)
+    bool repair;  // Resent from a store (catch-up, GRAFT or NACK reply), not pushed down the broadcast tree
 };
 
 QDataStream& operator<<(QDataStream& stream, const Message& message);
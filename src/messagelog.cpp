@@ -0,0 +1,349 @@
+#include "messagelog.h"
+#include <QDir>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QtEndian>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+void appendBigEndian32(QByteArray& out, quint32 value) {
+    uchar bytes[4];
+    qToBigEndian(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), 4);
+}
+
+void appendBigEndian16(QByteArray& out, quint16 value) {
+    uchar bytes[2];
+    qToBigEndian(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), 2);
+}
+
+}
+
+MessageLog::MessageLog(SyncPolicy policy, qint64 segmentSize)
+    : syncPolicy(policy), maxSegmentSize(segmentSize), dirty(false), truncated(0) {}
+
+MessageLog::~MessageLog() {
+    close();
+}
+
+quint32 MessageLog::crc32(const char* data, int length) {
+    // Standard reflected CRC-32 (IEEE 802.3)
+    static quint32 table[256];
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            }
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+
+    quint32 crc = 0xFFFFFFFFu;
+    for (int i = 0; i < length; ++i) {
+        crc = table[(crc ^ static_cast<quint8>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+QString MessageLog::segmentPath(int number) const {
+    return QDir(dir).filePath(QString("segment-%1.log").arg(number, 8, 10, QChar('0')));
+}
+
+bool MessageLog::open(const QString& directory, const RecoveryVisitor& visitor) {
+    close();
+    dir = directory;
+    segments.clear();
+    index.clear();
+    truncated = 0;
+
+    if (!QDir().mkpath(dir)) {
+        qDebug() << "Message log: cannot create" << dir;
+        return false;
+    }
+
+    QStringList files = QDir(dir).entryList(QStringList() << "segment-*.log", QDir::Files, QDir::Name);
+    for (const QString& name : files) {
+        bool ok = false;
+        int number = name.mid(8, name.length() - 12).toInt(&ok);
+        if (!ok) {
+            continue;
+        }
+
+        Segment segment;
+        segment.number = number;
+        segment.path = QDir(dir).filePath(name);
+        segment.size = 0;
+        segment.liveRecords = 0;
+        if (recoverSegment(segment, visitor)) {
+            segments.append(segment);
+        }
+    }
+
+    // Segments whose records are all dead can go, except the one we append to
+    for (int i = segments.size() - 2; i >= 0; --i) {
+        if (segments[i].liveRecords == 0) {
+            QFile::remove(segments[i].path);
+            segments.removeAt(i);
+        }
+    }
+
+    int activeNumber = segments.isEmpty() ? 1 : segments.last().number;
+    if (!segments.isEmpty() && segments.last().size >= maxSegmentSize) {
+        activeNumber++;
+    }
+    return openActiveSegment(activeNumber);
+}
+
+bool MessageLog::recoverSegment(Segment& segment, const RecoveryVisitor& visitor) {
+    QFile file(segment.path);
+    if (!file.open(QIODevice::ReadWrite)) {
+        qDebug() << "Message log: cannot open" << segment.path;
+        return false;
+    }
+
+    qint64 fileSize = file.size();
+    qint64 offset = 0;
+    uchar* base = fileSize > 0 ? file.map(0, fileSize) : nullptr;
+
+    if (base) {
+        while (offset + RECORD_HEADER_SIZE <= fileSize) {
+            const uchar* header = base + offset;
+            quint32 magic = qFromBigEndian<quint32>(header);
+            quint32 bodyLength = qFromBigEndian<quint32>(header + 4);
+            quint32 checksum = qFromBigEndian<quint32>(header + 8);
+
+            if (magic != RECORD_MAGIC || bodyLength > MAX_RECORD_SIZE ||
+                offset + RECORD_HEADER_SIZE + bodyLength > static_cast<quint64>(fileSize)) {
+                break;
+            }
+
+            const char* body = reinterpret_cast<const char*>(header + RECORD_HEADER_SIZE);
+            if (crc32(body, static_cast<int>(bodyLength)) != checksum) {
+                break;
+            }
+
+            // Body: seq, origin, message ID, payload
+            const uchar* cursor = reinterpret_cast<const uchar*>(body);
+            const uchar* end = cursor + bodyLength;
+            if (end - cursor < 6) {
+                break;
+            }
+            Entry entry;
+            entry.sequenceNumber = static_cast<int>(qFromBigEndian<quint32>(cursor));
+            quint16 originLength = qFromBigEndian<quint16>(cursor + 4);
+            cursor += 6;
+            if (end - cursor < originLength + 2) {
+                break;
+            }
+            entry.origin = QString::fromUtf8(reinterpret_cast<const char*>(cursor), originLength);
+            cursor += originLength;
+            quint16 idLength = qFromBigEndian<quint16>(cursor);
+            cursor += 2;
+            if (end - cursor < idLength + 4) {
+                break;
+            }
+            entry.messageId = QString::fromUtf8(reinterpret_cast<const char*>(cursor), idLength);
+            cursor += idLength;
+            quint32 payloadLength = qFromBigEndian<quint32>(cursor);
+            cursor += 4;
+            if (static_cast<quint64>(end - cursor) != payloadLength) {
+                break;
+            }
+
+            if (visitor(entry, reinterpret_cast<const char*>(cursor), static_cast<int>(payloadLength))) {
+                // A later record for the same ID supersedes an earlier one
+                auto previous = index.constFind(entry.messageId);
+                if (previous != index.constEnd()) {
+                    for (Segment& other : segments) {
+                        if (other.number == previous.value()) {
+                            other.liveRecords--;
+                        }
+                    }
+                    if (previous.value() == segment.number) {
+                        segment.liveRecords--;
+                    }
+                }
+                index.insert(entry.messageId, segment.number);
+                segment.liveRecords++;
+            }
+
+            offset += RECORD_HEADER_SIZE + bodyLength;
+        }
+        file.unmap(base);
+    }
+
+    if (offset < fileSize) {
+        qDebug() << "Message log: truncating" << (fileSize - offset) << "corrupt bytes from" << segment.path;
+        truncated += fileSize - offset;
+        file.resize(offset);
+    }
+
+    segment.size = offset;
+    return true;
+}
+
+bool MessageLog::openActiveSegment(int number) {
+    if (activeFile.isOpen()) {
+        activeFile.close();
+    }
+
+    activeFile.setFileName(segmentPath(number));
+    if (!activeFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qDebug() << "Message log: cannot open segment" << activeFile.fileName();
+        return false;
+    }
+
+    if (segments.isEmpty() || segments.last().number != number) {
+        Segment segment;
+        segment.number = number;
+        segment.path = activeFile.fileName();
+        segment.size = activeFile.size();
+        segment.liveRecords = 0;
+        segments.append(segment);
+    }
+    return true;
+}
+
+void MessageLog::close() {
+    if (activeFile.isOpen()) {
+        sync();
+        activeFile.close();
+    }
+}
+
+bool MessageLog::append(const QString& messageId, const QString& origin, int sequenceNumber, const QByteArray& payload) {
+    if (!activeFile.isOpen()) {
+        return false;
+    }
+
+    if (segments.last().size >= maxSegmentSize) {
+        sync();
+        if (!openActiveSegment(segments.last().number + 1)) {
+            return false;
+        }
+    }
+
+    QByteArray originBytes = origin.toUtf8();
+    QByteArray idBytes = messageId.toUtf8();
+
+    QByteArray body;
+    body.reserve(12 + originBytes.size() + idBytes.size() + payload.size());
+    appendBigEndian32(body, static_cast<quint32>(sequenceNumber));
+    appendBigEndian16(body, static_cast<quint16>(originBytes.size()));
+    body.append(originBytes);
+    appendBigEndian16(body, static_cast<quint16>(idBytes.size()));
+    body.append(idBytes);
+    appendBigEndian32(body, static_cast<quint32>(payload.size()));
+    body.append(payload);
+
+    QByteArray record;
+    record.reserve(RECORD_HEADER_SIZE + body.size());
+    appendBigEndian32(record, RECORD_MAGIC);
+    appendBigEndian32(record, static_cast<quint32>(body.size()));
+    appendBigEndian32(record, crc32(body.constData(), body.size()));
+    record.append(body);
+
+    if (activeFile.write(record) != record.size()) {
+        qDebug() << "Message log: write failed:" << activeFile.errorString();
+        return false;
+    }
+    activeFile.flush();
+
+    Segment& segment = segments.last();
+    segment.size += record.size();
+    segment.liveRecords++;
+    index.insert(messageId, segment.number);
+
+    dirty = true;
+    if (syncPolicy == SYNC_ALWAYS) {
+        sync();
+    }
+    return true;
+}
+
+bool MessageLog::markRemoved(const QString& messageId) {
+    auto it = index.find(messageId);
+    if (it == index.end()) {
+        return false;
+    }
+
+    int number = it.value();
+    index.erase(it);
+
+    // The active segment stays even when empty
+    for (int i = 0; i < segments.size(); ++i) {
+        if (segments[i].number == number) {
+            segments[i].liveRecords--;
+            return i + 1 < segments.size() && segments[i].liveRecords <= 0;
+        }
+    }
+    return false;
+}
+
+void MessageLog::dropReclaimedSegments() {
+    for (int i = 0; i + 1 < segments.size(); ) {
+        if (segments[i].liveRecords <= 0) {
+            QFile::remove(segments[i].path);
+            segments.removeAt(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+void MessageLog::sync() {
+    if (!dirty || !activeFile.isOpen() || syncPolicy == SYNC_NONE) {
+        return;
+    }
+
+    activeFile.flush();
+#ifdef Q_OS_WIN
+    _commit(activeFile.handle());
+#else
+    ::fsync(activeFile.handle());
+#endif
+    dirty = false;
+}
+
+bool MessageLog::saveSnapshot(const Snapshot& snapshot) const {
+    // QSaveFile writes to a temporary and renames, so a crash never leaves half a snapshot
+    QSaveFile file(QDir(dir).filePath("snapshot.dat"));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << SNAPSHOT_VERSION << snapshot.vectorClock
+           << static_cast<qint32>(snapshot.nextSequenceNumber) << snapshot.lowWaterMarks;
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+bool MessageLog::loadSnapshot(const QString& directory, Snapshot* snapshot) {
+    QFile file(QDir(directory).filePath("snapshot.dat"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    quint32 version = 0;
+    qint32 nextSequenceNumber = 1;
+    stream >> version;
+    if (version != SNAPSHOT_VERSION) {
+        return false;
+    }
+
+    stream >> snapshot->vectorClock >> nextSequenceNumber >> snapshot->lowWaterMarks;
+    snapshot->nextSequenceNumber = nextSequenceNumber;
+    return stream.status() == QDataStream::Ok;
+}
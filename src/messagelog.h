@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QVariantMap>
+#include <functional>
+
+// Append-only, segmented on-disk log of stored messages.
+//
+// Each record is framed as
+//   magic | body length | CRC-32(body) | seq | origin | message ID | payload
+// so recovery can validate records and skip dead ones from the header alone,
+// parsing payloads only for records that are still live. Segments are
+// memory-mapped for recovery; a corrupt or torn tail is truncated away.
+class MessageLog {
+public:
+    enum SyncPolicy {
+        SYNC_NONE,  // Leave flushing to the OS
+        SYNC_BATCHED,  // fsync from sync(), called periodically by the owner
+        SYNC_ALWAYS  // fsync after every append
+    };
+
+    struct Entry {
+        QString messageId;
+        QString origin;
+        int sequenceNumber;
+    };
+
+    // Called for every intact record during open(); payload points into the mapped
+    // segment and is only valid during the call. Return false to mark the record dead.
+    typedef std::function<bool(const Entry& entry, const char* payload, int length)> RecoveryVisitor;
+
+    // Everything besides the messages themselves that a restart needs
+    struct Snapshot {
+        QVariantMap vectorClock;
+        int nextSequenceNumber;
+        QVariantMap lowWaterMarks;
+
+        Snapshot() : nextSequenceNumber(1) {}
+    };
+
+    static const qint64 DEFAULT_SEGMENT_SIZE = 4 * 1024 * 1024;
+
+    explicit MessageLog(SyncPolicy policy = SYNC_BATCHED, qint64 segmentSize = DEFAULT_SEGMENT_SIZE);
+    ~MessageLog();
+
+    bool open(const QString& directory, const RecoveryVisitor& visitor);
+    void close();
+    bool isOpen() const { return activeFile.isOpen(); }
+
+    bool append(const QString& messageId, const QString& origin, int sequenceNumber, const QByteArray& payload);
+    // Returns true when this left a closed segment with no live records. The owner
+    // saves the snapshot whose low water marks cover them, then calls dropReclaimedSegments().
+    bool markRemoved(const QString& messageId);
+    void dropReclaimedSegments();
+    void sync();
+
+    bool saveSnapshot(const Snapshot& snapshot) const;
+    static bool loadSnapshot(const QString& directory, Snapshot* snapshot);
+
+    int segmentCount() const { return segments.size(); }
+    int liveRecords() const { return index.size(); }
+    quint64 truncatedBytes() const { return truncated; }  // Corrupt tail bytes dropped during recovery
+
+    static quint32 crc32(const char* data, int length);
+
+private:
+    struct Segment {
+        int number;
+        QString path;
+        qint64 size;
+        int liveRecords;
+    };
+
+    bool recoverSegment(Segment& segment, const RecoveryVisitor& visitor);
+    bool openActiveSegment(int number);
+    QString segmentPath(int number) const;
+
+    SyncPolicy syncPolicy;
+    qint64 maxSegmentSize;
+    QString dir;
+    QList<Segment> segments;  // Ascending; the last one is appended to
+    QHash<QString, int> index;  // messageId -> segment number of its live record
+    QFile activeFile;
+    bool dirty;
+    quint64 truncated;
+
+    static const quint32 RECORD_MAGIC = 0x53434C47;  // "SCLG"
+    static const int RECORD_HEADER_SIZE = 12;  // magic, body length, CRC-32
+    static const quint32 MAX_RECORD_SIZE = 1024 * 1024;
+    static const quint32 SNAPSHOT_VERSION = 1;
+};
@@ -0,0 +1,310 @@
+#include "metrics.h"
+#include "networkmanager.h"
+#include <QCoreApplication>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QSaveFile>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+Histogram::Histogram(const QVector<double>& upperBounds)
+    : bounds(upperBounds), counts(upperBounds.size() + 1, 0), total(0), valueSum(0.0) {}
+
+void Histogram::observe(double value) {
+    int bucket = static_cast<int>(std::lower_bound(bounds.constBegin(), bounds.constEnd(), value) - bounds.constBegin());
+    counts[bucket]++;
+    total++;
+    valueSum += value;
+}
+
+NodeMetrics::NodeMetrics()
+    : decodeFailures(0), sendFailures(0), parkedNoRoute(0), dropsNoRoute(0), dropsHopLimit(0), routeChanges(0),
+      linkRttSeconds(QVector<double>() << 0.0005 << 0.001 << 0.0025 << 0.005 << 0.01 << 0.025 << 0.05
+                                       << 0.1 << 0.25 << 0.5 << 1.0 << 2.5),
+      datagramBytes(QVector<double>() << 64 << 128 << 256 << 512 << 1024 << 2048 << 4096 << 8192
+                                      << 16384 << 65536),
+      deliveryLatencySeconds(QVector<double>() << 0.001 << 0.0025 << 0.005 << 0.01 << 0.025 << 0.05 << 0.1
+                                               << 0.25 << 0.5 << 1.0 << 2.5 << 5.0 << 10.0),
+      hopQueueSeconds(QVector<double>() << 0.00001 << 0.0001 << 0.0005 << 0.001 << 0.005 << 0.01 << 0.05
+                                        << 0.1 << 0.25 << 0.5 << 1.0) {
+    std::memset(packetsIn, 0, sizeof(packetsIn));
+    std::memset(bytesIn, 0, sizeof(bytesIn));
+    std::memset(packetsOut, 0, sizeof(packetsOut));
+    std::memset(bytesOut, 0, sizeof(bytesOut));
+}
+
+void NodeMetrics::countIn(Message::MessageType type, int bytes) {
+    int index = static_cast<int>(type);
+    if (index < 0 || index >= Message::TYPE_COUNT) {
+        decodeFailures++;
+        return;
+    }
+    packetsIn[index]++;
+    bytesIn[index] += static_cast<quint64>(bytes);
+}
+
+void NodeMetrics::countOut(Message::MessageType type, int bytes) {
+    int index = static_cast<int>(type);
+    if (index >= 0 && index < Message::TYPE_COUNT) {
+        packetsOut[index]++;
+        bytesOut[index] += static_cast<quint64>(bytes);
+    }
+}
+
+QString PrometheusWriter::formatValue(double value) {
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (value == std::floor(value) && std::fabs(value) < 1e15) {
+        return QString::number(static_cast<qint64>(value));
+    }
+    return QString::number(value, 'g', 10);
+}
+
+QString PrometheusWriter::label(const QString& key, const QString& value) {
+    QString escaped = value;
+    escaped.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return QString("%1=\"%2\"").arg(key, escaped);
+}
+
+void PrometheusWriter::family(const QString& name, const char* type, const QString& help) {
+    out += QString("# HELP %1 %2\n# TYPE %1 %3\n").arg(name, help, QLatin1String(type)).toUtf8();
+}
+
+void PrometheusWriter::sample(const QString& name, const QString& labels, double value) {
+    QString line = labels.isEmpty() ? name : QString("%1{%2}").arg(name, labels);
+    out += QString("%1 %2\n").arg(line, formatValue(value)).toUtf8();
+}
+
+void PrometheusWriter::counter(const QString& name, const QString& help, double value) {
+    family(name, "counter", help);
+    sample(name, QString(), value);
+}
+
+void PrometheusWriter::gauge(const QString& name, const QString& help, double value) {
+    family(name, "gauge", help);
+    sample(name, QString(), value);
+}
+
+void PrometheusWriter::histogram(const QString& name, const QString& help, const Histogram& histogram) {
+    family(name, "histogram", help);
+
+    // Prometheus buckets are cumulative
+    quint64 cumulative = 0;
+    const QVector<double>& bounds = histogram.upperBounds();
+    const QVector<quint64>& counts = histogram.bucketCounts();
+    for (int i = 0; i < counts.size(); ++i) {
+        cumulative += counts[i];
+        double bound = i < bounds.size() ? bounds[i] : INFINITY;
+        sample(name + "_bucket", label("le", formatValue(bound)), static_cast<double>(cumulative));
+    }
+    sample(name + "_sum", QString(), histogram.sum());
+    sample(name + "_count", QString(), static_cast<double>(histogram.count()));
+}
+
+MetricsServer::MetricsServer(NetworkManager* manager, QObject* parent)
+    : QObject(parent), networkManager(manager), server(new QTcpServer(this)), dumpTimer(new QTimer(this)) {
+    connect(server, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+    connect(dumpTimer, &QTimer::timeout, this, &MetricsServer::onDumpTimeout);
+
+    // Final numbers survive a clean shutdown (the node is still alive at this point)
+    if (QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &MetricsServer::onDumpTimeout);
+    }
+}
+
+MetricsServer::~MetricsServer() {}
+
+bool MetricsServer::listen(quint16 port) {
+    if (!server->listen(QHostAddress::LocalHost, port)) {
+        qDebug() << "Metrics endpoint: cannot listen on port" << port << ":" << server->errorString();
+        return false;
+    }
+    qDebug().noquote() << QString("[METRICS] Serving http://127.0.0.1:%1/metrics").arg(server->serverPort());
+    return true;
+}
+
+quint16 MetricsServer::serverPort() const {
+    return server->serverPort();
+}
+
+void MetricsServer::setDumpFile(const QString& path, int intervalMs) {
+    dumpFile = path;
+    if (path.isEmpty()) {
+        dumpTimer->stop();
+        return;
+    }
+    writeFile(path);
+    dumpTimer->start(intervalMs);
+}
+
+bool MetricsServer::writeFile(const QString& path) const {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(render());
+    return file.commit();
+}
+
+void MetricsServer::onDumpTimeout() {
+    if (!dumpFile.isEmpty() && !writeFile(dumpFile)) {
+        qDebug() << "Metrics: failed to write" << dumpFile;
+    }
+}
+
+void MetricsServer::onNewConnection() {
+    while (QTcpSocket* socket = server->nextPendingConnection()) {
+        requests.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, &MetricsServer::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            requests.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void MetricsServer::onReadyRead() {
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket || !requests.contains(socket)) {
+        return;
+    }
+
+    QByteArray& request = requests[socket];
+    request += socket->readAll();
+    if (request.size() > MAX_REQUEST_SIZE) {
+        respond(socket, "431 Request Header Fields Too Large", QByteArray());
+        return;
+    }
+    if (!request.contains("\r\n\r\n") && !request.contains("\n\n")) {
+        return;  // Headers not complete yet
+    }
+
+    // Only the request line matters: "GET /metrics HTTP/1.1"
+    QList<QByteArray> requestLine = request.left(request.indexOf('\n')).trimmed().split(' ');
+    QByteArray method = requestLine.value(0);
+    QByteArray path = requestLine.value(1);
+    if (method != "GET" && method != "HEAD") {
+        respond(socket, "405 Method Not Allowed", QByteArray());
+    } else if (path != "/metrics" && path != "/") {
+        respond(socket, "404 Not Found", QByteArray());
+    } else {
+        QByteArray body = render();
+        respond(socket, "200 OK", method == "HEAD" ? QByteArray() : body);
+    }
+}
+
+void MetricsServer::respond(QTcpSocket* socket, const QByteArray& status, const QByteArray& body) {
+    QByteArray response = "HTTP/1.1 " + status + "\r\n"
+                          "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                          "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                          "Connection: close\r\n\r\n" + body;
+    socket->write(response);
+    requests.remove(socket);
+    socket->disconnectFromHost();
+}
+
+QByteArray MetricsServer::render() const {
+    const NodeMetrics& metrics = networkManager->getMetrics();
+    GossipStats gossip = networkManager->getGossipStats();
+    StoreStats store = networkManager->getStoreStats();
+    PrometheusWriter writer;
+
+    // Per message type
+    struct TypedCounter {
+        const char* name;
+        const char* help;
+        const quint64* values;
+    };
+    const TypedCounter typed[] = {
+        {"simplechat_packets_received_total", "Datagrams received, by message type", metrics.packetsIn},
+        {"simplechat_bytes_received_total", "Bytes received, by message type", metrics.bytesIn},
+        {"simplechat_packets_sent_total", "Datagrams sent, by message type", metrics.packetsOut},
+        {"simplechat_bytes_sent_total", "Bytes sent, by message type", metrics.bytesOut},
+    };
+    for (const TypedCounter& counter : typed) {
+        writer.family(counter.name, "counter", counter.help);
+        for (int type = 0; type < Message::TYPE_COUNT; ++type) {
+            writer.sample(counter.name, PrometheusWriter::label("type", Message::typeName(static_cast<Message::MessageType>(type))),
+                          static_cast<double>(counter.values[type]));
+        }
+    }
+
+    writer.counter("simplechat_decode_failures_total", "Datagrams that could not be decoded",
+                   static_cast<double>(metrics.decodeFailures));
+    writer.counter("simplechat_send_failures_total", "Datagrams the socket refused to send",
+                   static_cast<double>(metrics.sendFailures));
+    writer.counter("simplechat_forwarded_total", "Private messages relayed for other nodes",
+                   static_cast<double>(gossip.transitForwarded));
+
+    writer.counter("simplechat_route_discovery_parked_total", "Private messages held back until a route is found",
+                   static_cast<double>(metrics.parkedNoRoute));
+
+    writer.family("simplechat_dropped_total", "counter", "Private messages not forwarded, by reason");
+    writer.sample("simplechat_dropped_total", PrometheusWriter::label("reason", "no_route"),
+                  static_cast<double>(metrics.dropsNoRoute));
+    writer.sample("simplechat_dropped_total", PrometheusWriter::label("reason", "hop_limit"),
+                  static_cast<double>(metrics.dropsHopLimit));
+    writer.sample("simplechat_dropped_total", PrometheusWriter::label("reason", "transit_duplicate"),
+                  static_cast<double>(gossip.transitDuplicates));
+
+    // Reliability and repair
+    writer.counter("simplechat_ack_retransmits_total", "Private messages resent after an ACK timeout",
+                   static_cast<double>(gossip.ackRetransmits));
+    writer.counter("simplechat_ack_failures_total", "Private messages given up on after the last retry",
+                   static_cast<double>(gossip.ackFailures));
+    writer.counter("simplechat_nack_retransmits_total", "Messages resent in answer to gap NACKs",
+                   static_cast<double>(gossip.nackRetransmits));
+    writer.counter("simplechat_antientropy_digest_mismatches_total", "Summary digests that needed a per-origin comparison",
+                   static_cast<double>(gossip.digestMismatches));
+    writer.counter("simplechat_antientropy_messages_sent_total", "Stored messages streamed to lagging peers",
+                   static_cast<double>(gossip.catchUpMessagesSent));
+    writer.counter("simplechat_antientropy_bytes_sent_total", "Bytes of stored messages streamed to lagging peers",
+                   static_cast<double>(gossip.catchUpBytesSent));
+
+    // Routing and store state
+    QMap<QString, RouteInfo> routes = networkManager->getRoutingTable();
+    int reachable = 0;
+    for (const RouteInfo& route : routes) {
+        if (route.isReachable()) {
+            reachable++;
+        }
+    }
+    writer.gauge("simplechat_routes", "Routing table entries", routes.size());
+    writer.gauge("simplechat_routes_reachable", "Routing table entries with a finite metric", reachable);
+    writer.counter("simplechat_route_changes_total", "Routes added, moved to another path or invalidated",
+                   static_cast<double>(metrics.routeChanges));
+    writer.gauge("simplechat_store_messages", "Messages held in the store", store.liveMessages);
+    writer.gauge("simplechat_store_bytes", "Payload bytes held in the store", static_cast<double>(store.liveBytes));
+
+    // Links
+    QMap<QString, PeerInfo> peers = networkManager->getPeers();
+    writer.gauge("simplechat_peers", "Known neighbours", peers.size());
+    writer.family("simplechat_peer_rtt_seconds", "gauge", "Smoothed link RTT per neighbour");
+    for (auto it = peers.constBegin(); it != peers.constEnd(); ++it) {
+        if (it.value().probeSamples > 0) {
+            writer.sample("simplechat_peer_rtt_seconds", PrometheusWriter::label("peer", it.key()),
+                          it.value().rttEwma / 1000.0);
+        }
+    }
+    writer.family("simplechat_peer_loss_ratio", "gauge", "Smoothed probe loss per neighbour");
+    for (auto it = peers.constBegin(); it != peers.constEnd(); ++it) {
+        if (it.value().probeSamples > 0) {
+            writer.sample("simplechat_peer_loss_ratio", PrometheusWriter::label("peer", it.key()), it.value().lossEwma);
+        }
+    }
+    writer.histogram("simplechat_link_rtt_seconds", "Link probe round-trip times", metrics.linkRttSeconds);
+    writer.histogram("simplechat_datagram_received_bytes", "Sizes of received datagrams", metrics.datagramBytes);
+    writer.histogram("simplechat_delivery_latency_seconds", "Origin-to-delivery time of traced private messages",
+                     metrics.deliveryLatencySeconds);
+    writer.histogram("simplechat_hop_queue_seconds", "Per-relay arrival-to-departure time of traced private messages",
+                     metrics.hopQueueSeconds);
+
+    return writer.text();
+}
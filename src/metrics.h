@@ -0,0 +1,112 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+#include "message.h"
+
+class NetworkManager;
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+// Fixed-bucket histogram. Bucket i counts observations <= upperBounds[i];
+// one extra bucket catches everything above the last bound (+Inf).
+class Histogram {
+public:
+    explicit Histogram(const QVector<double>& upperBounds = QVector<double>());
+
+    void observe(double value);
+
+    const QVector<double>& upperBounds() const { return bounds; }
+    const QVector<quint64>& bucketCounts() const { return counts; }  // Per bucket, not cumulative
+    quint64 count() const { return total; }
+    double sum() const { return valueSum; }
+
+private:
+    QVector<double> bounds;
+    QVector<quint64> counts;
+    quint64 total;
+    double valueSum;
+};
+
+// Counters the networking code bumps inline. A NetworkManager, its socket and
+// its timers all live on one thread, so plain integers are race-free; they
+// are aggregated and formatted only when someone scrapes.
+struct NodeMetrics {
+    quint64 packetsIn[Message::TYPE_COUNT];
+    quint64 bytesIn[Message::TYPE_COUNT];
+    quint64 packetsOut[Message::TYPE_COUNT];
+    quint64 bytesOut[Message::TYPE_COUNT];
+    quint64 decodeFailures;  // Unparseable datagrams, or an unknown message type
+    quint64 sendFailures;  // writeDatagram() errors
+    quint64 parkedNoRoute;  // Private messages parked while a route is discovered
+    quint64 dropsNoRoute;  // Parked messages discarded: queue full, or discovery gave up
+    quint64 dropsHopLimit;
+    quint64 routeChanges;  // Routes added, re-pathed or invalidated
+    Histogram linkRttSeconds;  // Every link probe RTT sample
+    Histogram datagramBytes;  // Size of every received datagram
+    Histogram deliveryLatencySeconds;  // Origin send to delivery here, traced messages only
+    Histogram hopQueueSeconds;  // Arrival to departure at each relay of a traced message
+
+    NodeMetrics();
+
+    void countIn(Message::MessageType type, int bytes);
+    void countOut(Message::MessageType type, int bytes);
+};
+
+// Prometheus text exposition format (version 0.0.4)
+class PrometheusWriter {
+public:
+    void counter(const QString& name, const QString& help, double value);
+    void gauge(const QString& name, const QString& help, double value);
+    void family(const QString& name, const char* type, const QString& help);
+    void sample(const QString& name, const QString& labels, double value);
+    void histogram(const QString& name, const QString& help, const Histogram& histogram);
+
+    QByteArray text() const { return out; }
+
+    static QString label(const QString& key, const QString& value);  // key="escaped value"
+    static QString formatValue(double value);
+
+private:
+    QByteArray out;
+};
+
+// Serves a node's metrics at http://127.0.0.1:<port>/metrics and/or writes
+// them to a file (atomically) every DUMP_INTERVAL and when the application quits.
+class MetricsServer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit MetricsServer(NetworkManager* manager, QObject* parent = nullptr);
+    ~MetricsServer();
+
+    bool listen(quint16 port);  // Loopback only; 0 picks a free port
+    quint16 serverPort() const;
+
+    void setDumpFile(const QString& path, int intervalMs = DUMP_INTERVAL);
+    bool writeFile(const QString& path) const;
+
+    QByteArray render() const;
+
+    static const int DUMP_INTERVAL = 10000;  // 10 seconds
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDumpTimeout();
+
+private:
+    void respond(QTcpSocket* socket, const QByteArray& status, const QByteArray& body);
+
+    NetworkManager* networkManager;
+    QTcpServer* server;
+    QTimer* dumpTimer;
+    QString dumpFile;
+    QHash<QTcpSocket*, QByteArray> requests;  // Partial request headers per connection
+
+    static const int MAX_REQUEST_SIZE = 8192;
+};
@@ -5,9 +5,45 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QRandomGenerator>
+#include <QDir>
+#include <QSaveFile>
+#include <QDataStream>
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <chrono>
+
+namespace {
+
+qint64 replayClockMs = 0;
+
+// Delivery traces compare timestamps taken on different nodes, so they use wall-clock time
+qint64 wallClockUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+}
+
+qint64 networkClockMs() {
+    return replayClockMs > 0 ? replayClockMs : QDateTime::currentMSecsSinceEpoch();
+}
+
+void setReplayClockMs(qint64 epochMs) {
+    replayClockMs = epochMs;
+}
 
 NetworkManager::NetworkManager(QObject* parent)
-    : QObject(parent), socket(nullptr), serverPort(0), routeSeqNo(1), noForwardMode(false) {
+    : QObject(parent), socket(nullptr), serverPort(0), nextProbeSeq(1),
+      rumorMode(RUMOR_PUSH), rumorFanout(DEFAULT_RUMOR_FANOUT), rumorStopK(DEFAULT_RUMOR_STOP_K),
+      storeDigest(0), antiEntropyInterval(ANTI_ENTROPY_INTERVAL), antiEntropyActivity(false),
+      catchUpByteRate(DEFAULT_CATCH_UP_BYTE_RATE), reclaimedMessages(0), reclaimedBytes(0),
+      messageLog(nullptr), logSyncTimer(nullptr), restoringFromLog(false), logSyncTicks(0),
+      packetCapture(nullptr), transmitEnabled(true), randomGenerator(QRandomGenerator::global()),
+      packetLogging(false),
+      deliveryTraceRate(0.0), datagramArrivalUs(0),
+      nextSequenceNumber(1), lastBroadcastSequence(0), pendingRouteMessageCount(0), nextRouteRequestId(1),
+      routeSeqNo(0), triggeredUpdatePending(false), noForwardMode(false) {
 
     socket = new QUdpSocket(this);
     connect(socket, &QUdpSocket::readyRead, this, &NetworkManager::onDataReceived);
@@ -27,12 +63,243 @@ NetworkManager::NetworkManager(QObject* parent)
     // PA3: Route rumor timer (60 seconds)
     routeRumorTimer = new QTimer(this);
     connect(routeRumorTimer, &QTimer::timeout, this, &NetworkManager::sendRouteRumor);
+
+    // Link quality probe timer
+    linkProbeTimer = new QTimer(this);
+    connect(linkProbeTimer, &QTimer::timeout, this, &NetworkManager::sendLinkProbes);
+
+    // Rumor mongering rounds
+    rumorRoundTimer = new QTimer(this);
+    connect(rumorRoundTimer, &QTimer::timeout, this, &NetworkManager::runRumorRound);
+
+    // Broadcast tree timer
+    broadcastTreeTimer = new QTimer(this);
+    connect(broadcastTreeTimer, &QTimer::timeout, this, &NetworkManager::runBroadcastTreeTick);
+
+    // Catch-up pacing timer (runs only while streams are queued)
+    catchUpTimer = new QTimer(this);
+    connect(catchUpTimer, &QTimer::timeout, this, &NetworkManager::runCatchUpTick);
+
+    // Gap repair timer (runs only while gaps are open)
+    gapRepairTimer = new QTimer(this);
+    connect(gapRepairTimer, &QTimer::timeout, this, &NetworkManager::checkGapRepairs);
+
+    // Store compaction timer
+    compactionTimer = new QTimer(this);
+    connect(compactionTimer, &QTimer::timeout, this, &NetworkManager::compactStore);
 }
 
 NetworkManager::~NetworkManager() {
     if (socket) {
         socket->close();
     }
+
+    if (messageLog) {
+        saveLogSnapshot();
+        saveTopologySnapshot();
+        delete messageLog;
+    }
+
+    disableCapture();
+
+    if (!traceFile.isEmpty() && !trace.save(traceFile)) {
+        qDebug() << "Failed to write trace file" << traceFile;
+    }
+}
+
+bool NetworkManager::enablePersistence(const QString& dataDir, MessageLog::SyncPolicy policy) {
+    if (messageLog) {
+        return true;
+    }
+
+    // Counters and low water marks first, so dead records are skipped without parsing
+    MessageLog::Snapshot snapshot;
+    if (MessageLog::loadSnapshot(dataDir, &snapshot)) {
+        vectorClock = snapshot.vectorClock;
+        nextSequenceNumber = qMax(nextSequenceNumber, snapshot.nextSequenceNumber);
+        for (auto it = snapshot.lowWaterMarks.begin(); it != snapshot.lowWaterMarks.end(); ++it) {
+            lowWaterMarks[it.key()] = it.value().toInt();
+        }
+    }
+
+    MessageLog* log = new MessageLog(policy);
+    restoringFromLog = true;
+    bool opened = log->open(dataDir, [this](const MessageLog::Entry& entry, const char* payload, int length) {
+        if (entry.sequenceNumber <= lowWaterMarks.value(entry.origin, 0) || hasMessage(entry.messageId)) {
+            return false;
+        }
+
+        Message message = Message::fromDatagram(QByteArray::fromRawData(payload, length));
+        if (message.getMessageId() != entry.messageId) {
+            return false;
+        }
+
+        storeMessage(message);
+        updateVectorClock(message.getOrigin(), message.getSequenceNumber());
+        return hasMessage(entry.messageId);
+    });
+    restoringFromLog = false;
+
+    // Our own messages may be newer than the last snapshot
+    nextSequenceNumber = qMax(nextSequenceNumber, vectorClock.value(nodeId, 0).toInt() + 1);
+    const QMap<int, QString> ownMessages = originIndex.value(nodeId);
+    for (auto it = ownMessages.end(); it != ownMessages.begin() && lastBroadcastSequence == 0; ) {
+        --it;
+        if (messageStore.value(it.value()).isBroadcast()) {
+            lastBroadcastSequence = it.key();
+        }
+    }
+
+    if (!opened) {
+        delete log;
+        return false;
+    }
+    messageLog = log;
+    dataDirectory = dataDir;
+    restoreTopologySnapshot();
+
+    logSyncTimer = new QTimer(this);
+    connect(logSyncTimer, &QTimer::timeout, this, &NetworkManager::syncMessageLog);
+    logSyncTimer->start(LOG_SYNC_INTERVAL);
+
+    qDebug().noquote() << QString("[LOG] Restored %1 messages from %2 (%3 segments)")
+                           .arg(messageStore.size()).arg(dataDir).arg(messageLog->segmentCount());
+    return true;
+}
+
+void NetworkManager::syncMessageLog() {
+    if (!messageLog) {
+        return;
+    }
+
+    messageLog->sync();
+    if (++logSyncTicks >= LOG_SNAPSHOT_TICKS) {
+        logSyncTicks = 0;
+        saveLogSnapshot();
+        saveTopologySnapshot();
+    }
+}
+
+void NetworkManager::saveLogSnapshot() {
+    MessageLog::Snapshot snapshot;
+    snapshot.vectorClock = vectorClock;
+    snapshot.nextSequenceNumber = nextSequenceNumber;
+    snapshot.lowWaterMarks = lowWaterMarkMap();
+    messageLog->saveSnapshot(snapshot);
+}
+
+void NetworkManager::saveTopologySnapshot() const {
+    // Only what was confirmed live; provisional entries that were never confirmed are not carried forward
+    QSaveFile file(QDir(dataDirectory).filePath("topology.dat"));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << TOPOLOGY_SNAPSHOT_VERSION << networkClockMs() << static_cast<qint32>(routeSeqNo);
+
+    QList<PeerInfo> livePeers;
+    for (const PeerInfo& peer : peers) {
+        if (peer.isActive && !peer.provisional) {
+            livePeers.append(peer);
+        }
+    }
+    stream << static_cast<qint32>(livePeers.size());
+    for (const PeerInfo& peer : livePeers) {
+        stream << peer.peerId << peer.host << static_cast<qint32>(peer.port)
+               << peer.rttEwma << peer.lossEwma << static_cast<qint32>(peer.probeSamples);
+    }
+
+    QStringList destinations;
+    for (auto it = routingTable.begin(); it != routingTable.end(); ++it) {
+        if (it.value().isReachable() && !it.value().provisional) {
+            destinations.append(it.key());
+        }
+    }
+    stream << static_cast<qint32>(destinations.size());
+    for (const QString& destination : destinations) {
+        const RouteInfo& route = routingTable[destination];
+        stream << destination << route.nextHop << route.nextHopIP << route.nextHopPort
+               << static_cast<qint32>(route.seqNo) << route.isDirect << static_cast<qint32>(route.hopCount);
+    }
+
+    if (stream.status() == QDataStream::Ok) {
+        file.commit();
+    }
+}
+
+void NetworkManager::restoreTopologySnapshot() {
+    QFile file(QDir(dataDirectory).filePath("topology.dat"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    quint32 version = 0;
+    qint64 savedAt = 0;
+    qint32 savedRouteSeqNo = 0;
+    stream >> version;
+    if (version != TOPOLOGY_SNAPSHOT_VERSION) {
+        return;
+    }
+    stream >> savedAt >> savedRouteSeqNo;
+
+    // Our DSDV sequence number must never go backwards, or neighbours ignore us until it catches up
+    routeSeqNo = qMax(routeSeqNo, savedRouteSeqNo + (savedRouteSeqNo % 2));
+
+    // Anything older than a route timeout would have expired while we were down
+    qint64 now = networkClockMs();
+    if (now - savedAt > ROUTE_TIMEOUT) {
+        return;
+    }
+
+    qint32 peerCount = 0;
+    stream >> peerCount;
+    for (qint32 i = 0; i < peerCount && stream.status() == QDataStream::Ok; ++i) {
+        QString peerId;
+        QString host;
+        qint32 port = 0;
+        double rttEwma = 0.0;
+        double lossEwma = 0.0;
+        qint32 probeSamples = 0;
+        stream >> peerId >> host >> port >> rttEwma >> lossEwma >> probeSamples;
+        if (stream.status() != QDataStream::Ok || peerId == nodeId || peers.contains(peerId)) {
+            continue;
+        }
+
+        // Usable straight away; dropped quietly if not heard from within PEER_TIMEOUT
+        PeerInfo peer(peerId, host, port);
+        peer.rttEwma = rttEwma;
+        peer.lossEwma = lossEwma;
+        peer.probeSamples = probeSamples;
+        peer.provisional = true;
+        peers[peerId] = peer;
+        emit peerDiscovered(peerId, host, port);
+    }
+
+    qint32 routeCount = 0;
+    stream >> routeCount;
+    for (qint32 i = 0; i < routeCount && stream.status() == QDataStream::Ok; ++i) {
+        QString destination;
+        QString nextHop;
+        QString nextHopIP;
+        quint16 nextHopPort = 0;
+        qint32 seqNo = 0;
+        bool isDirect = false;
+        qint32 hopCount = 0;
+        stream >> destination >> nextHop >> nextHopIP >> nextHopPort >> seqNo >> isDirect >> hopCount;
+        if (stream.status() != QDataStream::Ok || destination == nodeId || routingTable.contains(destination) ||
+            !peers.contains(nextHop)) {
+            continue;
+        }
+
+        RouteInfo route(nextHop, nextHopIP, nextHopPort, seqNo, isDirect, hopCount);
+        route.provisional = true;
+        routingTable[destination] = route;
+    }
+
+    qDebug().noquote() << QString("[WARM START] Restored %1 peers and %2 routes as provisional")
+                           .arg(peers.size()).arg(routingTable.size());
 }
 
 bool NetworkManager::startServer(int port) {
@@ -45,10 +312,19 @@ bool NetworkManager::startServer(int port) {
     qDebug() << "UDP server started on port" << port;
 
     // Start timers
-    antiEntropyTimer->start(ANTI_ENTROPY_INTERVAL);
+    antiEntropyTimer->start(antiEntropyInterval);
     ackCheckTimer->start(ACK_CHECK_INTERVAL);
     peerHealthTimer->start(PEER_HEALTH_CHECK_INTERVAL);
     routeRumorTimer->start(ROUTE_RUMOR_INTERVAL);
+    linkProbeTimer->start(LINK_PROBE_INTERVAL);
+    rumorRoundTimer->start(RUMOR_ROUND_INTERVAL);
+    broadcastTreeTimer->start(BROADCAST_TREE_TICK);
+    compactionTimer->start(STORE_COMPACTION_INTERVAL);
+
+    // Confirm (or weed out) peers restored from the warm-start cache without waiting a probe period
+    if (!peers.isEmpty()) {
+        QTimer::singleShot(0, this, &NetworkManager::sendLinkProbes);
+    }
 
     // PA3: Send initial route rumor on startup
     QTimer::singleShot(1000, this, &NetworkManager::sendRouteRumor);
@@ -64,6 +340,9 @@ void NetworkManager::addPeer(const QString& peerId, const QString& host, int por
     PeerInfo peerInfo(peerId, host, port);
     peers[peerId] = peerInfo;
 
+    // A new neighbour may hold a lot we lack; sync quickly
+    resetAntiEntropyInterval();
+
     // Don't log here, logged in processReceivedMessage
     emit peerDiscovered(peerId, host, port);
 }
@@ -79,14 +358,14 @@ void NetworkManager::discoverLocalPeers(const QList<int>& portRange) {
 
         Message discoveryMsg("", nodeId, "discovery", 0, Message::ANTI_ENTROPY_REQUEST);
         QByteArray datagram = discoveryMsg.toDatagram();
-        sendDatagram(datagram, QHostAddress::LocalHost, port);
+        sendDatagram(datagram, QHostAddress::LocalHost, port, discoveryMsg.getType());
     }
 }
 
-void NetworkManager::sendMessage(const Message& message) {
+QString NetworkManager::sendMessage(const Message& message) {
     if (!message.isValid() && message.getType() != Message::ANTI_ENTROPY_REQUEST) {
         qDebug() << "Invalid message, not sending";
-        return;
+        return QString();
     }
 
     Message msgToSend = message;
@@ -94,16 +373,15 @@ void NetworkManager::sendMessage(const Message& message) {
 
     // Assign sequence number for chat messages
     if (msgToSend.getType() == Message::CHAT_MESSAGE) {
-        const QString& destination = msgToSend.getDestination();
-        QString seqKey = destination;
+        msgToSend.setSequenceNumber(nextSequenceNumber++);
+        msgToSend.setMessageId(msgToSend.generateMessageId());
 
-        if (!nextSequenceNumbers.contains(seqKey)) {
-            nextSequenceNumbers[seqKey] = 1;
+        // Broadcasts link back to the previous one; private messages use the same counter
+        if (msgToSend.isBroadcast()) {
+            msgToSend.setPreviousBroadcast(lastBroadcastSequence);
+            lastBroadcastSequence = msgToSend.getSequenceNumber();
         }
 
-        msgToSend.setSequenceNumber(nextSequenceNumbers[seqKey]++);
-        msgToSend.setMessageId(msgToSend.generateMessageId());
-
         // Update own vector clock
         updateVectorClock(nodeId, msgToSend.getSequenceNumber());
 
@@ -114,7 +392,17 @@ void NetworkManager::sendMessage(const Message& message) {
     // Set vector clock
     msgToSend.setVectorClock(vectorClock);
 
-    if (!msgToSend.getChatText().isEmpty()) {
+    // Sampled private messages carry a delivery trace header (the stored copy does not)
+    if (msgToSend.getType() == Message::CHAT_MESSAGE && !msgToSend.isBroadcast() && deliveryTraceRate > 0.0 &&
+        randomGenerator->generateDouble() < deliveryTraceRate) {
+        QVariantMap header;
+        header["Sent"] = wallClockUs();
+        msgToSend.setDeliveryTrace(header);
+    }
+
+    trace.record(EventTrace::SEND, msgToSend.getDestination(), QString(),
+                 static_cast<quint32>(msgToSend.getSequenceNumber()), static_cast<quint16>(msgToSend.getType()));
+    if (packetLogging && !msgToSend.getChatText().isEmpty()) {
         qDebug().noquote() << QString("[SEND] %1 -> %2: \"%3\"")
                                .arg(msgToSend.getOrigin())
                                .arg(msgToSend.getDestination())
@@ -126,17 +414,29 @@ void NetworkManager::sendMessage(const Message& message) {
     } else {
         sendDirectMessage(msgToSend, msgToSend.getDestination());
     }
+    return msgToSend.getMessageId();
 }
 
 void NetworkManager::sendDirectMessage(const Message& message, const QString& peerId, bool requireAck) {
-    if (!peers.contains(peerId)) {
-        qDebug() << "Unknown peer:" << peerId;
-        return;
+    auto peerIt = peers.constFind(peerId);
+    bool directlyReachable = peerIt != peers.constEnd() && peerIt.value().isActive;
+
+    // Prefer the routing table when the destination is not an active neighbour
+    NextHopInfo hop;
+    if (!directlyReachable) {
+        hop = selectNextHop(peerId, nodeId);
     }
 
-    PeerInfo& peer = peers[peerId];
     QByteArray datagram = message.toDatagram();
-    sendDatagram(datagram, QHostAddress(peer.host), peer.port);
+    if (!hop.peerId.isEmpty()) {
+        sendDatagram(datagram, QHostAddress(hop.ip), hop.port, message.getType());
+    } else if (peerIt != peers.constEnd()) {
+        sendDatagram(datagram, QHostAddress(peerIt.value().host), peerIt.value().port, message.getType());
+    } else {
+        qDebug() << "Unknown peer:" << peerId << "- starting route discovery";
+        queueForRouteDiscovery(message, peerId, requireAck, false);
+        return;
+    }
 
     // For chat messages, track for ACK (only for direct messages, not broadcasts)
     // Only add if not already tracking to avoid overwriting during retries
@@ -148,7 +448,7 @@ void NetworkManager::sendDirectMessage(const Message& message, const QString& pe
         PendingMessage pending;
         pending.message = message;
         pending.targetPeerId = peerId;
-        pending.sentTime = QDateTime::currentMSecsSinceEpoch();
+        pending.sentTime = networkClockMs();
         pending.retryCount = 0;
 
         pendingAcks[message.getMessageId()] = pending;
@@ -156,24 +456,37 @@ void NetworkManager::sendDirectMessage(const Message& message, const QString& pe
 }
 
 void NetworkManager::sendBroadcastMessage(const Message& message) {
-    qDebug() << "Broadcasting message to all peers";
-
-    for (auto it = peers.begin(); it != peers.end(); ++it) {
-        const PeerInfo& peer = it.value();
-        if (peer.isActive) {
-            QByteArray datagram = message.toDatagram();
-            sendDatagram(datagram, QHostAddress(peer.host), peer.port);
-        }
+    if (packetLogging) {
+        qDebug() << "Broadcasting message to all peers";
     }
 
+    // Eager push along the broadcast tree, lazy announcements elsewhere
+    pushBroadcast(message, Endpoint());
+
     // For broadcast chat messages, we don't track ACKs (gossip-style)
 }
 
-void NetworkManager::sendDatagram(const QByteArray& datagram, const QHostAddress& host, quint16 port) {
+void NetworkManager::sendMessageDatagram(const Message& message, const QHostAddress& host, quint16 port) {
+    sendDatagram(message.toDatagram(), host, port, message.getType());
+}
+
+void NetworkManager::sendDatagram(const QByteArray& datagram, const QHostAddress& host, quint16 port,
+                                  Message::MessageType type) {
+    metrics.countOut(type, static_cast<int>(datagram.size()));
+    if (!transmitEnabled) {
+        trafficStats.datagramsSent++;
+        trafficStats.bytesSent += static_cast<quint64>(datagram.size());
+        return;
+    }
+
     qint64 sent = socket->writeDatagram(datagram, host, port);
     if (sent == -1) {
+        metrics.sendFailures++;
         qDebug() << "Failed to send datagram:" << socket->errorString();
+        return;
     }
+    trafficStats.datagramsSent++;
+    trafficStats.bytesSent += static_cast<quint64>(sent);
 }
 
 void NetworkManager::onDataReceived() {
@@ -186,18 +499,73 @@ void NetworkManager::onDataReceived() {
         qint64 received = socket->readDatagram(datagram.data(), datagram.size(), &senderHost, &senderPort);
 
         if (received > 0) {
-            Message message = Message::fromDatagram(datagram);
-
-            if (message.getOrigin() == nodeId) {
-                // Ignore messages from self
-                continue;
+            trafficStats.datagramsReceived++;
+            trafficStats.bytesReceived += static_cast<quint64>(received);
+            if (packetCapture) {
+                packetCapture->record(datagram, senderHost, senderPort, socket->localAddress(), socket->localPort());
             }
-
-            processReceivedMessage(message, senderHost, senderPort);
+            injectDatagram(datagram, senderHost, senderPort);
         }
     }
 }
 
+void NetworkManager::injectDatagram(const QByteArray& datagram, const QHostAddress& senderHost, quint16 senderPort) {
+    datagramArrivalUs = wallClockUs();
+    Message message = Message::fromDatagram(datagram);
+    metrics.datagramBytes.observe(datagram.size());
+
+    if (message.getOrigin().isEmpty()) {
+        // Not JSON, or not one of ours: nothing in it can be acted on
+        metrics.decodeFailures++;
+        return;
+    }
+    metrics.countIn(message.getType(), static_cast<int>(datagram.size()));
+    trace.record(EventTrace::RECEIVE, message.getOrigin(), QString(),
+                 static_cast<quint32>(message.getSequenceNumber()), static_cast<quint16>(message.getType()));
+
+    if (message.getOrigin() == nodeId) {
+        // Ignore messages from self
+        return;
+    }
+
+    processReceivedMessage(message, senderHost, senderPort);
+}
+
+void NetworkManager::setRandomSeed(quint32 seed) {
+    seededRandom.seed(seed);
+    randomGenerator = &seededRandom;
+}
+
+void NetworkManager::enableTrace(const QString& path, int capacity) {
+    trace.enable(nodeId, capacity);
+    traceFile = path;
+    qDebug().noquote() << QString("[TRACE] Recording packet events%1")
+                              .arg(path.isEmpty() ? QString() : QString(" (saved to %1 on exit)").arg(path));
+}
+
+bool NetworkManager::enableCapture(const QString& path) {
+    disableCapture();
+
+    PacketCapture* capture = new PacketCapture();
+    if (!capture->open(path)) {
+        delete capture;
+        return false;
+    }
+    packetCapture = capture;
+    qDebug().noquote() << QString("[CAPTURE] Recording received datagrams to %1").arg(path);
+    return true;
+}
+
+void NetworkManager::disableCapture() {
+    if (!packetCapture) {
+        return;
+    }
+    qDebug().noquote() << QString("[CAPTURE] Stopped after %1 datagrams in %2")
+                              .arg(packetCapture->recordCount()).arg(packetCapture->fileName());
+    delete packetCapture;
+    packetCapture = nullptr;
+}
+
 void NetworkManager::processReceivedMessage(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
     // Update peer info
     QString senderId = message.getOrigin();
@@ -206,22 +574,38 @@ void NetworkManager::processReceivedMessage(const Message& message, const QHostA
         qDebug().noquote() << QString("[PEER] + Discovered: %1 (%2:%3)")
                                .arg(senderId).arg(senderHost.toString()).arg(senderPort);
     } else {
-        peers[senderId].lastSeen = QDateTime::currentMSecsSinceEpoch();
+        peers[senderId].lastSeen = networkClockMs();
+        peers[senderId].provisional = false;
         if (!peers[senderId].isActive) {
             peers[senderId].isActive = true;
             emit peerStatusChanged(senderId, true);
+
+            // Back from a disruption: catch up fast
+            resetAntiEntropyInterval();
         }
     }
 
     switch (message.getType()) {
         case Message::CHAT_MESSAGE:
-            handleChatMessage(message);
+            handleChatMessage(message, senderHost, senderPort);
             break;
         case Message::ANTI_ENTROPY_REQUEST:
             handleAntiEntropyRequest(message, senderHost, senderPort);
             break;
         case Message::ANTI_ENTROPY_RESPONSE:
-            handleAntiEntropyResponse(message);
+            handleAntiEntropyResponse(message, senderHost, senderPort);
+            break;
+        case Message::ANTI_ENTROPY_DIGEST:
+            handleAntiEntropyDigest(message, senderHost, senderPort);
+            break;
+        case Message::ANTI_ENTROPY_IBLT:
+            handleAntiEntropyIblt(message, senderHost, senderPort);
+            break;
+        case Message::ANTI_ENTROPY_FETCH:
+            handleAntiEntropyFetch(message, senderHost, senderPort);
+            break;
+        case Message::GAP_NACK:
+            handleGapNack(message, senderHost, senderPort);
             break;
         case Message::ACK:
             // PA3: Check if ACK is for us, otherwise forward it
@@ -236,385 +620,2284 @@ void NetworkManager::processReceivedMessage(const Message& message, const QHostA
         case Message::ROUTE_RUMOR:
             handleRouteRumor(message, senderHost, senderPort);
             break;
+        case Message::ROUTE_ADVERTISEMENT:
+            handleRouteAdvertisement(message, senderHost, senderPort);
+            break;
+        case Message::LINK_PROBE:
+            handleLinkProbe(message, senderHost, senderPort);
+            break;
+        case Message::LINK_PROBE_REPLY:
+            handleLinkProbeReply(message);
+            break;
+        case Message::ROUTE_REQUEST:
+            handleRouteRequest(message, senderHost, senderPort);
+            break;
+        case Message::ROUTE_REPLY:
+            handleRouteReply(message, senderHost, senderPort);
+            break;
+        case Message::RUMOR_FEEDBACK:
+            handleRumorFeedback(message);
+            break;
+        case Message::RUMOR_PULL:
+            handleRumorPull(message, senderHost, senderPort);
+            break;
+        case Message::GOSSIP_IHAVE:
+            handleIHave(message, senderHost, senderPort);
+            break;
+        case Message::GOSSIP_GRAFT:
+            handleGraft(message, senderHost, senderPort);
+            break;
+        case Message::GOSSIP_PRUNE:
+            handlePrune(senderHost, senderPort);
+            break;
     }
 }
 
-void NetworkManager::handleChatMessage(const Message& message) {
+void NetworkManager::handleChatMessage(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    if (message.isBroadcast()) {
+        handleBroadcastMessage(message, senderHost, senderPort);
+        return;
+    }
+
     // PA3: Check if message is for us
-    bool isForUs = message.getDestination() == nodeId || message.isBroadcast();
-    bool alreadyHave = hasMessage(message.getMessageId());
+    bool isForUs = message.getDestination() == nodeId;
+
+    if (!isForUs) {
+        // Relay hop: keep neither the payload nor a vector clock entry, just the ID for a while
+        if (!rememberTransit(message)) {
+            gossipStats.transitDuplicates++;
+            return;
+        }
+
+        // PA3: Message is not for us, try to forward it
+        gossipStats.transitForwarded++;
+        Message forwardMsg = message;
+        forwardMessage(forwardMsg);
+        return;
+    }
+
+    bool alreadyHave = isKnown(message);
 
     // Store message if we haven't seen it
     if (!alreadyHave) {
+        if (message.hasDeliveryTrace()) {
+            recordDeliveryTrace(message);
+        }
         storeMessage(message);
         updateVectorClock(message.getOrigin(), message.getSequenceNumber());
     }
 
-    // PA3: If message is for us, deliver it
-    if (isForUs && message.getOrigin() != nodeId) {
+    // PA3: Deliver it (end-to-end ACK retries, not gap NACKs, recover lost private messages)
+    if (message.getOrigin() != nodeId) {
         // Skip if in noforward mode and it's a chat message
         if (!noForwardMode || message.getChatText().isEmpty()) {
-            if (message.isBroadcast() || !alreadyHave) {
+            if (!alreadyHave) {
                 qDebug().noquote() << QString("[MESSAGE] ✓ Received from %1: \"%2\"")
                                        .arg(message.getOrigin()).arg(message.getChatText());
                 emit messageReceived(message);
             }
         }
 
-        // Send ACK if it's directly to us (not broadcast) and is new
-        if (!alreadyHave && message.getDestination() == nodeId) {
+        // Send ACK if it's new
+        if (!alreadyHave) {
             Message ack("", nodeId, message.getOrigin(), 0, Message::ACK);
             ack.setMessageId(message.getMessageId());
             sendDirectMessage(ack, message.getOrigin());
         }
-    } else if (!isForUs && !message.isBroadcast()) {
-        // PA3: Message is not for us, try to forward it
-        Message forwardMsg = message;
-        forwardMessage(forwardMsg);
     }
 }
 
-void NetworkManager::handleAntiEntropyRequest(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
-    QString senderId = message.getOrigin();
+void NetworkManager::appendTraceHop(Message& message, qint64 arrivalUs) const {
+    if (!message.hasDeliveryTrace()) {
+        return;
+    }
+    QVariantMap header = message.getDeliveryTrace();
+    QVariantList hops = header.value("Hops").toList();
+    hops.append(QVariant(QVariantList() << nodeId << arrivalUs << wallClockUs()));
+    header["Hops"] = hops;
+    message.setDeliveryTrace(header);
+}
 
-    // Compare vector clocks
-    QVariantMap remoteVectorClock = message.getVectorClock();
-    QList<Message> missingMessages = getMissingMessages(remoteVectorClock);
+void NetworkManager::recordDeliveryTrace(const Message& message) {
+    QVariantMap header = message.getDeliveryTrace();
+    DeliveryTrace trace;
+    trace.messageId = message.getMessageId();
+    trace.origin = message.getOrigin();
+    trace.sentUs = header.value("Sent").toLongLong();
+    trace.deliveredUs = datagramArrivalUs;
+
+    for (const QVariant& entry : header.value("Hops").toList()) {
+        QVariantList fields = entry.toList();
+        if (fields.size() < 3) {
+            continue;
+        }
+        DeliveryTrace::Hop hop;
+        hop.nodeId = fields[0].toString();
+        hop.arrivalUs = fields[1].toLongLong();
+        hop.departureUs = fields[2].toLongLong();
+        trace.hops.append(hop);
+        metrics.hopQueueSeconds.observe(qMax<qint64>(0, hop.departureUs - hop.arrivalUs) / 1e6);
+    }
+    if (trace.sentUs > 0) {
+        metrics.deliveryLatencySeconds.observe(qMax<qint64>(0, trace.deliveredUs - trace.sentUs) / 1e6);
+    }
 
-    // Only log if there are missing messages
-    if (!missingMessages.isEmpty()) {
-        qDebug() << "Anti-entropy: Sending" << missingMessages.size() << "missing messages to" << senderId;
+    deliveryTraces.append(trace);
+    while (deliveryTraces.size() > MAX_DELIVERY_TRACES) {
+        deliveryTraces.removeFirst();
+    }
+}
+
+bool NetworkManager::rememberTransit(const Message& message) {
+    qint64 now = networkClockMs();
+    const QString& messageId = message.getMessageId();
+
+    // Expire from the front; every entry has the same TTL
+    while (!transitOrder.isEmpty() && transitOrder.head().first <= now) {
+        QPair<qint64, QString> entry = transitOrder.dequeue();
+        auto it = transitCache.find(entry.second);
+        if (it != transitCache.end() && it.value().expiry == entry.first) {
+            transitCache.erase(it);
+        }
+    }
+
+    auto it = transitCache.find(messageId);
+    if (it != transitCache.end()) {
+        // The origin's ACK retries come back with the same hop limit and must get through
+        if (message.getHopLimit() < it.value().hopLimit) {
+            return false;
+        }
+        it.value().hopLimit = message.getHopLimit();
+        return true;
+    }
+
+    // Full: forget the oldest ID early
+    if (transitCache.size() >= MAX_TRANSIT_CACHE_ENTRIES && !transitOrder.isEmpty()) {
+        transitCache.remove(transitOrder.dequeue().second);
     }
 
+    TransitEntry entry;
+    entry.expiry = now + TRANSIT_CACHE_TTL;
+    entry.hopLimit = message.getHopLimit();
+    transitCache.insert(messageId, entry);
+    transitOrder.enqueue(qMakePair(entry.expiry, messageId));
+    return true;
+}
+
+void NetworkManager::handleAntiEntropyRequest(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    QString senderId = message.getOrigin();
+
+    recordPeerClock(senderHost, senderPort, message.getVectorClock());
+
     // Send response with our vector clock
     Message response("", nodeId, senderId, 0, Message::ANTI_ENTROPY_RESPONSE);
     response.setVectorClock(vectorClock);
+    response.setDigests(message.getDigests());
+    sendMessageDatagram(response, senderHost, senderPort);
 
-    // Include missing messages in the response
-    // For simplicity, we send them as separate messages
-    sendDatagram(response.toDatagram(), senderHost, senderPort);
+    // Stream what the peer lacks (limited to the origins whose digests differ, if scoped)
+    int queued = queueCatchUp(senderId, senderHost, senderPort, message.getVectorClock(), message.getDigests());
 
-    for (const Message& msg : missingMessages) {
-        sendDatagram(msg.toDatagram(), senderHost, senderPort);
+    // Only log if there are missing messages
+    if (queued > 0) {
+        qDebug() << "Anti-entropy: Streaming" << queued << "missing messages to" << senderId;
+        noteDivergence(senderId, queued);
     }
 }
 
-void NetworkManager::handleAntiEntropyResponse(const Message& message) {
-    // Update our knowledge of what the peer has
-    QVariantMap remoteVectorClock = message.getVectorClock();
+void NetworkManager::handleAntiEntropyResponse(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    recordPeerClock(senderHost, senderPort, message.getVectorClock());
 
-    // Send missing messages to the peer
-    QList<Message> missingMessages = getMissingMessages(remoteVectorClock);
+    // Stream what the peer lacks according to its vector clock
+    int queued = queueCatchUp(message.getOrigin(), senderHost, senderPort,
+                              message.getVectorClock(), message.getDigests());
 
     // Only log if there are missing messages
-    if (!missingMessages.isEmpty()) {
-        qDebug() << "Anti-entropy: Sending" << missingMessages.size() << "missing messages to" << message.getOrigin();
+    if (queued > 0) {
+        qDebug() << "Anti-entropy: Streaming" << queued << "missing messages to" << message.getOrigin();
+        noteDivergence(message.getOrigin(), queued);
     }
+}
 
-    for (const Message& msg : missingMessages) {
-        sendDirectMessage(msg, message.getOrigin(), false);  // Don't require ACK for anti-entropy sync
+int NetworkManager::queueCatchUp(const QString& peerId, const QHostAddress& host, quint16 port,
+                                 const QVariantMap& remoteVectorClock, const QVariantMap& scope) {
+    Endpoint endpoint(host.toString(), port);
+    bool existing = catchUpStreams.contains(endpoint);
+    CatchUpStream& stream = catchUpStreams[endpoint];
+    if (!existing) {
+        stream.peerId = peerId;
+        stream.tokens = 0.0;
+        stream.lastRefill = networkClockMs();
     }
-}
 
-void NetworkManager::handleAck(const Message& message) {
-    QString messageId = message.getMessageId();
+    int queued = 0;
+    for (auto it = originIndex.begin(); it != originIndex.end(); ++it) {
+        const QString& origin = it.key();
+        if (!scope.isEmpty() && !scope.contains(origin)) {
+            continue;
+        }
 
-    if (pendingAcks.contains(messageId)) {
-        // Silently remove from pending - no need to log every ACK
-        pendingAcks.remove(messageId);
+        // Resume from whichever is further along: what we already streamed or what the peer reports
+        int cursor = remoteVectorClock.value(origin, 0).toInt();
+        if (stream.cursors.contains(origin)) {
+            cursor = qMax(cursor, stream.cursors[origin]);
+        }
+
+        int pending = 0;
+        for (auto seqIt = it.value().upperBound(cursor); seqIt != it.value().end(); ++seqIt) {
+            if (syncsWith(seqIt.value(), peerId)) {
+                pending++;
+            }
+        }
+        if (pending > 0) {
+            stream.cursors[origin] = cursor;
+            queued += pending;
+        }
     }
-}
 
-void NetworkManager::onAntiEntropyTimeout() {
-    performAntiEntropy();
+    if (stream.cursors.isEmpty() && stream.explicitIds.isEmpty()) {
+        catchUpStreams.remove(endpoint);
+    } else if (!catchUpTimer->isActive()) {
+        catchUpTimer->start(CATCH_UP_TICK);
+    }
+    return queued;
 }
 
-void NetworkManager::performAntiEntropy() {
-    if (peers.isEmpty()) {
+void NetworkManager::queueCatchUpIds(const QString& peerId, const QHostAddress& host, quint16 port,
+                                     const QStringList& messageIds) {
+    if (messageIds.isEmpty()) {
         return;
     }
 
-    // Send anti-entropy request to a random active peer
-    QList<QString> activePeerIds;
-    for (auto it = peers.begin(); it != peers.end(); ++it) {
-        if (it.value().isActive) {
-            activePeerIds.append(it.key());
+    Endpoint endpoint(host.toString(), port);
+    bool existing = catchUpStreams.contains(endpoint);
+    CatchUpStream& stream = catchUpStreams[endpoint];
+    if (!existing) {
+        stream.peerId = peerId;
+        stream.tokens = 0.0;
+        stream.lastRefill = networkClockMs();
+    }
+
+    for (const QString& messageId : messageIds) {
+        if (!stream.explicitIds.contains(messageId)) {
+            stream.explicitIds.append(messageId);
         }
     }
 
-    if (activePeerIds.isEmpty()) {
-        return;
+    if (!catchUpTimer->isActive()) {
+        catchUpTimer->start(CATCH_UP_TICK);
     }
+}
 
-    int randomIndex = QRandomGenerator::global()->bounded(activePeerIds.size());
-    QString randomPeerId = activePeerIds[randomIndex];
+void NetworkManager::runCatchUpTick() {
+    qint64 now = networkClockMs();
+    double burst = qMax(1.0, catchUpByteRate * 2.0 * CATCH_UP_TICK / 1000.0);
 
-    Message request("", nodeId, randomPeerId, 0, Message::ANTI_ENTROPY_REQUEST);
-    request.setVectorClock(vectorClock);
+    for (auto it = catchUpStreams.begin(); it != catchUpStreams.end(); ) {
+        CatchUpStream& stream = it.value();
 
-    // Silent - don't log routine anti-entropy
-    sendDirectMessage(request, randomPeerId);
-}
+        // Drop streams to peers that went away; the next sync round resumes from their clock
+        auto peerIt = peers.constFind(stream.peerId);
+        if (peerIt != peers.constEnd() && !peerIt.value().isActive) {
+            it = catchUpStreams.erase(it);
+            continue;
+        }
 
-void NetworkManager::checkPendingAcks() {
-    qint64 now = QDateTime::currentMSecsSinceEpoch();
-    QList<QString> toRetry;
+        stream.tokens = qMin(burst, stream.tokens + catchUpByteRate * (now - stream.lastRefill) / 1000.0);
+        stream.lastRefill = now;
 
-    for (auto it = pendingAcks.begin(); it != pendingAcks.end(); ) {
-        PendingMessage& pending = it.value();
+        QHostAddress host(it.key().first);
+        quint16 port = it.key().second;
 
-        if (now - pending.sentTime > ACK_TIMEOUT) {
-            if (pending.retryCount < MAX_RETRIES) {
-                qDebug() << "Retry sending message" << pending.message.getMessageId()
-                         << "attempt" << (pending.retryCount + 1);
-                toRetry.append(it.key());
-                ++it;
+        while (stream.tokens > 0) {
+            QString messageId;
+            if (!stream.explicitIds.isEmpty()) {
+                messageId = stream.explicitIds.takeFirst();
             } else {
-                qDebug() << "Message" << pending.message.getMessageId() << "failed after" << MAX_RETRIES << "retries";
-                it = pendingAcks.erase(it);
+                // Next message after the cursor of the first origin with anything left
+                while (!stream.cursors.isEmpty() && messageId.isEmpty()) {
+                    auto cursorIt = stream.cursors.begin();
+                    const QMap<int, QString>& sequences = originIndex.value(cursorIt.key());
+                    auto next = sequences.upperBound(cursorIt.value());
+                    if (next == sequences.end()) {
+                        stream.cursors.erase(cursorIt);
+                    } else {
+                        cursorIt.value() = next.key();
+                        messageId = next.value();
+                    }
+                }
+                if (messageId.isEmpty()) {
+                    break;
+                }
+            }
+
+            auto msgIt = messageStore.constFind(messageId);
+            if (msgIt == messageStore.constEnd() || !syncsWith(msgIt.value(), stream.peerId)) {
+                continue;
             }
+
+            Message repair = msgIt.value();
+            repair.setRepair(true);
+            QByteArray datagram = repair.toDatagram();
+            sendDatagram(datagram, host, port, repair.getType());
+            stream.tokens -= datagram.size();
+            gossipStats.catchUpMessagesSent++;
+            gossipStats.catchUpBytesSent += datagram.size();
+        }
+
+        if (stream.cursors.isEmpty() && stream.explicitIds.isEmpty()) {
+            it = catchUpStreams.erase(it);
         } else {
             ++it;
         }
     }
 
-    // Retry messages (check if still pending - ACK may have arrived)
-    for (const QString& messageId : toRetry) {
-        if (pendingAcks.contains(messageId)) {
-            PendingMessage& pending = pendingAcks[messageId];
-            pending.retryCount++;
-            pending.sentTime = now;
-            sendDirectMessage(pending.message, pending.targetPeerId);
-        }
+    if (catchUpStreams.isEmpty()) {
+        catchUpTimer->stop();
     }
 }
 
-void NetworkManager::checkPeerHealth() {
-    qint64 now = QDateTime::currentMSecsSinceEpoch();
-
-    for (auto it = peers.begin(); it != peers.end(); ++it) {
-        PeerInfo& peer = it.value();
+void NetworkManager::handleAck(const Message& message) {
+    QString messageId = message.getMessageId();
 
-        if (peer.isActive && (now - peer.lastSeen > PEER_TIMEOUT)) {
-            qDebug() << "Peer" << peer.peerId << "timed out";
-            peer.isActive = false;
+    if (pendingAcks.contains(messageId)) {
+        // Silently remove from pending - no need to log every ACK
+        pendingAcks.remove(messageId);
+    }
+}
+
+void NetworkManager::onAntiEntropyTimeout() {
+    // Halve the period while rounds keep finding differences, double it while idle
+    if (antiEntropyActivity) {
+        antiEntropyInterval = qMax(antiEntropyInterval / 2, static_cast<int>(MIN_ANTI_ENTROPY_INTERVAL));
+    } else {
+        antiEntropyInterval = qMin(antiEntropyInterval * 2, static_cast<int>(MAX_ANTI_ENTROPY_INTERVAL));
+    }
+    antiEntropyActivity = false;
+    antiEntropyTimer->start(antiEntropyInterval);
+
+    performAntiEntropy();
+}
+
+void NetworkManager::resetAntiEntropyInterval() {
+    antiEntropyInterval = MIN_ANTI_ENTROPY_INTERVAL;
+    if (antiEntropyTimer->isActive() && antiEntropyTimer->remainingTime() > antiEntropyInterval) {
+        antiEntropyTimer->start(antiEntropyInterval);
+    }
+}
+
+void NetworkManager::noteDivergence(const QString& peerId, int amount) {
+    antiEntropyActivity = true;
+
+    auto it = peers.find(peerId);
+    if (it != peers.end()) {
+        it.value().divergence += amount;
+    }
+}
+
+QString NetworkManager::pickAntiEntropyPeer() const {
+    // Weight each active peer by how stale our last sync is and how much it recently differed
+    qint64 now = networkClockMs();
+    QList<QString> candidates;
+    QList<int> weights;
+    int totalWeight = 0;
+
+    for (auto it = peers.begin(); it != peers.end(); ++it) {
+        const PeerInfo& peer = it.value();
+        if (!peer.isActive) {
+            continue;
+        }
+
+        int age = SYNC_AGE_CAP;
+        if (peer.lastSyncAt != 0) {
+            age = static_cast<int>(qMin((now - peer.lastSyncAt) / 1000, static_cast<qint64>(SYNC_AGE_CAP)));
+        }
+        int weight = 1 + age + qMin(peer.divergence, 1000) * DIVERGENCE_WEIGHT;
+        candidates.append(it.key());
+        weights.append(weight);
+        totalWeight += weight;
+    }
+
+    if (candidates.isEmpty()) {
+        return QString();
+    }
+
+    int pick = randomGenerator->bounded(totalWeight);
+    for (int i = 0; i < candidates.size(); ++i) {
+        pick -= weights[i];
+        if (pick < 0) {
+            return candidates[i];
+        }
+    }
+    return candidates.last();
+}
+
+void NetworkManager::performAntiEntropy() {
+    if (peers.isEmpty()) {
+        return;
+    }
+
+    // Prefer peers we haven't synced with for a while or that recently diverged
+    QString randomPeerId = pickAntiEntropyPeer();
+    if (randomPeerId.isEmpty()) {
+        return;
+    }
+
+    PeerInfo& peer = peers[randomPeerId];
+    peer.lastSyncAt = networkClockMs();
+    peer.divergence /= 2;
+
+    // Start with the store digest only; the peer stays silent if it matches. Both sides
+    // leave out what either has compacted, so different retention settings still agree.
+    Message digest("", nodeId, randomPeerId, 0, Message::ANTI_ENTROPY_DIGEST);
+    digest.setStoreDigest(QString::number(summaryDigest(randomPeerId, peer.lowWaterMarks), 16));
+    digest.setLowWaterMarks(lowWaterMarkMap());
+
+    // Silent - don't log routine anti-entropy
+    sendDirectMessage(digest, randomPeerId, false);
+}
+
+void NetworkManager::handleAntiEntropyDigest(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    // Private messages are only reconciled between their two endpoints
+    QString peerId = message.getOrigin();
+    QVariantMap remoteMarks = message.getLowWaterMarks();
+    auto peerIt = peers.find(peerId);
+    if (peerIt != peers.end()) {
+        peerIt.value().lowWaterMarks = remoteMarks;
+    }
+
+    if (message.getDigests().isEmpty()) {
+        // Summary round: replicas agree above both low water marks, so the peer has everything we have
+        QString ourDigest = QString::number(summaryDigest(peerId, remoteMarks), 16);
+        if (message.getStoreDigest() == ourDigest) {
+            recordPeerClock(senderHost, senderPort, vectorClock);
+            return;
+        }
+
+        // Mismatch: reply with per-origin detail (above both marks) so the initiator can narrow down
+        gossipStats.digestMismatches++;
+        Message reply("", nodeId, message.getOrigin(), 0, Message::ANTI_ENTROPY_DIGEST);
+        reply.setStoreDigest(ourDigest);
+        reply.setDigests(originDigestMap(peerId, remoteMarks));
+        reply.setLowWaterMarks(lowWaterMarkMap());
+        reply.setVectorClock(vectorClock);
+        sendMessageDatagram(reply, senderHost, senderPort);
+        return;
+    }
+
+    recordPeerClock(senderHost, senderPort, message.getVectorClock());
+
+    // Detail round: sync only the origins whose digests differ above both low water marks.
+    // The peer computed its digests over the higher mark too, having seen ours in the summary.
+    // Scope values carry that threshold so both sides reconcile the same range.
+    QVariantMap remoteDigests = message.getDigests();
+    QVariantMap localDigests = originDigestMap(peerId, remoteMarks);
+    QSet<QString> origins;
+    for (auto it = remoteDigests.begin(); it != remoteDigests.end(); ++it) {
+        origins.insert(it.key());
+    }
+    for (auto it = localDigests.begin(); it != localDigests.end(); ++it) {
+        origins.insert(it.key());
+    }
+
+    QVariantMap scope;
+    for (const QString& origin : origins) {
+        int threshold = qMax(lowWaterMarks.value(origin, 0), remoteMarks.value(origin, 0).toInt());
+        QString remoteDigest = remoteDigests.value(origin, QString("0")).toString();
+        if (localDigests.value(origin, QString("0")).toString() != remoteDigest) {
+            scope[origin] = threshold;
+        }
+    }
+
+    if (scope.isEmpty()) {
+        return;
+    }
+
+    // Reconcile the exact sets; vector clocks miss holes below the clock value
+    sendIblt(peerId, scope, INITIAL_IBLT_CELLS, senderHost, senderPort);
+}
+
+void NetworkManager::handleAntiEntropyIblt(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    int cellCount = message.getSequenceNumber();
+    QVariantMap scope = message.getDigests();
+
+    // The peer picks the size; never allocate more than we would ever send
+    if (cellCount <= 0 || cellCount > MAX_IBLT_CELLS) {
+        return;
+    }
+
+    bool ok = false;
+    Iblt remote = Iblt::fromByteArray(message.getSketch(), cellCount, &ok);
+    if (!ok) {
+        return;
+    }
+
+    Iblt difference = buildIblt(scope, cellCount, message.getOrigin());
+    difference.subtract(remote);
+
+    QList<quint64> localOnly;
+    QList<quint64> remoteOnly;
+    if (!difference.decode(&localOnly, &remoteOnly)) {
+        // Too many differences for this size: answer with a bigger table, or give up on sketches
+        if (cellCount * 2 <= MAX_IBLT_CELLS) {
+            sendIblt(message.getOrigin(), scope, cellCount * 2, senderHost, senderPort);
+        } else {
+            sendScopedSyncRequest(message.getOrigin(), scope, senderHost, senderPort);
+        }
+        return;
+    }
+
+    if (!localOnly.isEmpty() || !remoteOnly.isEmpty()) {
+        qDebug() << "Anti-entropy: Reconciled with" << message.getOrigin()
+                 << "- sending" << localOnly.size() << "fetching" << remoteOnly.size();
+        noteDivergence(message.getOrigin(), localOnly.size() + remoteOnly.size());
+    }
+
+    QStringList toSend;
+    for (quint64 key : localOnly) {
+        auto it = keyIndex.constFind(key);
+        if (it != keyIndex.constEnd() && syncsWith(it.value(), message.getOrigin())) {
+            toSend.append(it.value());
+        }
+    }
+    queueCatchUpIds(message.getOrigin(), senderHost, senderPort, toSend);
+
+    if (!remoteOnly.isEmpty()) {
+        QStringList keys;
+        for (quint64 key : remoteOnly) {
+            keys.append(QString::number(key, 16));
+        }
+
+        Message fetch("", nodeId, message.getOrigin(), 0, Message::ANTI_ENTROPY_FETCH);
+        fetch.setMessageIds(keys);
+        sendMessageDatagram(fetch, senderHost, senderPort);
+    }
+}
+
+void NetworkManager::handleAntiEntropyFetch(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    QStringList toSend;
+    for (const QString& keyHex : message.getMessageIds()) {
+        bool ok = false;
+        quint64 key = keyHex.toULongLong(&ok, 16);
+        if (!ok) {
+            continue;
+        }
+
+        // Never hand out someone else's private conversation, whatever key is asked for
+        auto it = keyIndex.constFind(key);
+        if (it != keyIndex.constEnd() && syncsWith(it.value(), message.getOrigin())) {
+            toSend.append(it.value());
+        }
+    }
+    queueCatchUpIds(message.getOrigin(), senderHost, senderPort, toSend);
+}
+
+Iblt NetworkManager::buildIblt(const QVariantMap& scope, int cellCount, const QString& peerId) const {
+    // Each scoped origin is covered above its agreed low water mark
+    Iblt table(cellCount);
+    for (auto it = originIndex.begin(); it != originIndex.end(); ++it) {
+        if (!scope.isEmpty() && !scope.contains(it.key())) {
+            continue;
+        }
+
+        int threshold = scope.value(it.key(), 0).toInt();
+        for (auto seqIt = it.value().upperBound(threshold); seqIt != it.value().end(); ++seqIt) {
+            if (syncsWith(seqIt.value(), peerId)) {
+                table.insert(Message::hashMessageId(seqIt.value()));
+            }
+        }
+    }
+    return table;
+}
+
+void NetworkManager::sendIblt(const QString& peerId, const QVariantMap& scope, int cellCount,
+                              const QHostAddress& host, quint16 port) {
+    Iblt table = buildIblt(scope, cellCount, peerId);
+
+    Message sketch("", nodeId, peerId, table.cellCount(), Message::ANTI_ENTROPY_IBLT);
+    sketch.setDigests(scope);
+    sketch.setSketch(table.toByteArray());
+    sendMessageDatagram(sketch, host, port);
+}
+
+void NetworkManager::sendScopedSyncRequest(const QString& peerId, const QVariantMap& scope,
+                                           const QHostAddress& host, quint16 port) {
+    Message request("", nodeId, peerId, 0, Message::ANTI_ENTROPY_REQUEST);
+    request.setVectorClock(vectorClock);
+    request.setDigests(scope);
+    sendMessageDatagram(request, host, port);
+}
+
+bool NetworkManager::syncsWith(const Message& message, const QString& peerId) const {
+    if (message.isBroadcast()) {
+        return true;
+    }
+    return (message.getOrigin() == nodeId && message.getDestination() == peerId) ||
+           (message.getOrigin() == peerId && message.getDestination() == nodeId);
+}
+
+bool NetworkManager::syncsWith(const QString& messageId, const QString& peerId) const {
+    auto it = messageStore.constFind(messageId);
+    return it != messageStore.constEnd() && syncsWith(it.value(), peerId);
+}
+
+void NetworkManager::toggleDigests(const Message& message, quint64 hash) {
+    // Each private message counts only toward the digest we share with its other endpoint
+    const QString& origin = message.getOrigin();
+    if (message.isBroadcast()) {
+        storeDigest ^= hash;
+        originDigests[origin] ^= hash;
+        if (originDigests[origin] == 0) {
+            originDigests.remove(origin);
+        }
+    } else if (origin == nodeId) {
+        sentPrivateDigests[message.getDestination()] ^= hash;
+        if (sentPrivateDigests[message.getDestination()] == 0) {
+            sentPrivateDigests.remove(message.getDestination());
+        }
+    } else if (message.getDestination() == nodeId) {
+        receivedPrivateDigests[origin] ^= hash;
+        if (receivedPrivateDigests[origin] == 0) {
+            receivedPrivateDigests.remove(origin);
+        }
+    }
+}
+
+quint64 NetworkManager::storeDigestFor(const QString& peerId) const {
+    return storeDigest ^ sentPrivateDigests.value(peerId, 0) ^ receivedPrivateDigests.value(peerId, 0);
+}
+
+quint64 NetworkManager::summaryDigest(const QString& peerId, const QVariantMap& peerMarks) const {
+    // Leave out what we still store but the peer has already compacted
+    quint64 digest = storeDigestFor(peerId);
+    for (auto it = peerMarks.begin(); it != peerMarks.end(); ++it) {
+        int mark = it.value().toInt();
+        auto indexIt = originIndex.constFind(it.key());
+        if (mark <= lowWaterMarks.value(it.key(), 0) || indexIt == originIndex.constEnd()) {
+            continue;
+        }
+        for (auto seqIt = indexIt.value().begin(); seqIt != indexIt.value().end() && seqIt.key() <= mark; ++seqIt) {
+            if (syncsWith(seqIt.value(), peerId)) {
+                digest ^= Message::hashMessageId(seqIt.value());
+            }
+        }
+    }
+    return digest;
+}
+
+QString NetworkManager::digestAbove(const QString& origin, int threshold, const QString& peerId) const {
+    quint64 digest = 0;
+    auto it = originIndex.constFind(origin);
+    if (it != originIndex.constEnd()) {
+        for (auto seqIt = it.value().upperBound(threshold); seqIt != it.value().end(); ++seqIt) {
+            if (syncsWith(seqIt.value(), peerId)) {
+                digest ^= Message::hashMessageId(seqIt.value());
+            }
+        }
+    }
+    return QString::number(digest, 16);
+}
+
+QVariantMap NetworkManager::lowWaterMarkMap() const {
+    QVariantMap map;
+    for (auto it = lowWaterMarks.begin(); it != lowWaterMarks.end(); ++it) {
+        map[it.key()] = it.value();
+    }
+    return map;
+}
+
+QVariantMap NetworkManager::originDigestMap(const QString& peerId, const QVariantMap& peerMarks) const {
+    QMap<QString, quint64> digests = originDigests;
+    digests[nodeId] ^= sentPrivateDigests.value(peerId, 0);
+    digests[peerId] ^= receivedPrivateDigests.value(peerId, 0);
+
+    QVariantMap map;
+    for (auto it = digests.begin(); it != digests.end(); ++it) {
+        if (it.value() != 0) {
+            map[it.key()] = QString::number(it.value(), 16);
+        }
+    }
+
+    // Origins the peer compacted further than we did are compared above its mark
+    for (auto it = peerMarks.begin(); it != peerMarks.end(); ++it) {
+        if (it.value().toInt() > lowWaterMarks.value(it.key(), 0) && map.contains(it.key())) {
+            QString digest = digestAbove(it.key(), it.value().toInt(), peerId);
+            if (digest == "0") {
+                map.remove(it.key());
+            } else {
+                map[it.key()] = digest;
+            }
+        }
+    }
+    return map;
+}
+
+void NetworkManager::checkPendingAcks() {
+    qint64 now = networkClockMs();
+    QList<QString> toRetry;
+
+    checkRouteDiscoveries();
+
+    for (auto it = pendingAcks.begin(); it != pendingAcks.end(); ) {
+        PendingMessage& pending = it.value();
+
+        if (now - pending.sentTime > ACK_TIMEOUT) {
+            if (pending.retryCount < MAX_RETRIES) {
+                qDebug() << "Retry sending message" << pending.message.getMessageId()
+                         << "attempt" << (pending.retryCount + 1);
+                toRetry.append(it.key());
+                ++it;
+            } else {
+                qDebug() << "Message" << pending.message.getMessageId() << "failed after" << MAX_RETRIES << "retries";
+                gossipStats.ackFailures++;
+                it = pendingAcks.erase(it);
+            }
+        } else {
+            ++it;
+        }
+    }
+
+    // Retry messages (check if still pending - ACK may have arrived)
+    for (const QString& messageId : toRetry) {
+        if (pendingAcks.contains(messageId)) {
+            PendingMessage& pending = pendingAcks[messageId];
+            pending.retryCount++;
+            pending.sentTime = now;
+            gossipStats.ackRetransmits++;
+            sendDirectMessage(pending.message, pending.targetPeerId);
+        }
+    }
+}
+
+void NetworkManager::checkPeerHealth() {
+    qint64 now = networkClockMs();
+
+    for (auto it = peers.begin(); it != peers.end(); ) {
+        PeerInfo& peer = it.value();
+
+        if (peer.provisional && (now - peer.lastSeen > PEER_TIMEOUT)) {
+            // Restored from the warm-start cache but gone: forget it and its restored routes
+            QString peerId = peer.peerId;
+            qDebug().noquote() << QString("[WARM START] Dropping unconfirmed peer %1").arg(peerId);
+            it = peers.erase(it);
+            for (auto route = routingTable.begin(); route != routingTable.end(); ) {
+                if (route.value().provisional && route.value().nextHop == peerId) {
+                    route = routingTable.erase(route);
+                } else {
+                    ++route;
+                }
+            }
+            invalidateRoutesVia(peerId);
+            emit peerStatusChanged(peerId, false);
+            continue;
+        }
+
+        if (peer.isActive && (now - peer.lastSeen > PEER_TIMEOUT)) {
+            qDebug() << "Peer" << peer.peerId << "timed out";
+            peer.isActive = false;
             emit peerStatusChanged(peer.peerId, false);
+
+            // Stop black-holing traffic through the dead next hop right away
+            invalidateRoutesVia(peer.peerId);
+        }
+        ++it;
+    }
+
+    expireStaleRoutes();
+}
+
+void NetworkManager::updateVectorClock(const QString& origin, int sequenceNumber) {
+    int currentMax = vectorClock.value(origin, 0).toInt();
+    if (sequenceNumber > currentMax) {
+        vectorClock[origin] = sequenceNumber;
+    }
+}
+
+bool NetworkManager::hasMessage(const QString& messageId) const {
+    return messageStore.contains(messageId);
+}
+
+bool NetworkManager::isKnown(const Message& message) const {
+    return hasMessage(message.getMessageId()) ||
+           message.getSequenceNumber() <= lowWaterMarks.value(message.getOrigin(), 0);
+}
+
+void NetworkManager::storeMessage(const Message& message) {
+    // A delivery trace or repair mark describes one trip, not the message; keep them out of the store and log
+    if (message.hasDeliveryTrace() || message.isRepair()) {
+        Message untraced = message;
+        untraced.setDeliveryTrace(QVariantMap());
+        untraced.setRepair(false);
+        storeMessage(untraced);
+        return;
+    }
+
+    if (messageStore.contains(message.getMessageId())) {
+        messageStore[message.getMessageId()] = message;
+        return;
+    }
+
+    // Keep the digests in step with the store (XOR is order-independent)
+    quint64 hash = Message::hashMessageId(message.getMessageId());
+    toggleDigests(message, hash);
+    keyIndex.insert(hash, message.getMessageId());
+    originIndex[message.getOrigin()][message.getSequenceNumber()] = message.getMessageId();
+    messageStore[message.getMessageId()] = message;
+
+    QByteArray datagram = message.toDatagram();
+    StoredInfo info;
+    info.storedAt = networkClockMs();
+    info.bytes = datagram.size();
+    storedInfo.insert(message.getMessageId(), info);
+    originBytes[message.getOrigin()] += info.bytes;
+
+    if (messageLog && !restoringFromLog) {
+        messageLog->append(message.getMessageId(), message.getOrigin(), message.getSequenceNumber(), datagram);
+    }
+
+    enforceRetention(message.getOrigin());
+}
+
+void NetworkManager::removeMessage(const QString& messageId) {
+    auto it = messageStore.find(messageId);
+    if (it == messageStore.end()) {
+        return;
+    }
+
+    const QString origin = it.value().getOrigin();
+    quint64 hash = Message::hashMessageId(messageId);
+    toggleDigests(it.value(), hash);
+    keyIndex.remove(hash);
+
+    auto indexIt = originIndex.find(origin);
+    if (indexIt != originIndex.end()) {
+        indexIt.value().remove(it.value().getSequenceNumber());
+        if (indexIt.value().isEmpty()) {
+            originIndex.erase(indexIt);
+        }
+    }
+
+    StoredInfo info = storedInfo.take(messageId);
+    originBytes[origin] -= info.bytes;
+    if (originBytes[origin] <= 0) {
+        originBytes.remove(origin);
+    }
+
+    // A segment file may only go once the low water marks covering its records are on disk
+    if (messageLog && messageLog->markRemoved(messageId)) {
+        saveLogSnapshot();
+        messageLog->dropReclaimedSegments();
+    }
+
+    messageStore.erase(it);
+    reclaimedMessages++;
+    reclaimedBytes += info.bytes;
+}
+
+void NetworkManager::raiseLowWaterMark(const QString& origin, int seq) {
+    if (seq <= lowWaterMarks.value(origin, 0)) {
+        return;
+    }
+    lowWaterMarks[origin] = seq;
+
+    // Everything at or below the mark is now "seen" rather than stored
+    QStringList reclaim;
+    auto indexIt = originIndex.constFind(origin);
+    if (indexIt != originIndex.constEnd()) {
+        for (auto seqIt = indexIt.value().begin(); seqIt != indexIt.value().end() && seqIt.key() <= seq; ++seqIt) {
+            reclaim.append(seqIt.value());
+        }
+    }
+    for (const QString& messageId : reclaim) {
+        removeMessage(messageId);
+    }
+}
+
+void NetworkManager::enforceRetention(const QString& origin) {
+    // Evict the oldest sequence numbers while the origin is over its count or byte budget
+    while (originIndex.contains(origin)) {
+        const QMap<int, QString>& sequences = originIndex[origin];
+        bool overCount = retentionPolicy.maxMessagesPerOrigin > 0 &&
+                         sequences.size() > retentionPolicy.maxMessagesPerOrigin;
+        bool overBytes = retentionPolicy.maxBytesPerOrigin > 0 &&
+                         originBytes.value(origin, 0) > retentionPolicy.maxBytesPerOrigin;
+        if (!overCount && !overBytes) {
+            break;
+        }
+        raiseLowWaterMark(origin, sequences.firstKey());
+    }
+}
+
+void NetworkManager::recordPeerClock(const QHostAddress& host, quint16 port, const QVariantMap& clock) {
+    peerClocks[Endpoint(host.toString(), port)] = clock;
+}
+
+int NetworkManager::contiguousPrefix(const QString& origin) const {
+    int prefix = lowWaterMarks.value(origin, 0);
+    auto indexIt = originIndex.constFind(origin);
+    if (indexIt != originIndex.constEnd()) {
+        for (auto seqIt = indexIt.value().upperBound(prefix); seqIt != indexIt.value().end() && seqIt.key() == prefix + 1; ++seqIt) {
+            prefix++;
+        }
+    }
+    return prefix;
+}
+
+void NetworkManager::compactStore() {
+    qint64 now = networkClockMs();
+    QList<Endpoint> neighbours = activeEndpoints();
+
+    for (const QString& origin : originIndex.keys()) {
+        // Prefix every active neighbour has already seen. Peer clocks are maxima, not prefixes,
+        // so never go past what we hold without holes: a missing number may be a private
+        // message to us still being retried, or a broadcast awaiting repair.
+        if (!neighbours.isEmpty() && !gapRepairs.contains(origin)) {
+            int stable = contiguousPrefix(origin);
+            for (const Endpoint& endpoint : neighbours) {
+                stable = qMin(stable, peerClocks.value(endpoint).value(origin, 0).toInt());
+            }
+            if (stable > 0) {
+                raiseLowWaterMark(origin, stable);
+            }
         }
+
+        // Age limit, oldest sequence numbers first
+        while (retentionPolicy.maxAgeMs > 0 && originIndex.contains(origin)) {
+            const QMap<int, QString>& sequences = originIndex[origin];
+            if (now - storedInfo.value(sequences.first()).storedAt <= retentionPolicy.maxAgeMs) {
+                break;
+            }
+            raiseLowWaterMark(origin, sequences.firstKey());
+        }
+    }
+
+    // Forget clocks of neighbours that went away so they don't pin the low water marks
+    QSet<Endpoint> active(neighbours.begin(), neighbours.end());
+    for (auto it = peerClocks.begin(); it != peerClocks.end(); ) {
+        if (active.contains(it.key())) {
+            ++it;
+        } else {
+            it = peerClocks.erase(it);
+        }
+    }
+}
+
+StoreStats NetworkManager::getStoreStats() const {
+    StoreStats stats;
+    stats.liveMessages = messageStore.size();
+    for (auto it = originBytes.begin(); it != originBytes.end(); ++it) {
+        stats.liveBytes += it.value();
+    }
+    stats.reclaimedMessages = reclaimedMessages;
+    stats.reclaimedBytes = reclaimedBytes;
+    stats.compactedOrigins = lowWaterMarks.size();
+    return stats;
+}
+
+QList<QString> NetworkManager::getActivePeers() const {
+    QList<QString> activePeers;
+    for (auto it = peers.begin(); it != peers.end(); ++it) {
+        // Return all peers, not just active ones
+        // This prevents manually added peers from disappearing
+        activePeers.append(it.key());
+    }
+    return activePeers;
+}
+
+QString NetworkManager::findPeerIdByAddress(const QHostAddress& host, quint16 port) const {
+    for (auto it = peers.begin(); it != peers.end(); ++it) {
+        const PeerInfo& peer = it.value();
+        if (peer.host == host.toString() && peer.port == port) {
+            return peer.peerId;
+        }
+    }
+    return QString();
+}
+// ==================== PA3: DSDV Routing Functions ====================
+
+void NetworkManager::sendRouteRumor() {
+    if (peers.isEmpty()) {
+        return;
+    }
+
+    // Increment our sequence number (DSDV: origins only ever use even numbers)
+    routeSeqNo += 2;
+
+    // Create route rumor message
+    Message rumor("", nodeId, "broadcast", routeSeqNo, Message::ROUTE_RUMOR);
+    rumor.setVectorClock(vectorClock);
+
+    qDebug().noquote() << QString("[ROUTE RUMOR] Broadcasting: %1 (SeqNo: %2)")
+                           .arg(nodeId).arg(routeSeqNo);
+
+    // Send to all peers
+    for (auto it = peers.begin(); it != peers.end(); ++it) {
+        const PeerInfo& peer = it.value();
+        if (peer.isActive) {
+            QByteArray datagram = rumor.toDatagram();
+            sendDatagram(datagram, QHostAddress(peer.host), peer.port, rumor.getType());
+        }
+    }
+
+    // Piggyback the full table on the same period so neighbours learn every
+    // route in one exchange instead of one random walk per origin
+    sendRouteAdvertisement();
+}
+
+void NetworkManager::sendRouteAdvertisement() {
+    for (auto it = peers.begin(); it != peers.end(); ++it) {
+        const PeerInfo& peer = it.value();
+        if (!peer.isActive) {
+            continue;
+        }
+
+        QVariantList entries = buildRouteEntries(it.key());
+
+        // Split large tables across several datagrams
+        for (int offset = 0; offset < entries.size(); offset += MAX_ROUTES_PER_ADVERTISEMENT) {
+            Message advertisement("", nodeId, it.key(), routeSeqNo, Message::ROUTE_ADVERTISEMENT);
+            advertisement.setRouteEntries(entries.mid(offset, MAX_ROUTES_PER_ADVERTISEMENT));
+            sendMessageDatagram(advertisement, QHostAddress(peer.host), peer.port);
+        }
+    }
+}
+
+void NetworkManager::sendTriggeredUpdate() {
+    triggeredUpdatePending = false;
+    sendRouteAdvertisement();
+}
+
+void NetworkManager::scheduleTriggeredUpdate() {
+    if (triggeredUpdatePending) {
+        return;
+    }
+
+    triggeredUpdatePending = true;
+    QTimer::singleShot(TRIGGERED_UPDATE_DELAY, this, &NetworkManager::sendTriggeredUpdate);
+}
+
+void NetworkManager::invalidateRoute(const QString& destination, RouteInfo& route) {
+    // DSDV broken link: bump to the next odd sequence number with an infinite metric
+    if (route.seqNo % 2 == 0) {
+        route.seqNo++;
+    }
+    route.hopCount = RouteInfo::INFINITE_METRIC;
+    route.lastUpdated = networkClockMs();
+    metrics.routeChanges++;
+
+    qDebug().noquote() << QString("  [ROUTING TABLE] %1 -> unreachable via %2 (SeqNo: %3)")
+                           .arg(destination, -12).arg(route.nextHop).arg(route.seqNo);
+}
+
+void NetworkManager::invalidateRoutesVia(const QString& nextHop) {
+    bool changed = false;
+
+    for (auto it = routingTable.begin(); it != routingTable.end(); ++it) {
+        RouteInfo& route = it.value();
+
+        for (int i = route.alternates.size() - 1; i >= 0; --i) {
+            if (route.alternates[i].peerId == nextHop) {
+                route.alternates.removeAt(i);
+            }
+        }
+
+        if (route.nextHop != nextHop || !route.isReachable()) {
+            continue;
+        }
+
+        if (!route.alternates.isEmpty()) {
+            // Instant failover: promote a surviving equal-cost next hop
+            NextHopInfo promoted = route.alternates.takeFirst();
+            route.nextHop = promoted.peerId;
+            route.nextHopIP = promoted.ip;
+            route.nextHopPort = promoted.port;
+            route.isDirect = (it.key() == promoted.peerId);
+            route.lastUpdated = promoted.lastUpdated;
+
+            qDebug().noquote() << QString("  [ROUTING TABLE] %1 -> failover to %2")
+                                   .arg(it.key(), -12).arg(promoted.peerId);
+        } else {
+            invalidateRoute(it.key(), route);
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        scheduleTriggeredUpdate();
+    }
+}
+
+void NetworkManager::addAlternateNextHop(RouteInfo& route, const QString& nextHop,
+                                         const QString& nextHopIP, quint16 nextHopPort) {
+    for (NextHopInfo& alternate : route.alternates) {
+        if (alternate.peerId == nextHop) {
+            alternate.ip = nextHopIP;
+            alternate.port = nextHopPort;
+            alternate.lastUpdated = networkClockMs();
+            return;
+        }
+    }
+
+    if (route.alternates.size() < MAX_EQUAL_COST_PATHS - 1) {
+        route.alternates.append(NextHopInfo(nextHop, nextHopIP, nextHopPort));
+    }
+}
+
+NextHopInfo NetworkManager::selectNextHop(const QString& destination, const QString& flowOrigin) const {
+    auto routeIt = routingTable.constFind(destination);
+    if (routeIt == routingTable.constEnd() || !routeIt.value().isReachable()) {
+        return NextHopInfo();
+    }
+
+    const RouteInfo& route = routeIt.value();
+    QList<NextHopInfo> candidates;
+    candidates.append(NextHopInfo(route.nextHop, route.nextHopIP, route.nextHopPort));
+
+    // Only spread over alternates whose link is roughly as good as the primary's
+    double primaryCost = getLinkCost(route.nextHop);
+    for (const NextHopInfo& alternate : route.alternates) {
+        if (peers.value(alternate.peerId).isActive &&
+            getLinkCost(alternate.peerId) <= primaryCost + ECMP_COST_SLACK) {
+            candidates.append(alternate);
+        }
+    }
+
+    if (candidates.size() == 1) {
+        return candidates.first();
+    }
+
+    // Per-flow hashing keeps one (origin, destination) pair on one path
+    std::sort(candidates.begin(), candidates.end(), [](const NextHopInfo& a, const NextHopInfo& b) {
+        return a.peerId < b.peerId;
+    });
+    uint flowHash = static_cast<uint>(qHash(flowOrigin + QLatin1Char('|') + destination));
+    return candidates[flowHash % static_cast<uint>(candidates.size())];
+}
+
+void NetworkManager::expireStaleRoutes() {
+    qint64 now = networkClockMs();
+    bool changed = false;
+
+    for (auto it = routingTable.begin(); it != routingTable.end(); ) {
+        RouteInfo& route = it.value();
+
+        // A restored route nobody re-advertised within a period is dropped without a break notice
+        if (route.provisional && now - route.lastUpdated > PROVISIONAL_ROUTE_TTL) {
+            it = routingTable.erase(it);
+            continue;
+        }
+
+        for (int i = route.alternates.size() - 1; i >= 0; --i) {
+            if (now - route.alternates[i].lastUpdated > ROUTE_TIMEOUT) {
+                route.alternates.removeAt(i);
+            }
+        }
+
+        if (now - route.lastUpdated <= ROUTE_TIMEOUT) {
+            ++it;
+        } else if (route.isReachable()) {
+            // Aged out: advertise it as broken for one more period before flushing
+            invalidateRoute(it.key(), route);
+            changed = true;
+            ++it;
+        } else {
+            it = routingTable.erase(it);
+        }
+    }
+
+    if (changed) {
+        scheduleTriggeredUpdate();
+    }
+}
+
+QVariantList NetworkManager::buildRouteEntries(const QString& neighborId) const {
+    QVariantList entries;
+
+    // Our own entry always goes first with a zero metric
+    QVariantMap self;
+    self["Dest"] = nodeId;
+    self["SeqNo"] = routeSeqNo;
+    self["Hops"] = 0;
+    entries.append(self);
+
+    for (auto it = routingTable.begin(); it != routingTable.end(); ++it) {
+        const RouteInfo& route = it.value();
+
+        // Split horizon: never advertise a route back to the neighbour we learned it from.
+        // Restored routes stay local until a live advertisement confirms them.
+        if (it.key() == neighborId || route.nextHop == neighborId || route.provisional) {
+            continue;
+        }
+
+        QVariantMap entry;
+        entry["Dest"] = it.key();
+        entry["SeqNo"] = route.seqNo;
+        entry["Hops"] = route.hopCount;
+        entries.append(entry);
+    }
+
+    return entries;
+}
+
+void NetworkManager::handleRouteAdvertisement(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    // Advertisements are exchanged hop-by-hop, so the origin is the neighbour itself
+    QString senderId = message.getOrigin();
+    QString senderIP = senderHost.toString();
+
+    const QVariantList entries = message.getRouteEntries();
+    for (const QVariant& value : entries) {
+        QVariantMap entry = value.toMap();
+        QString dest = entry.value("Dest").toString();
+        int seqNo = entry.value("SeqNo").toInt();
+        int hops = entry.value("Hops").toInt();
+
+        if (dest == nodeId) {
+            // Someone reports us as broken: outbid the odd sequence number so the
+            // stale invalidation cannot win against our live route
+            if (seqNo > routeSeqNo) {
+                routeSeqNo = seqNo + (seqNo % 2);
+                scheduleTriggeredUpdate();
+            }
+            continue;
+        }
+
+        if (dest.isEmpty()) {
+            continue;
+        }
+
+        int metric = hops >= RouteInfo::INFINITE_METRIC ? RouteInfo::INFINITE_METRIC : hops + 1;
+        updateRoutingTable(dest, seqNo, senderId, senderIP, senderPort, dest == senderId, metric);
+    }
+}
+
+void NetworkManager::handleRouteRumor(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    QString origin = message.getOrigin();
+    int seqNo = message.getSequenceNumber();
+    QString senderIP = message.getLastIP().isEmpty() ? senderHost.toString() : message.getLastIP();
+    quint16 senderPortNum = message.getLastPort() == 0 ? senderPort : message.getLastPort();
+
+    // Find sender's node ID
+    QString senderId = findPeerIdByAddress(senderHost, senderPort);
+    if (senderId.isEmpty()) {
+        senderId = QString("Node%1").arg(senderPort);
+    }
+
+    trace.record(EventTrace::RUMOR_RECEIVED, origin, senderId, static_cast<quint32>(seqNo),
+                 static_cast<quint16>(message.getHopLimit()));
+
+    // Only log if different from our node
+    if (packetLogging && origin != nodeId) {
+        qDebug().noquote() << QString("[ROUTE RUMOR] Received from %1: Route to %2 (SeqNo: %3)")
+                               .arg(senderId).arg(origin).arg(seqNo);
+        // Log NAT traversal info (LastIP/LastPort extraction)
+        qDebug().noquote() << QString("  [NAT INFO] Sender: %1:%2 (from UDP packet)")
+                               .arg(senderHost.toString()).arg(senderPort);
+        if (!message.getLastIP().isEmpty() || message.getLastPort() != 0) {
+            qDebug().noquote() << QString("  [NAT INFO] LastIP/Port in rumor: %1:%2")
+                                   .arg(message.getLastIP().isEmpty() ? "N/A" : message.getLastIP())
+                                   .arg(message.getLastPort());
+        }
+    }
+
+    // Determine if this is a direct connection
+    bool isDirect = (origin == senderId);
+
+    // Rumors spend one unit of hop limit per hop, which doubles as their metric
+    int hopCount = isDirect ? 1 : static_cast<int>(Message::DEFAULT_HOP_LIMIT - message.getHopLimit()) + 1;
+
+    // Update routing table (duplicates still count: they may reveal a shorter path)
+    updateRoutingTable(origin, seqNo, senderId, senderIP, senderPortNum, isDirect, hopCount);
+
+    bool alreadyHave = latestRumors.contains(origin) &&
+                       latestRumors[origin].getSequenceNumber() >= seqNo;
+    if (alreadyHave) {
+        // Tell the sender so it can lose interest in this rumor
+        gossipStats.duplicateRumors++;
+        Message feedback("", nodeId, senderId, seqNo, Message::RUMOR_FEEDBACK);
+        feedback.setMessageId(origin);
+        sendMessageDatagram(feedback, senderHost, senderPort);
+        return;
+    }
+
+    gossipStats.rumorsReceived++;
+    latestRumors[origin] = message;
+    hotRumors.remove(origin);
+
+    // Forward to random neighbors (excluding sender) while hop limit remains
+    if (message.getHopLimit() > 1) {
+        Message forwardRumor = message;
+        forwardRumor.setHopLimit(message.getHopLimit() - 1);
+        forwardRumorToRandomNeighbors(forwardRumor, senderHost, senderPort);
+
+        HotRumor hot;
+        hot.rumor = forwardRumor;
+        hot.senderHost = senderHost;
+        hot.senderPort = senderPort;
+        hot.feedbackCount = 0;
+        hot.rounds = 0;
+        hotRumors[origin] = hot;
+    }
+}
+
+void NetworkManager::handleRumorFeedback(const Message& message) {
+    gossipStats.feedbackReceived++;
+
+    // The message ID carries the rumor's origin
+    auto it = hotRumors.find(message.getMessageId());
+    if (it == hotRumors.end() || it.value().rumor.getSequenceNumber() != message.getSequenceNumber()) {
+        return;
+    }
+
+    // Lose interest with a probability that grows with every "already had it"
+    HotRumor& hot = it.value();
+    hot.feedbackCount++;
+    if (randomGenerator->bounded(rumorStopK) < hot.feedbackCount) {
+        gossipStats.lostInterest++;
+        hotRumors.erase(it);
+    }
+}
+
+void NetworkManager::runRumorRound() {
+    for (auto it = hotRumors.begin(); it != hotRumors.end(); ) {
+        HotRumor& hot = it.value();
+        if (++hot.rounds > MAX_RUMOR_ROUNDS) {
+            gossipStats.lostInterest++;
+            it = hotRumors.erase(it);
+            continue;
+        }
+
+        forwardRumorToRandomNeighbors(hot.rumor, hot.senderHost, hot.senderPort);
+        ++it;
+    }
+
+    if (rumorMode != RUMOR_PUSH_PULL) {
+        return;
+    }
+
+    // Pull: send our digest of newest rumor sequence numbers to one random neighbour
+    QStringList target = pickRandomActivePeers(1, QHostAddress(), 0);
+    if (target.isEmpty()) {
+        return;
+    }
+
+    QVariantMap digest;
+    digest[nodeId] = routeSeqNo;
+    for (auto it = latestRumors.begin(); it != latestRumors.end(); ++it) {
+        digest[it.key()] = it.value().getSequenceNumber();
+    }
+
+    Message pull("", nodeId, target.first(), 1, Message::RUMOR_PULL);
+    pull.setVectorClock(digest);
+
+    const PeerInfo& peer = peers[target.first()];
+    sendMessageDatagram(pull, QHostAddress(peer.host), peer.port);
+    gossipStats.pullRequests++;
+}
+
+void NetworkManager::handleRumorPull(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    QVariantMap digest = message.getVectorClock();
+
+    // Our own route is not in latestRumors; a puller that missed it gets it fresh
+    if (routeSeqNo > digest.value(nodeId, 0).toInt()) {
+        Message own("", nodeId, "broadcast", routeSeqNo, Message::ROUTE_RUMOR);
+        own.setVectorClock(vectorClock);
+        sendMessageDatagram(own, senderHost, senderPort);
+        gossipStats.rumorsSent++;
+    }
+
+    for (auto it = latestRumors.begin(); it != latestRumors.end(); ++it) {
+        const Message& rumor = it.value();
+        if (rumor.getHopLimit() <= 1 || rumor.getSequenceNumber() <= digest.value(it.key(), 0).toInt()) {
+            continue;
+        }
+
+        Message reply = rumor;
+        reply.setHopLimit(rumor.getHopLimit() - 1);
+        sendMessageDatagram(reply, senderHost, senderPort);
+        gossipStats.rumorsSent++;
+    }
+}
+
+void NetworkManager::updateRoutingTable(const QString& origin, int seqNo, const QString& nextHop,
+                                        const QString& nextHopIP, quint16 nextHopPort, bool isDirect, int hopCount) {
+    if (origin == nodeId) {
+        return;  // Don't add route to ourselves
+    }
+
+    bool shouldUpdate = false;
+    bool pathChanged = true;
+    bool wasReachable = false;
+    bool reachable = hopCount < RouteInfo::INFINITE_METRIC;
+
+    if (!routingTable.contains(origin)) {
+        // New route (a broken route to an unknown destination carries no information)
+        shouldUpdate = reachable;
+    } else {
+        RouteInfo& existingRoute = routingTable[origin];
+
+        // DSDV update logic: prefer higher sequence number, then lower metric,
+        // then a direct route at the same metric
+        if (seqNo > existingRoute.seqNo) {
+            shouldUpdate = true;
+        } else if (existingRoute.provisional && reachable && seqNo == existingRoute.seqNo) {
+            // Live news beats a restored guess
+            shouldUpdate = true;
+        } else if (seqNo == existingRoute.seqNo && reachable) {
+            // Composite cost: remaining hops plus the measured quality of the first link
+            double newCost = routeCost(hopCount, nextHop);
+            double currentCost = routeCost(existingRoute.hopCount, existingRoute.nextHop);
+            if (newCost < currentCost - ROUTE_COST_HYSTERESIS) {
+                shouldUpdate = true;
+            } else if (hopCount == existingRoute.hopCount && isDirect && !existingRoute.isDirect) {
+                shouldUpdate = true;
+            }
+        }
+
+        pathChanged = existingRoute.nextHop != nextHop || existingRoute.hopCount != hopCount;
+        wasReachable = existingRoute.isReachable();
+
+        // Same sequence number over the same next hop keeps the route alive
+        if (!shouldUpdate && seqNo == existingRoute.seqNo && existingRoute.nextHop == nextHop) {
+            existingRoute.lastUpdated = networkClockMs();
+        }
+
+        // Same sequence number and metric over another next hop is an equal-cost path
+        if (!shouldUpdate && reachable && seqNo == existingRoute.seqNo &&
+            hopCount == existingRoute.hopCount && existingRoute.nextHop != nextHop) {
+            addAlternateNextHop(existingRoute, nextHop, nextHopIP, nextHopPort);
+            return;
+        }
+    }
+
+    if (shouldUpdate) {
+        RouteInfo updatedRoute(nextHop, nextHopIP, nextHopPort, seqNo, isDirect, hopCount);
+
+        // A fresher sequence number at the same metric keeps the equal-cost set,
+        // including the previous primary, instead of collapsing it to one path
+        if (routingTable.contains(origin) && reachable) {
+            const RouteInfo& previous = routingTable[origin];
+            if (previous.isReachable() && previous.hopCount == hopCount) {
+                for (const NextHopInfo& alternate : previous.alternates) {
+                    if (alternate.peerId != nextHop) {
+                        updatedRoute.alternates.append(alternate);
+                    }
+                }
+                if (previous.nextHop != nextHop && updatedRoute.alternates.size() < MAX_EQUAL_COST_PATHS - 1) {
+                    NextHopInfo demoted(previous.nextHop, previous.nextHopIP, previous.nextHopPort);
+                    demoted.lastUpdated = previous.lastUpdated;
+                    updatedRoute.alternates.append(demoted);
+                }
+            }
+        }
+
+        routingTable[origin] = updatedRoute;
+        if (pathChanged || reachable != wasReachable) {
+            metrics.routeChanges++;
+        }
+
+        if (!reachable) {
+            if (wasReachable) {
+                // Propagate the break so nodes behind us reroute quickly
+                trace.record(EventTrace::ROUTE_UNREACHABLE, origin, nextHop, static_cast<quint32>(seqNo));
+                if (packetLogging) {
+                    qDebug().noquote() << QString("  [ROUTING TABLE] %1 -> unreachable (SeqNo: %2)")
+                                           .arg(origin, -12).arg(seqNo);
+                }
+                scheduleTriggeredUpdate();
+            }
+            return;
+        }
+
+        // A newer sequence number over the same path is a refresh, not worth a log line
+        if (pathChanged) {
+            trace.record(EventTrace::ROUTE_CHANGED, origin, nextHop, static_cast<quint32>(seqNo),
+                         static_cast<quint16>(hopCount));
+            if (packetLogging) {
+                QString routeType = isDirect ? "Direct" : "Via " + nextHop;
+                qDebug().noquote() << QString("  [ROUTING TABLE] %1 -> %2 (SeqNo: %3, Hops: %4)")
+                                       .arg(origin, -12).arg(routeType, -20).arg(seqNo).arg(hopCount);
+            }
+        }
+
+        // Add the next hop as a peer if not already known
+        if (!peers.contains(nextHop)) {
+            addPeer(nextHop, nextHopIP, nextHopPort);
+        }
+
+        // Release anything that was waiting for this route
+        if (pendingRouteMessages.contains(origin)) {
+            flushPendingRouteMessages(origin);
+        }
+    }
+}
+
+bool NetworkManager::forwardMessage(Message& message) {
+    // Check hop limit
+    if (message.getHopLimit() == 0) {
+        trace.record(EventTrace::DROP_HOP_LIMIT, message.getDestination(), QString(),
+                     static_cast<quint32>(message.getSequenceNumber()));
+        if (packetLogging) {
+            qDebug().noquote() << "[FORWARD] ✗ Message hop limit reached, dropping";
+        }
+        metrics.dropsHopLimit++;
+        return false;
+    }
+
+    // Decrement hop limit
+    message.setHopLimit(message.getHopLimit() - 1);
+
+    QString dest = message.getDestination();
+
+    // Look up route in routing table, spreading flows over equal-cost next hops
+    NextHopInfo hop = selectNextHop(dest, message.getOrigin());
+    if (hop.peerId.isEmpty()) {
+        trace.record(EventTrace::DROP_NO_ROUTE, dest, QString(), static_cast<quint32>(message.getSequenceNumber()));
+        if (packetLogging) {
+            qDebug().noquote() << QString("[FORWARD] ✗ No route to %1, starting discovery").arg(dest);
+        }
+        queueForRouteDiscovery(message, dest, false, true);
+        return false;
+    }
+
+    // Traced messages record how long they spent here
+    appendTraceHop(message, datagramArrivalUs);
+
+    // Send to next hop
+    QByteArray datagram = message.toDatagram();
+    sendDatagram(datagram, QHostAddress(hop.ip), hop.port, message.getType());
+
+    trace.record(EventTrace::FORWARD, dest, hop.peerId, static_cast<quint32>(message.getSequenceNumber()),
+                 static_cast<quint16>(message.getHopLimit()));
+    if (packetLogging) {
+        qDebug().noquote() << QString("[FORWARD] ✓ %1 -> %2 via %3 (HopLimit: %4)")
+                               .arg(message.getOrigin()).arg(dest)
+                               .arg(hop.peerId).arg(message.getHopLimit());
+    }
+
+    return true;
+}
+
+QStringList NetworkManager::pickRandomActivePeers(int count, const QHostAddress& excludeHost, quint16 excludePort) const {
+    // Get list of active peers excluding the sender
+    QStringList candidates;
+    QString excludeHostStr = excludeHost.toString();
+    for (auto it = peers.begin(); it != peers.end(); ++it) {
+        const PeerInfo& peer = it.value();
+        if (peer.isActive && !(peer.host == excludeHostStr && peer.port == excludePort)) {
+            candidates.append(it.key());
+        }
+    }
+
+    // Partial Fisher-Yates shuffle: the first `count` entries become a uniform sample
+    int picks = qMin(count, static_cast<int>(candidates.size()));
+    for (int i = 0; i < picks; ++i) {
+        int j = i + randomGenerator->bounded(candidates.size() - i);
+        candidates.swapItemsAt(i, j);
+    }
+
+    return candidates.mid(0, picks);
+}
+
+void NetworkManager::forwardRumorToRandomNeighbors(const Message& message, const QHostAddress& excludeHost, quint16 excludePort) {
+    QStringList targets = pickRandomActivePeers(rumorFanout, excludeHost, excludePort);
+
+    // Forward rumor - don't set LastIP/LastPort here
+    // The receiver will extract the actual IP/port from the UDP packet
+    // This enables proper NAT traversal
+    QByteArray datagram = message.toDatagram();
+    for (const QString& peerId : targets) {
+        const PeerInfo& peer = peers[peerId];
+        sendDatagram(datagram, QHostAddress(peer.host), peer.port, message.getType());
+        gossipStats.rumorsSent++;
+        trace.record(EventTrace::RUMOR_FORWARDED, message.getOrigin(), peerId,
+                     static_cast<quint32>(message.getSequenceNumber()), static_cast<quint16>(message.getHopLimit()));
+    }
+
+    // Only log forwarding for non-self rumors
+    if (packetLogging && !targets.isEmpty() && message.getOrigin() != nodeId) {
+        qDebug().noquote() << QString("  [GOSSIP] Forwarding to %1").arg(targets.join(", "));
+    }
+}
+
+// ==================== Link Quality Probing ====================
+
+void NetworkManager::sendLinkProbes() {
+    qint64 now = networkClockMs();
+
+    for (auto it = peers.begin(); it != peers.end(); ++it) {
+        PeerInfo& peer = it.value();
+        if (!peer.isActive) {
+            continue;
+        }
+
+        // A probe still unanswered after a full interval counts as lost
+        if (peer.pendingProbeSeq != 0) {
+            recordProbeOutcome(peer, true, 0.0);
+        }
+
+        peer.pendingProbeSeq = nextProbeSeq++;
+        peer.pendingProbeSentAt = now;
+
+        Message probe("", nodeId, it.key(), peer.pendingProbeSeq, Message::LINK_PROBE);
+        sendMessageDatagram(probe, QHostAddress(peer.host), peer.port);
     }
+
+    rebalanceRoutes();
 }
 
-void NetworkManager::updateVectorClock(const QString& origin, int sequenceNumber) {
-    int currentMax = vectorClock.value(origin, 0).toInt();
-    if (sequenceNumber > currentMax) {
-        vectorClock[origin] = sequenceNumber;
+void NetworkManager::handleLinkProbe(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    // Echo straight back to the sender's address so the RTT covers exactly one link
+    Message reply("", nodeId, message.getOrigin(), message.getSequenceNumber(), Message::LINK_PROBE_REPLY);
+    sendMessageDatagram(reply, senderHost, senderPort);
+}
+
+void NetworkManager::handleLinkProbeReply(const Message& message) {
+    auto it = peers.find(message.getOrigin());
+    if (it == peers.end()) {
+        return;
     }
+
+    PeerInfo& peer = it.value();
+    if (peer.pendingProbeSeq == 0 || peer.pendingProbeSeq != message.getSequenceNumber()) {
+        return;  // Late reply to a probe already counted as lost
+    }
+
+    double rttMs = static_cast<double>(networkClockMs() - peer.pendingProbeSentAt);
+    recordProbeOutcome(peer, false, rttMs);
 }
 
-bool NetworkManager::hasMessage(const QString& messageId) const {
-    return messageStore.contains(messageId);
+void NetworkManager::recordProbeOutcome(PeerInfo& peer, bool lost, double rttMs) {
+    peer.pendingProbeSeq = 0;
+    if (!lost) {
+        metrics.linkRttSeconds.observe(rttMs / 1000.0);
+    }
+
+    if (peer.probeSamples == 0) {
+        peer.lossEwma = lost ? 1.0 : 0.0;
+        peer.rttEwma = rttMs;
+    } else {
+        peer.lossEwma = LINK_EWMA_ALPHA * (lost ? 1.0 : 0.0) + (1.0 - LINK_EWMA_ALPHA) * peer.lossEwma;
+        if (!lost) {
+            peer.rttEwma = LINK_EWMA_ALPHA * rttMs + (1.0 - LINK_EWMA_ALPHA) * peer.rttEwma;
+        }
+    }
+    peer.probeSamples++;
 }
 
-void NetworkManager::storeMessage(const Message& message) {
-    messageStore[message.getMessageId()] = message;
+double NetworkManager::getLinkCost(const QString& peerId) const {
+    auto it = peers.constFind(peerId);
+    if (it == peers.constEnd() || it.value().probeSamples == 0) {
+        return 1.0;  // Unmeasured links cost one plain hop
+    }
+
+    const PeerInfo& peer = it.value();
+    return 1.0 + peer.rttEwma / RTT_COST_UNIT_MS + LOSS_COST_WEIGHT * peer.lossEwma;
+}
+
+double NetworkManager::routeCost(int hopCount, const QString& nextHop) const {
+    return (hopCount - 1) + getLinkCost(nextHop);
 }
 
-QList<Message> NetworkManager::getMissingMessages(const QVariantMap& remoteVectorClock) const {
-    QList<Message> missing;
+void NetworkManager::rebalanceRoutes() {
+    // Link quality drifts between advertisements, so re-pick the primary among
+    // equal-metric next hops using the latest measurements
+    for (auto it = routingTable.begin(); it != routingTable.end(); ++it) {
+        RouteInfo& route = it.value();
+        if (!route.isReachable() || route.alternates.isEmpty()) {
+            continue;
+        }
 
-    // Find messages that the remote peer doesn't have
-    for (auto it = messageStore.begin(); it != messageStore.end(); ++it) {
-        const Message& msg = it.value();
-        QString origin = msg.getOrigin();
-        int localSeq = msg.getSequenceNumber();
-        int remoteSeq = remoteVectorClock.value(origin, 0).toInt();
+        int bestIndex = -1;
+        double bestCost = getLinkCost(route.nextHop) - ROUTE_COST_HYSTERESIS;
+        for (int i = 0; i < route.alternates.size(); ++i) {
+            double cost = getLinkCost(route.alternates[i].peerId);
+            if (peers.value(route.alternates[i].peerId).isActive && cost < bestCost) {
+                bestCost = cost;
+                bestIndex = i;
+            }
+        }
 
-        if (localSeq > remoteSeq) {
-            missing.append(msg);
+        if (bestIndex < 0) {
+            continue;
         }
+
+        NextHopInfo promoted = route.alternates.takeAt(bestIndex);
+        NextHopInfo demoted(route.nextHop, route.nextHopIP, route.nextHopPort);
+        demoted.lastUpdated = route.lastUpdated;
+        route.alternates.append(demoted);
+
+        route.nextHop = promoted.peerId;
+        route.nextHopIP = promoted.ip;
+        route.nextHopPort = promoted.port;
+        route.isDirect = (it.key() == promoted.peerId);
+        route.lastUpdated = promoted.lastUpdated;
+
+        qDebug().noquote() << QString("  [ROUTING TABLE] %1 -> %2 (better link, cost %3)")
+                               .arg(it.key(), -12).arg(promoted.peerId).arg(bestCost, 0, 'f', 2);
+    }
+}
+
+// ==================== On-Demand Route Discovery ====================
+
+void NetworkManager::queueForRouteDiscovery(const Message& message, const QString& destination,
+                                            bool requireAck, bool forwarded) {
+    QList<PendingRouteMessage>& queue = pendingRouteMessages[destination];
+    if (queue.size() >= MAX_PENDING_PER_DESTINATION || pendingRouteMessageCount >= MAX_PENDING_ROUTE_MESSAGES) {
+        qDebug().noquote() << QString("[DISCOVERY] ✗ Pending queue full, dropping message for %1").arg(destination);
+        metrics.dropsNoRoute++;
+        return;
     }
 
-    return missing;
+    PendingRouteMessage pending;
+    pending.message = message;
+    pending.requireAck = requireAck;
+    pending.forwarded = forwarded;
+    pending.arrivalUs = forwarded ? datagramArrivalUs : 0;  // Parked from the receive path
+    queue.append(pending);
+    pendingRouteMessageCount++;
+    metrics.parkedNoRoute++;
+
+    if (!activeDiscoveries.contains(destination)) {
+        RouteDiscovery discovery;
+        discovery.startedAt = networkClockMs();
+        discovery.attempts = 1;
+        activeDiscoveries[destination] = discovery;
+        sendRouteRequest(destination);
+    }
 }
 
-QList<QString> NetworkManager::getActivePeers() const {
-    QList<QString> activePeers;
+void NetworkManager::sendRouteRequest(const QString& destination) {
+    int requestId = nextRouteRequestId++;
+    seenRouteRequests[QString("%1_%2").arg(nodeId).arg(requestId)] = networkClockMs();
+
+    // Entry 0 describes the requester (reverse route), entry 1 the last hop
+    QVariantMap requester;
+    requester["Dest"] = nodeId;
+    requester["SeqNo"] = routeSeqNo;
+    requester["Hops"] = 0;
+
+    Message request("", nodeId, destination, requestId, Message::ROUTE_REQUEST);
+    request.setHopLimit(ROUTE_REQUEST_TTL);
+    request.setRouteEntries(QVariantList() << requester << requester);
+
+    qDebug().noquote() << QString("[DISCOVERY] Route request #%1 for %2").arg(requestId).arg(destination);
+
+    QByteArray datagram = request.toDatagram();
     for (auto it = peers.begin(); it != peers.end(); ++it) {
-        // Return all peers, not just active ones
-        // This prevents manually added peers from disappearing
-        activePeers.append(it.key());
+        if (it.value().isActive) {
+            sendDatagram(datagram, QHostAddress(it.value().host), it.value().port, request.getType());
+        }
     }
-    return activePeers;
 }
 
-QString NetworkManager::findPeerIdByAddress(const QHostAddress& host, quint16 port) const {
+QString NetworkManager::learnRouteFromControl(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    const QVariantList entries = message.getRouteEntries();
+    if (entries.size() < 2) {
+        return QString();
+    }
+
+    QVariantMap target = entries[0].toMap();
+    QVariantMap lastHop = entries[1].toMap();
+    QString lastHopId = lastHop.value("Dest").toString();
+    QString targetId = target.value("Dest").toString();
+    if (lastHopId.isEmpty() || targetId.isEmpty()) {
+        return QString();
+    }
+
+    QString senderIP = senderHost.toString();
+    if (lastHopId != targetId) {
+        updateRoutingTable(lastHopId, lastHop.value("SeqNo").toInt(), lastHopId, senderIP, senderPort, true, 1);
+    }
+    updateRoutingTable(targetId, target.value("SeqNo").toInt(), lastHopId, senderIP, senderPort,
+                       targetId == lastHopId, target.value("Hops").toInt() + 1);
+
+    return lastHopId;
+}
+
+QVariantList NetworkManager::relayRouteEntries(const Message& message) const {
+    QVariantList entries = message.getRouteEntries();
+
+    QVariantMap target = entries[0].toMap();
+    target["Hops"] = target.value("Hops").toInt() + 1;
+    entries[0] = target;
+
+    QVariantMap self;
+    self["Dest"] = nodeId;
+    self["SeqNo"] = routeSeqNo;
+    self["Hops"] = 0;
+    entries[1] = self;
+
+    return entries;
+}
+
+void NetworkManager::handleRouteRequest(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    QString requestKey = QString("%1_%2").arg(message.getOrigin()).arg(message.getSequenceNumber());
+    if (seenRouteRequests.contains(requestKey)) {
+        return;  // Duplicate suppression: each request is handled once per node
+    }
+    seenRouteRequests[requestKey] = networkClockMs();
+
+    // Install the reverse path towards the requester
+    QString lastHopId = learnRouteFromControl(message, senderHost, senderPort);
+    if (lastHopId.isEmpty()) {
+        return;
+    }
+
+    QString target = message.getDestination();
+    QVariantMap answer;
+
+    if (target == nodeId) {
+        // Fresh sequence number so the reply beats any stale broken route
+        routeSeqNo += 2;
+        answer["Dest"] = nodeId;
+        answer["SeqNo"] = routeSeqNo;
+        answer["Hops"] = 0;
+    } else if (routingTable.contains(target) && routingTable[target].isReachable() &&
+               routingTable[target].nextHop != lastHopId) {
+        // Intermediate reply from our own valid route
+        const RouteInfo& route = routingTable[target];
+        answer["Dest"] = target;
+        answer["SeqNo"] = route.seqNo;
+        answer["Hops"] = route.hopCount;
+    }
+
+    if (!answer.isEmpty()) {
+        QVariantMap self;
+        self["Dest"] = nodeId;
+        self["SeqNo"] = routeSeqNo;
+        self["Hops"] = 0;
+
+        Message reply("", nodeId, message.getOrigin(), message.getSequenceNumber(), Message::ROUTE_REPLY);
+        reply.setRouteEntries(QVariantList() << answer << self);
+        sendMessageDatagram(reply, senderHost, senderPort);
+
+        qDebug().noquote() << QString("[DISCOVERY] Replying to %1 for %2").arg(message.getOrigin()).arg(target);
+        return;
+    }
+
+    // Keep flooding while the request has hops left
+    if (message.getHopLimit() <= 1) {
+        return;
+    }
+
+    Message relay = message;
+    relay.setHopLimit(message.getHopLimit() - 1);
+    relay.setRouteEntries(relayRouteEntries(message));
+
+    QByteArray datagram = relay.toDatagram();
     for (auto it = peers.begin(); it != peers.end(); ++it) {
         const PeerInfo& peer = it.value();
-        if (peer.host == host.toString() && peer.port == port) {
-            return peer.peerId;
+        if (peer.isActive && !(peer.host == senderHost.toString() && peer.port == senderPort)) {
+            sendDatagram(datagram, QHostAddress(peer.host), peer.port, relay.getType());
         }
     }
-    return QString();
 }
-// ==================== PA3: DSDV Routing Functions ====================
 
-void NetworkManager::sendRouteRumor() {
-    if (peers.isEmpty()) {
+void NetworkManager::handleRouteReply(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    // Every hop on the reverse path learns the forward route to the target
+    if (learnRouteFromControl(message, senderHost, senderPort).isEmpty()) {
         return;
     }
 
-    // Increment our sequence number
-    routeSeqNo++;
+    if (message.getDestination() == nodeId) {
+        // updateRoutingTable() releases buffered messages when the route changed;
+        // an intermediate reply may confirm a route we already had
+        QString target = message.getRouteEntries().first().toMap().value("Dest").toString();
+        if (pendingRouteMessages.contains(target) && !selectNextHop(target, nodeId).peerId.isEmpty()) {
+            flushPendingRouteMessages(target);
+        }
+        return;
+    }
 
-    // Create route rumor message
-    Message rumor("", nodeId, "broadcast", routeSeqNo, Message::ROUTE_RUMOR);
-    rumor.setVectorClock(vectorClock);
+    if (message.getHopLimit() == 0) {
+        return;
+    }
 
-    qDebug().noquote() << QString("[ROUTE RUMOR] Broadcasting: %1 (SeqNo: %2)")
-                           .arg(nodeId).arg(routeSeqNo);
+    Message relay = message;
+    relay.setHopLimit(message.getHopLimit() - 1);
+    relay.setRouteEntries(relayRouteEntries(message));
 
-    // Send to all peers
+    NextHopInfo hop = selectNextHop(message.getDestination(), nodeId);
+    if (!hop.peerId.isEmpty()) {
+        sendMessageDatagram(relay, QHostAddress(hop.ip), hop.port);
+    }
+}
+
+void NetworkManager::flushPendingRouteMessages(const QString& destination) {
+    QList<PendingRouteMessage> queue = pendingRouteMessages.take(destination);
+    activeDiscoveries.remove(destination);
+    pendingRouteMessageCount -= queue.size();
+
+    if (!queue.isEmpty()) {
+        qDebug().noquote() << QString("[DISCOVERY] ✓ Route to %1 found, sending %2 buffered message(s)")
+                               .arg(destination).arg(queue.size());
+    }
+
+    for (const PendingRouteMessage& pending : queue) {
+        if (pending.forwarded) {
+            NextHopInfo hop = selectNextHop(destination, pending.message.getOrigin());
+            if (!hop.peerId.isEmpty()) {
+                // The wait for discovery is this relay's queueing time
+                Message relayed = pending.message;
+                appendTraceHop(relayed, pending.arrivalUs);
+                sendMessageDatagram(relayed, QHostAddress(hop.ip), hop.port);
+            }
+        } else {
+            sendDirectMessage(pending.message, destination, pending.requireAck);
+        }
+    }
+}
+
+void NetworkManager::checkRouteDiscoveries() {
+    qint64 now = networkClockMs();
+
+    for (auto it = seenRouteRequests.begin(); it != seenRouteRequests.end(); ) {
+        if (now - it.value() > ROUTE_REQUEST_MEMORY) {
+            it = seenRouteRequests.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    QList<QString> failed;
+    for (auto it = activeDiscoveries.begin(); it != activeDiscoveries.end(); ++it) {
+        RouteDiscovery& discovery = it.value();
+        if (now - discovery.startedAt <= ROUTE_DISCOVERY_TIMEOUT) {
+            continue;
+        }
+
+        if (discovery.attempts < MAX_ROUTE_DISCOVERY_ATTEMPTS) {
+            discovery.attempts++;
+            discovery.startedAt = now;
+            sendRouteRequest(it.key());
+        } else {
+            failed.append(it.key());
+        }
+    }
+
+    for (const QString& destination : failed) {
+        int dropped = pendingRouteMessages.value(destination).size();
+        pendingRouteMessages.remove(destination);
+        activeDiscoveries.remove(destination);
+        pendingRouteMessageCount -= dropped;
+        metrics.dropsNoRoute += static_cast<quint64>(dropped);
+
+        qDebug().noquote() << QString("[DISCOVERY] ✗ No route to %1 after %2 attempts, dropped %3 message(s)")
+                               .arg(destination).arg(MAX_ROUTE_DISCOVERY_ATTEMPTS).arg(dropped);
+    }
+}
+
+// ==================== Broadcast Tree (Plumtree) ====================
+
+QList<NetworkManager::Endpoint> NetworkManager::activeEndpoints() const {
+    QList<Endpoint> endpoints;
+    QSet<Endpoint> seen;
     for (auto it = peers.begin(); it != peers.end(); ++it) {
         const PeerInfo& peer = it.value();
-        if (peer.isActive) {
-            QByteArray datagram = rumor.toDatagram();
-            sendDatagram(datagram, QHostAddress(peer.host), peer.port);
+        Endpoint endpoint(peer.host, static_cast<quint16>(peer.port));
+        if (peer.isActive && !seen.contains(endpoint)) {
+            seen.insert(endpoint);
+            endpoints.append(endpoint);
         }
     }
+    return endpoints;
 }
 
-void NetworkManager::handleRouteRumor(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
-    QString origin = message.getOrigin();
-    int seqNo = message.getSequenceNumber();
-    QString senderIP = message.getLastIP().isEmpty() ? senderHost.toString() : message.getLastIP();
-    quint16 senderPortNum = message.getLastPort() == 0 ? senderPort : message.getLastPort();
+void NetworkManager::pushBroadcast(const Message& message, const Endpoint& exclude) {
+    QByteArray datagram = message.toDatagram();
 
-    // Find sender's node ID
-    QString senderId = findPeerIdByAddress(senderHost, senderPort);
-    if (senderId.isEmpty()) {
-        senderId = QString("Node%1").arg(senderPort);
+    for (const Endpoint& endpoint : activeEndpoints()) {
+        if (endpoint == exclude) {
+            continue;
+        }
+
+        if (lazyPushPeers.contains(endpoint)) {
+            lazyQueue[endpoint].append(message.getMessageId());
+        } else {
+            sendDatagram(datagram, QHostAddress(endpoint.first), endpoint.second, message.getType());
+        }
     }
+}
 
-    // Only log if different from our node
-    if (origin != nodeId) {
-        qDebug().noquote() << QString("[ROUTE RUMOR] Received from %1: Route to %2 (SeqNo: %3)")
-                               .arg(senderId).arg(origin).arg(seqNo);
-        // Log NAT traversal info (LastIP/LastPort extraction)
-        qDebug().noquote() << QString("  [NAT INFO] Sender: %1:%2 (from UDP packet)")
-                               .arg(senderHost.toString()).arg(senderPort);
-        if (!message.getLastIP().isEmpty() || message.getLastPort() != 0) {
-            qDebug().noquote() << QString("  [NAT INFO] LastIP/Port in rumor: %1:%2")
-                                   .arg(message.getLastIP().isEmpty() ? "N/A" : message.getLastIP())
-                                   .arg(message.getLastPort());
+void NetworkManager::handleBroadcastMessage(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    Endpoint sender(senderHost.toString(), senderPort);
+
+    if (isKnown(message)) {
+        // Redundant copy: this link is not needed in the tree (repairs say nothing about the tree)
+        gossipStats.broadcastDuplicates++;
+        missingBroadcasts.remove(message.getMessageId());
+        if (!message.isRepair() && !lazyPushPeers.contains(sender)) {
+            lazyPushPeers.insert(sender);
+            gossipStats.prunes++;
+
+            Message prune("", nodeId, "broadcast", 1, Message::GOSSIP_PRUNE);
+            sendMessageDatagram(prune, senderHost, senderPort);
         }
+        return;
     }
 
-    // Determine if this is a direct connection
-    bool isDirect = (origin == senderId);
+    storeMessage(message);
+    updateVectorClock(message.getOrigin(), message.getSequenceNumber());
+    missingBroadcasts.remove(message.getMessageId());
 
-    // Update routing table
-    updateRoutingTable(origin, seqNo, senderId, senderIP, senderPortNum, isDirect);
+    // The first eager copy marks the tree link
+    if (!message.isRepair()) {
+        lazyPushPeers.remove(sender);
+    }
 
-    // Forward to a random neighbor (excluding sender)
-    forwardRumorToRandomNeighbor(message, senderHost, senderPort);
-}
+    detectGaps(message, senderHost, senderPort);
 
-void NetworkManager::updateRoutingTable(const QString& origin, int seqNo, const QString& nextHop,
-                                        const QString& nextHopIP, quint16 nextHopPort, bool isDirect) {
-    if (origin == nodeId) {
-        return;  // Don't add route to ourselves
+    // Rendezvous nodes neither display nor relay chat
+    if (noForwardMode && !message.getChatText().isEmpty()) {
+        return;
     }
 
-    bool shouldUpdate = false;
+    qDebug().noquote() << QString("[MESSAGE] ✓ Received from %1: \"%2\"")
+                           .arg(message.getOrigin()).arg(message.getChatText());
+    emit messageReceived(message);
 
-    if (!routingTable.contains(origin)) {
-        // New route
-        shouldUpdate = true;
-    } else {
-        RouteInfo& existingRoute = routingTable[origin];
+    // Repairs fill our own hole; the tree already carried the message past us
+    if (!message.isRepair()) {
+        pushBroadcast(message, sender);
+    }
+}
 
-        // DSDV update logic: prefer higher sequence number, or same sequence with direct route
-        if (seqNo > existingRoute.seqNo) {
-            shouldUpdate = true;
-        } else if (seqNo == existingRoute.seqNo && isDirect && !existingRoute.isDirect) {
-            shouldUpdate = true;
+void NetworkManager::handleIHave(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    Endpoint sender(senderHost.toString(), senderPort);
+    qint64 now = networkClockMs();
+
+    for (const QString& messageId : message.getMessageIds()) {
+        if (hasMessage(messageId)) {
+            continue;
+        }
+
+        if (!missingBroadcasts.contains(messageId)) {
+            MissingBroadcast missing;
+            missing.announcedAt = now;
+            missingBroadcasts[messageId] = missing;
+        }
+
+        MissingBroadcast& missing = missingBroadcasts[messageId];
+        if (!missing.announcers.contains(sender)) {
+            missing.announcers.append(sender);
         }
     }
+}
 
-    if (shouldUpdate) {
-        routingTable[origin] = RouteInfo(nextHop, nextHopIP, nextHopPort, seqNo, isDirect);
-        QString routeType = isDirect ? "Direct" : "Via " + nextHop;
-        qDebug().noquote() << QString("  [ROUTING TABLE] %1 -> %2 (SeqNo: %3)")
-                               .arg(origin, -12).arg(routeType, -20).arg(seqNo);
+void NetworkManager::handleGraft(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    // The requester is back in our eager set and gets the payloads right away
+    lazyPushPeers.remove(Endpoint(senderHost.toString(), senderPort));
 
-        // Add the next hop as a peer if not already known
-        if (!peers.contains(nextHop)) {
-            addPeer(nextHop, nextHopIP, nextHopPort);
+    for (const QString& messageId : message.getMessageIds()) {
+        auto it = messageStore.constFind(messageId);
+        if (it != messageStore.constEnd()) {
+            Message repair = it.value();
+            repair.setRepair(true);
+            sendMessageDatagram(repair, senderHost, senderPort);
         }
     }
 }
 
-bool NetworkManager::forwardMessage(Message& message) {
-    // Check hop limit
-    if (message.getHopLimit() == 0) {
-        qDebug().noquote() << "[FORWARD] ✗ Message hop limit reached, dropping";
-        return false;
+void NetworkManager::handlePrune(const QHostAddress& senderHost, quint16 senderPort) {
+    lazyPushPeers.insert(Endpoint(senderHost.toString(), senderPort));
+}
+
+void NetworkManager::runBroadcastTreeTick() {
+    // Flush batched lazy announcements
+    for (auto it = lazyQueue.begin(); it != lazyQueue.end(); ++it) {
+        const QStringList& ids = it.value();
+        for (int offset = 0; offset < ids.size(); offset += MAX_IDS_PER_IHAVE) {
+            Message ihave("", nodeId, "broadcast", 1, Message::GOSSIP_IHAVE);
+            ihave.setMessageIds(ids.mid(offset, MAX_IDS_PER_IHAVE));
+            sendMessageDatagram(ihave, QHostAddress(it.key().first), it.key().second);
+        }
+        gossipStats.ihavesSent += ids.size();
     }
+    lazyQueue.clear();
 
-    // Decrement hop limit
-    message.setHopLimit(message.getHopLimit() - 1);
+    // Graft links whose announcements were not followed by the eager copy in time
+    qint64 now = networkClockMs();
+    for (auto it = missingBroadcasts.begin(); it != missingBroadcasts.end(); ) {
+        MissingBroadcast& missing = it.value();
+        if (now - missing.announcedAt < GRAFT_TIMEOUT) {
+            ++it;
+            continue;
+        }
 
-    QString dest = message.getDestination();
+        if (missing.announcers.isEmpty()) {
+            it = missingBroadcasts.erase(it);
+            continue;
+        }
 
-    // Look up route in routing table
-    if (!routingTable.contains(dest)) {
-        qDebug().noquote() << QString("[FORWARD] ✗ No route to %1").arg(dest);
-        return false;
+        Endpoint announcer = missing.announcers.takeFirst();
+        lazyPushPeers.remove(announcer);
+        missing.announcedAt = now;
+        gossipStats.grafts++;
+
+        Message graft("", nodeId, "broadcast", 1, Message::GOSSIP_GRAFT);
+        graft.setMessageIds(QStringList() << it.key());
+        sendMessageDatagram(graft, QHostAddress(announcer.first), announcer.second);
+        ++it;
     }
+}
 
-    const RouteInfo& route = routingTable[dest];
+// ==================== Gap Repair (NACK) ====================
 
-    // Send to next hop
-    QByteArray datagram = message.toDatagram();
-    sendDatagram(datagram, QHostAddress(route.nextHopIP), route.nextHopPort);
+void NetworkManager::detectGaps(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    const QString& origin = message.getOrigin();
+    int seq = message.getSequenceNumber();
 
-    qDebug().noquote() << QString("[FORWARD] ✓ %1 -> %2 via %3 (HopLimit: %4)")
-                           .arg(message.getOrigin()).arg(dest)
-                           .arg(route.nextHop).arg(message.getHopLimit());
+    auto repairIt = gapRepairs.find(origin);
+    if (repairIt != gapRepairs.end()) {
+        repairIt.value().missing.remove(seq);
+        if (repairIt.value().missing.isEmpty()) {
+            gapRepairs.erase(repairIt);
+        }
+    }
 
-    return true;
-}
+    // First contact with an origin: earlier history is anti-entropy's job
+    auto lowIt = deliveredLow.constFind(origin);
+    if (lowIt == deliveredLow.constEnd()) {
+        deliveredLow[origin] = seq;
+        return;
+    }
 
-void NetworkManager::forwardRumorToRandomNeighbor(const Message& message, const QHostAddress& excludeHost, quint16 excludePort) {
-    if (peers.isEmpty()) {
+    // Private messages share the origin's counter, so a skipped sequence number proves
+    // nothing; only the link to the origin's previous broadcast does
+    int previous = message.getPreviousBroadcast();
+    if (previous < lowIt.value() || previous <= lowWaterMarks.value(origin, 0)) {
+        return;
+    }
+    auto indexIt = originIndex.constFind(origin);
+    if (indexIt != originIndex.constEnd() && indexIt.value().contains(previous)) {
         return;
     }
 
-    // Get list of active peers excluding the sender
-    QList<QString> candidates;
-    for (auto it = peers.begin(); it != peers.end(); ++it) {
-        const PeerInfo& peer = it.value();
-        if (peer.isActive && !(peer.host == excludeHost.toString() && peer.port == excludePort)) {
-            candidates.append(it.key());
+    GapRepair& repair = gapRepairs[origin];
+    if (repair.missing.isEmpty()) {
+        repair.attempts = 0;
+        repair.lastNackAt = 0;
+    }
+    repair.missing.insert(previous);
+    repair.previousHop = Endpoint(senderHost.toString(), senderPort);
+
+    qDebug().noquote() << QString("[GAP] %1 broadcast %2 missing (before seq %3)")
+                           .arg(origin).arg(previous).arg(seq);
+
+    if (networkClockMs() - repair.lastNackAt >= NACK_INTERVAL) {
+        sendGapNack(origin);
+    }
+
+    if (!gapRepairTimer->isActive()) {
+        gapRepairTimer->start(NACK_INTERVAL);
+    }
+}
+
+void NetworkManager::sendGapNack(const QString& origin) {
+    GapRepair& repair = gapRepairs[origin];
+
+    // Each missing broadcast is asked for together with the unknown sequence numbers
+    // just below it: any further broadcasts lost there come back in the same round,
+    // and whatever else the origin used them for is simply not answered
+    QList<int> sequences = repair.missing.values();
+    std::sort(sequences.begin(), sequences.end());
+    const QMap<int, QString> stored = originIndex.value(origin);
+    int floor = qMax(lowWaterMarks.value(origin, 0), deliveredLow.value(origin, 1) - 1);
+    QVariantList ranges;
+    for (int seq : sequences) {
+        int from = qMax(floor + 1, seq - MAX_NACK_GAP + 1);
+        auto below = stored.lowerBound(seq);
+        if (below != stored.begin()) {
+            --below;
+            from = qMax(from, below.key() + 1);
         }
+
+        QVariantMap range;
+        range["Origin"] = origin;
+        range["From"] = from;
+        range["To"] = seq;
+        ranges.append(range);
+        floor = seq;
     }
 
-    if (candidates.isEmpty()) {
-        return;
+    Message nack("", nodeId, origin, 0, Message::GAP_NACK);
+    nack.setRanges(ranges);
+    QByteArray datagram = nack.toDatagram();
+
+    // First ask the hop that just delivered the later message, then the origin itself
+    if (repair.attempts == 0) {
+        sendDatagram(datagram, QHostAddress(repair.previousHop.first), repair.previousHop.second, nack.getType());
+    } else {
+        auto peerIt = peers.constFind(origin);
+        NextHopInfo hop = selectNextHop(origin, nodeId);
+        if (peerIt != peers.constEnd() && peerIt.value().isActive) {
+            sendDatagram(datagram, QHostAddress(peerIt.value().host), peerIt.value().port, nack.getType());
+        } else if (!hop.peerId.isEmpty()) {
+            sendDatagram(datagram, QHostAddress(hop.ip), hop.port, nack.getType());
+        } else {
+            sendDatagram(datagram, QHostAddress(repair.previousHop.first), repair.previousHop.second, nack.getType());
+        }
     }
 
-    // Pick random neighbor
-    int randomIndex = QRandomGenerator::global()->bounded(candidates.size());
-    QString randomPeerId = candidates[randomIndex];
-    const PeerInfo& randomPeer = peers[randomPeerId];
+    repair.attempts++;
+    repair.lastNackAt = networkClockMs();
+    gossipStats.nacksSent++;
+}
 
-    // Forward rumor - don't set LastIP/LastPort here
-    // The receiver will extract the actual IP/port from the UDP packet
-    // This enables proper NAT traversal
-    QByteArray datagram = message.toDatagram();
-    sendDatagram(datagram, QHostAddress(randomPeer.host), randomPeer.port);
+void NetworkManager::checkGapRepairs() {
+    qint64 now = networkClockMs();
 
-    // Only log forwarding for non-self rumors
-    if (message.getOrigin() != nodeId) {
-        qDebug().noquote() << QString("  [GOSSIP] Forwarding to %1").arg(randomPeerId);
+    for (auto it = gapRepairs.begin(); it != gapRepairs.end(); ) {
+        GapRepair& repair = it.value();
+        if (now - repair.lastNackAt < NACK_INTERVAL) {
+            ++it;
+            continue;
+        }
+
+        if (repair.attempts >= MAX_NACK_ATTEMPTS) {
+            it = gapRepairs.erase(it);
+            continue;
+        }
+
+        sendGapNack(it.key());
+        ++it;
+    }
+
+    if (gapRepairs.isEmpty()) {
+        gapRepairTimer->stop();
+    }
+}
+
+void NetworkManager::handleGapNack(const Message& message, const QHostAddress& senderHost, quint16 senderPort) {
+    const QString& requester = message.getOrigin();
+    int budget = MAX_NACK_GAP;
+
+    for (const QVariant& entry : message.getRanges()) {
+        QVariantMap range = entry.toMap();
+        auto originIt = originIndex.constFind(range.value("Origin").toString());
+        if (originIt == originIndex.constEnd()) {
+            continue;
+        }
+
+        int to = range.value("To").toInt();
+        for (auto seqIt = originIt.value().lowerBound(range.value("From").toInt());
+             seqIt != originIt.value().constEnd() && seqIt.key() <= to && budget > 0; ++seqIt) {
+            auto msgIt = messageStore.constFind(seqIt.value());
+            if (msgIt == messageStore.constEnd()) {
+                continue;
+            }
+
+            // Never hand out private messages addressed to someone else
+            const Message& msg = msgIt.value();
+            if (!msg.isBroadcast() && msg.getDestination() != requester) {
+                continue;
+            }
+
+            Message repair = msg;
+            repair.setRepair(true);
+            sendMessageDatagram(repair, senderHost, senderPort);
+            gossipStats.nackRetransmits++;
+            budget--;
+        }
     }
 }
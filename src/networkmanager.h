@@ -4,11 +4,24 @@
 #include <QUdpSocket>
 #include <QTimer>
 #include <QMap>
+#include <QHash>
 #include <QSet>
 #include <QQueue>
 #include <QPair>
 #include <QDateTime>
 #include "message.h"
+#include "iblt.h"
+#include "messagelog.h"
+#include "packetcapture.h"
+#include "metrics.h"
+#include "eventtrace.h"
+#include <QRandomGenerator>
+
+// Wall-clock milliseconds as the networking code sees them. Capture replay
+// pins this to each datagram's capture time, so that route aging, transit
+// expiry and hold-downs decide the same way on every run; 0 = real time.
+qint64 networkClockMs();
+void setReplayClockMs(qint64 epochMs);
 
 struct PeerInfo {
     QString peerId;
@@ -17,39 +30,216 @@ struct PeerInfo {
     bool isActive;
     qint64 lastSeen;
 
-    PeerInfo() : port(0), isActive(false), lastSeen(0) {}
+    // Link quality, measured by periodic probes
+    double rttEwma;  // Smoothed round-trip time in milliseconds
+    double lossEwma;  // Smoothed probe loss ratio (0.0 - 1.0)
+    int probeSamples;  // Number of probe outcomes folded into the averages
+    int pendingProbeSeq;  // Sequence number of the unanswered probe (0 if none)
+    qint64 pendingProbeSentAt;
+
+    // Anti-entropy scheduling
+    qint64 lastSyncAt;  // When we last started a sync round with this peer (0 = never)
+    int divergence;  // Recent differences found with this peer; halves each time we sync
+    QVariantMap lowWaterMarks;  // As last reported by the peer; digests only cover what both still store
+
+    bool provisional;  // Restored from the warm-start cache and not heard from since
+
+    PeerInfo() : port(0), isActive(false), lastSeen(0), rttEwma(0.0), lossEwma(0.0),
+                 probeSamples(0), pendingProbeSeq(0), pendingProbeSentAt(0),
+                 lastSyncAt(0), divergence(0), provisional(false) {}
     PeerInfo(const QString& id, const QString& h, int p)
-        : peerId(id), host(h), port(p), isActive(true), lastSeen(QDateTime::currentMSecsSinceEpoch()) {}
+        : peerId(id), host(h), port(p), isActive(true), lastSeen(networkClockMs()),
+          rttEwma(0.0), lossEwma(0.0), probeSamples(0), pendingProbeSeq(0), pendingProbeSentAt(0),
+          lastSyncAt(0), divergence(0), provisional(false) {}
+};
+
+// Equal-cost alternative to a route's primary next hop
+struct NextHopInfo {
+    QString peerId;
+    QString ip;
+    quint16 port;
+    qint64 lastUpdated;
+
+    NextHopInfo() : port(0), lastUpdated(0) {}
+    NextHopInfo(const QString& id, const QString& h, quint16 p)
+        : peerId(id), ip(h), port(p), lastUpdated(networkClockMs()) {}
 };
 
 // DSDV Routing Table Entry
 struct RouteInfo {
+    static const int INFINITE_METRIC = 16;  // Hop count advertised for broken routes
+
     QString nextHop;  // Next hop node ID
     QString nextHopIP;  // Next hop IP address
     quint16 nextHopPort;  // Next hop port
     int seqNo;  // Sequence number from origin
     bool isDirect;  // Is this a direct route?
+    int hopCount;  // Metric: number of hops to the destination
     qint64 lastUpdated;  // Last time this route was updated
+    QList<NextHopInfo> alternates;  // Other next hops with the same seqNo and metric
+    bool provisional;  // Restored from the warm-start cache; used, but not advertised until confirmed
 
-    RouteInfo() : nextHopPort(0), seqNo(0), isDirect(false), lastUpdated(0) {}
-    RouteInfo(const QString& hop, const QString& ip, quint16 port, int seq, bool direct)
-        : nextHop(hop), nextHopIP(ip), nextHopPort(port), seqNo(seq), isDirect(direct),
-          lastUpdated(QDateTime::currentMSecsSinceEpoch()) {}
+    RouteInfo() : nextHopPort(0), seqNo(0), isDirect(false), hopCount(0), lastUpdated(0), provisional(false) {}
+    RouteInfo(const QString& hop, const QString& ip, quint16 port, int seq, bool direct, int hops = 1)
+        : nextHop(hop), nextHopIP(ip), nextHopPort(port), seqNo(seq), isDirect(direct), hopCount(hops),
+          lastUpdated(networkClockMs()), provisional(false) {}
+
+    bool isReachable() const { return hopCount < INFINITE_METRIC; }
+};
+
+// Limits on what the message store keeps per origin (0 = unlimited)
+struct RetentionPolicy {
+    int maxMessagesPerOrigin;
+    qint64 maxAgeMs;
+    qint64 maxBytesPerOrigin;
+
+    RetentionPolicy() : maxMessagesPerOrigin(10000), maxAgeMs(7LL * 24 * 3600 * 1000),
+                        maxBytesPerOrigin(4 * 1024 * 1024) {}
+};
+
+// Message store occupancy
+struct StoreStats {
+    int liveMessages;
+    qint64 liveBytes;
+    quint64 reclaimedMessages;  // Compacted (every peer had them) or evicted by policy
+    quint64 reclaimedBytes;
+    int compactedOrigins;  // Origins with a non-zero low water mark
+
+    StoreStats() : liveMessages(0), liveBytes(0), reclaimedMessages(0), reclaimedBytes(0),
+                   compactedOrigins(0) {}
+};
+
+// Rumor dissemination counters, identical across push and push-pull modes
+struct GossipStats {
+    quint64 rumorsSent;  // Rumor datagrams pushed or pulled to neighbours
+    quint64 rumorsReceived;  // Rumors that were new to us
+    quint64 duplicateRumors;  // Rumors we already had (redundant traffic)
+    quint64 feedbackReceived;  // "Already had it" replies from neighbours
+    quint64 lostInterest;  // Hot rumors we stopped spreading
+    quint64 pullRequests;  // Pull digests sent
+
+    // Broadcast tree (eager/lazy push)
+    quint64 broadcastDuplicates;  // Broadcast payloads received more than once
+    quint64 ihavesSent;  // Message IDs announced lazily
+    quint64 grafts;  // Links promoted back into the tree
+    quint64 prunes;  // Links demoted to lazy push
+
+    // Anti-entropy replay
+    quint64 digestMismatches;  // Summary digests that differed and were answered with per-origin detail
+    quint64 catchUpMessagesSent;  // Stored messages streamed to lagging peers
+    quint64 catchUpBytesSent;
+
+    // Relay (transit) traffic
+    quint64 transitForwarded;  // Private messages relayed for others
+    quint64 transitDuplicates;  // Relayed copies dropped by the transit cache
+
+    // Gap repair
+    quint64 nacksSent;
+    quint64 nackRetransmits;  // Messages resent in answer to NACKs
+
+    // End-to-end ACKs for private messages
+    quint64 ackRetransmits;  // Resent after an ACK timeout
+    quint64 ackFailures;  // Given up on after MAX_RETRIES
+
+    GossipStats() : rumorsSent(0), rumorsReceived(0), duplicateRumors(0),
+                    feedbackReceived(0), lostInterest(0), pullRequests(0),
+                    broadcastDuplicates(0), ihavesSent(0), grafts(0), prunes(0),
+                    digestMismatches(0), catchUpMessagesSent(0), catchUpBytesSent(0),
+                    transitForwarded(0), transitDuplicates(0),
+                    nacksSent(0), nackRetransmits(0),
+                    ackRetransmits(0), ackFailures(0) {}
+};
+
+// Datagram totals at the UDP socket, all message types included
+struct TrafficStats {
+    quint64 datagramsSent;
+    quint64 bytesSent;
+    quint64 datagramsReceived;
+    quint64 bytesReceived;
+
+    TrafficStats() : datagramsSent(0), bytesSent(0), datagramsReceived(0), bytesReceived(0) {}
+};
+
+// Path of one traced private message, as seen by its destination. Times are
+// wall-clock microseconds from each node's own clock, so cross-host numbers
+// are only as good as the hosts' clock sync.
+struct DeliveryTrace {
+    struct Hop {
+        QString nodeId;
+        qint64 arrivalUs;
+        qint64 departureUs;
+
+        Hop() : arrivalUs(0), departureUs(0) {}
+    };
+
+    QString messageId;
+    QString origin;
+    qint64 sentUs;  // When the origin sent it
+    qint64 deliveredUs;  // When it arrived here
+    QList<Hop> hops;  // Relays, in path order
+
+    DeliveryTrace() : sentUs(0), deliveredUs(0) {}
 };
 
 class NetworkManager : public QObject {
     Q_OBJECT
+    friend class BenchNetworkManager;  // Microbenchmarks drive the private hot paths directly
 
 public:
+    enum RumorMode {
+        RUMOR_PUSH,  // Hot rumors are pushed to random neighbours every round
+        RUMOR_PUSH_PULL  // Additionally pull missing rumors from one neighbour per round
+    };
+
     explicit NetworkManager(QObject* parent = nullptr);
     ~NetworkManager();
 
     bool startServer(int port);
-    void sendMessage(const Message& message);
+    QString sendMessage(const Message& message);  // Returns the message ID (assigned here for chat messages)
     void addPeer(const QString& peerId, const QString& host, int port);
     void discoverLocalPeers(const QList<int>& portRange);
 
     void setNodeId(const QString& nodeId) { this->nodeId = nodeId; }
+
+    // Persist stored messages, peers and routes under dataDir and restore them;
+    // call after setNodeId(), before startServer()
+    bool enablePersistence(const QString& dataDir, MessageLog::SyncPolicy policy = MessageLog::SYNC_BATCHED);
+    bool isPersistent() const { return messageLog != nullptr; }
+
+    // Record every received datagram to a pcap file (see PacketCapture)
+    bool enableCapture(const QString& path);
+    void disableCapture();
+    bool isCapturing() const { return packetCapture != nullptr; }
+    QString getCaptureFile() const { return packetCapture ? packetCapture->fileName() : QString(); }
+
+    // Run a datagram through the receive path as if it had arrived on the socket (capture replay)
+    void injectDatagram(const QByteArray& datagram, const QHostAddress& senderHost, quint16 senderPort);
+
+    // With transmit off, outgoing datagrams are built and counted but not sent (offline replay)
+    void setTransmitEnabled(bool enabled) { transmitEnabled = enabled; }
+
+    // Fanout, peer picks and sampling draw from a generator seeded with this
+    // instead of the system one (offline replay)
+    void setRandomSeed(quint32 seed);
+
+    // Per-packet [SEND]/[FORWARD]/[ROUTE RUMOR]/[ROUTING TABLE] log lines; off by default,
+    // the binary trace covers the same events without formatting strings
+    void setPacketLogging(bool enabled) { packetLogging = enabled; }
+
+    // Record per-packet events in a ring of EventTrace::DEFAULT_CAPACITY events;
+    // with a path, the ring is saved there when the node shuts down
+    void enableTrace(const QString& path = QString(), int capacity = EventTrace::DEFAULT_CAPACITY);
+    bool saveTrace(const QString& path) const { return trace.save(path); }
+    const EventTrace& getTrace() const { return trace; }
+    QString getTraceFile() const { return traceFile; }
+
+    // Fraction (0-1) of our private chat messages that carry a delivery trace
+    // header; relays append their arrival and departure times to it
+    void setDeliveryTraceRate(double rate) { deliveryTraceRate = qBound(0.0, rate, 1.0); }
+    double getDeliveryTraceRate() const { return deliveryTraceRate; }
+
+    // The last MAX_DELIVERY_TRACES traced messages delivered here, oldest first
+    QList<DeliveryTrace> getDeliveryTraces() const { return deliveryTraces; }
     QString getNodeId() const { return nodeId; }
 
     QList<QString> getActivePeers() const;
@@ -60,6 +250,34 @@ public:
     bool isNoForwardMode() const { return noForwardMode; }
     QMap<QString, RouteInfo> getRoutingTable() const { return routingTable; }
 
+    // Link quality: per-neighbour RTT/loss averages and the cost used for route choice
+    QMap<QString, PeerInfo> getPeers() const { return peers; }
+    double getLinkCost(const QString& peerId) const;
+
+    // Rumor mongering: fanout per push, feedback-driven stop, optional pull rounds
+    void setRumorFanout(int fanout) { rumorFanout = fanout < 1 ? 1 : fanout; }
+    int getRumorFanout() const { return rumorFanout; }
+    void setRumorMode(RumorMode mode) { rumorMode = mode; }
+    RumorMode getRumorMode() const { return rumorMode; }
+    void setRumorStopK(int k) { rumorStopK = k < 1 ? 1 : k; }
+    GossipStats getGossipStats() const { return gossipStats; }
+    TrafficStats getTrafficStats() const { return trafficStats; }
+    const NodeMetrics& getMetrics() const { return metrics; }
+
+    // Current anti-entropy period; shrinks while rounds find differences, backs off when idle
+    int getAntiEntropyInterval() const { return antiEntropyInterval; }
+
+    // Pacing for messages replayed to lagging peers (bytes per second, per peer)
+    void setCatchUpByteRate(int bytesPerSecond) { catchUpByteRate = bytesPerSecond < 1 ? 1 : bytesPerSecond; }
+    int getCatchUpByteRate() const { return catchUpByteRate; }
+
+    // Message store retention; compaction runs periodically and on every store
+    void setRetentionPolicy(const RetentionPolicy& policy) { retentionPolicy = policy; }
+    RetentionPolicy getRetentionPolicy() const { return retentionPolicy; }
+    StoreStats getStoreStats() const;
+    int getLowWaterMark(const QString& origin) const { return lowWaterMarks.value(origin, 0); }
+    int getTransitCacheSize() const { return transitCache.size(); }
+
 signals:
     void messageReceived(const Message& message);
     void peerDiscovered(const QString& peerId, const QString& host, int port);
@@ -71,35 +289,115 @@ private slots:
     void checkPendingAcks();
     void checkPeerHealth();
     void sendRouteRumor();  // PA3: Send route rumors periodically
+    void sendRouteAdvertisement();  // Send our routing table to every neighbour
+    void sendTriggeredUpdate();  // Advertise route changes without waiting for the next period
+    void sendLinkProbes();  // Measure RTT and loss to every neighbour
+    void runRumorRound();  // Re-push hot rumors and optionally pull
+    void runBroadcastTreeTick();  // Flush lazy announcements and graft missing broadcasts
+    void runCatchUpTick();  // Send the next paced chunk of every catch-up stream
+    void checkGapRepairs();  // Re-send NACKs for gaps that are still open
+    void compactStore();  // Apply age limits and drop prefixes every peer already has
+    void syncMessageLog();  // Batched fsync and periodic snapshot
 
 private:
     void processReceivedMessage(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
-    void handleChatMessage(const Message& message);
+    void handleChatMessage(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    void handleBroadcastMessage(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    void handleIHave(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    void handleGraft(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    void handlePrune(const QHostAddress& senderHost, quint16 senderPort);
+    void handleGapNack(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
     void handleAntiEntropyRequest(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
-    void handleAntiEntropyResponse(const Message& message);
+    void handleAntiEntropyResponse(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    void handleAntiEntropyDigest(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    void handleAntiEntropyIblt(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    void handleAntiEntropyFetch(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
     void handleAck(const Message& message);
     void handleRouteRumor(const Message& message, const QHostAddress& senderHost, quint16 senderPort);  // PA3
+    void handleRouteAdvertisement(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    void handleLinkProbe(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    void handleLinkProbeReply(const Message& message);
+    void handleRouteRequest(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    void handleRouteReply(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    void handleRumorFeedback(const Message& message);
+    void handleRumorPull(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
 
     void sendDirectMessage(const Message& message, const QString& peerId, bool requireAck = true);
     void sendBroadcastMessage(const Message& message);
+    typedef QPair<QString, quint16> Endpoint;  // host, port
+    QList<Endpoint> activeEndpoints() const;
+    void pushBroadcast(const Message& message, const Endpoint& exclude);
     void sendWithRetry(const Message& message, const QString& peerId);
-    void sendDatagram(const QByteArray& datagram, const QHostAddress& host, quint16 port);
+    void sendDatagram(const QByteArray& datagram, const QHostAddress& host, quint16 port, Message::MessageType type);
+    void sendMessageDatagram(const Message& message, const QHostAddress& host, quint16 port);
 
     void updateVectorClock(const QString& origin, int sequenceNumber);
     void performAntiEntropy();
     void syncMissingMessages(const QString& peerId);
 
     bool hasMessage(const QString& messageId) const;
+    bool isKnown(const Message& message) const;  // Stored, or at/below the origin's low water mark
     void storeMessage(const Message& message);
-    QList<Message> getMissingMessages(const QVariantMap& remoteVectorClock) const;
+    void removeMessage(const QString& messageId);
+    void enforceRetention(const QString& origin);
+    void raiseLowWaterMark(const QString& origin, int seq);
+    int contiguousPrefix(const QString& origin) const;  // Highest seq with nothing missing at or below it
+    void saveLogSnapshot();
+    void saveTopologySnapshot() const;
+    void restoreTopologySnapshot();
+    bool rememberTransit(const Message& message);
+    void recordDeliveryTrace(const Message& message);  // At the destination of a traced message
+    void appendTraceHop(Message& message, qint64 arrivalUs) const;  // At a relay, just before sending
+    void recordPeerClock(const QHostAddress& host, quint16 port, const QVariantMap& clock);
+    QVariantMap lowWaterMarkMap() const;
+    bool syncsWith(const Message& message, const QString& peerId) const;  // Broadcasts, and our conversation with the peer
+    bool syncsWith(const QString& messageId, const QString& peerId) const;
+    void toggleDigests(const Message& message, quint64 hash);
+    quint64 storeDigestFor(const QString& peerId) const;
+    quint64 summaryDigest(const QString& peerId, const QVariantMap& peerMarks) const;
+    QString digestAbove(const QString& origin, int threshold, const QString& peerId) const;
+    QVariantMap originDigestMap(const QString& peerId, const QVariantMap& peerMarks) const;
+    void noteDivergence(const QString& peerId, int amount);
+    int queueCatchUp(const QString& peerId, const QHostAddress& host, quint16 port,
+                     const QVariantMap& remoteVectorClock, const QVariantMap& scope);
+    void detectGaps(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    void sendGapNack(const QString& origin);
+    void queueCatchUpIds(const QString& peerId, const QHostAddress& host, quint16 port,
+                         const QStringList& messageIds);
+    void resetAntiEntropyInterval();
+    QString pickAntiEntropyPeer() const;
+    Iblt buildIblt(const QVariantMap& scope, int cellCount, const QString& peerId) const;
+    void sendIblt(const QString& peerId, const QVariantMap& scope, int cellCount,
+                  const QHostAddress& host, quint16 port);
+    void sendScopedSyncRequest(const QString& peerId, const QVariantMap& scope,
+                               const QHostAddress& host, quint16 port);
 
     QString findPeerIdByAddress(const QHostAddress& host, quint16 port) const;
 
     // PA3: Routing functions
     void updateRoutingTable(const QString& origin, int seqNo, const QString& nextHop,
-                           const QString& nextHopIP, quint16 nextHopPort, bool isDirect);
+                           const QString& nextHopIP, quint16 nextHopPort, bool isDirect, int hopCount);
+    QVariantList buildRouteEntries(const QString& neighborId) const;
+    void invalidateRoute(const QString& destination, RouteInfo& route);
+    void invalidateRoutesVia(const QString& nextHop);
+    void addAlternateNextHop(RouteInfo& route, const QString& nextHop, const QString& nextHopIP, quint16 nextHopPort);
+    NextHopInfo selectNextHop(const QString& destination, const QString& flowOrigin) const;
+    double routeCost(int hopCount, const QString& nextHop) const;
+    void recordProbeOutcome(PeerInfo& peer, bool lost, double rttMs);
+    void rebalanceRoutes();
+
+    // On-demand route discovery (AODV-style) for destinations without a route
+    void queueForRouteDiscovery(const Message& message, const QString& destination, bool requireAck, bool forwarded);
+    void sendRouteRequest(const QString& destination);
+    void flushPendingRouteMessages(const QString& destination);
+    void checkRouteDiscoveries();
+    QString learnRouteFromControl(const Message& message, const QHostAddress& senderHost, quint16 senderPort);
+    QVariantList relayRouteEntries(const Message& message) const;
+    void expireStaleRoutes();
+    void scheduleTriggeredUpdate();
     bool forwardMessage(Message& message);
-    void forwardRumorToRandomNeighbor(const Message& message, const QHostAddress& excludeHost, quint16 excludePort);
+    void forwardRumorToRandomNeighbors(const Message& message, const QHostAddress& excludeHost, quint16 excludePort);
+    QStringList pickRandomActivePeers(int count, const QHostAddress& excludeHost, quint16 excludePort) const;
 
     QUdpSocket* socket;
     QString nodeId;
@@ -111,10 +409,114 @@ private:
     QTimer* ackCheckTimer;
     QTimer* peerHealthTimer;
     QTimer* routeRumorTimer;  // PA3: Timer for route rumors
+    QTimer* linkProbeTimer;
+    int nextProbeSeq;
+
+    // Rumor mongering state
+    struct HotRumor {
+        Message rumor;  // Copy ready to forward (hop limit already decremented)
+        QHostAddress senderHost;  // Never push back to where it came from
+        quint16 senderPort;
+        int feedbackCount;
+        int rounds;
+    };
+    QTimer* rumorRoundTimer;
+    QMap<QString, Message> latestRumors;  // origin -> newest rumor seen
+    QMap<QString, HotRumor> hotRumors;  // origin -> rumor we are still spreading
+    GossipStats gossipStats;
+    TrafficStats trafficStats;
+    NodeMetrics metrics;
+    RumorMode rumorMode;
+    int rumorFanout;
+    int rumorStopK;
+
+    // Broadcast tree (Plumtree-style): links are eager unless pruned to lazy.
+    // Keyed by endpoint since one neighbour may be known under several IDs.
+    struct MissingBroadcast {
+        qint64 announcedAt;
+        QList<Endpoint> announcers;
+    };
+    QTimer* broadcastTreeTimer;
+    QSet<Endpoint> lazyPushPeers;
+    QMap<Endpoint, QStringList> lazyQueue;  // endpoint -> message IDs to announce
+    QMap<QString, MissingBroadcast> missingBroadcasts;  // messageId -> announcers
 
     // Message management
     QMap<QString, Message> messageStore;  // messageId -> Message
     QVariantMap vectorClock;  // origin -> max sequence number seen
+    quint64 storeDigest;  // XOR of hashMessageId() over the stored broadcasts
+    QMap<QString, quint64> originDigests;  // origin -> XOR of its broadcast message ID hashes
+    QHash<QString, quint64> sentPrivateDigests;  // destination -> XOR over our private messages to it
+    QHash<QString, quint64> receivedPrivateDigests;  // origin -> XOR over its private messages to us
+    int antiEntropyInterval;
+    bool antiEntropyActivity;  // A difference was found since the last round
+    QHash<quint64, QString> keyIndex;  // hashMessageId() -> messageId, to resolve reconciled keys
+    QMap<QString, QMap<int, QString>> originIndex;  // origin -> sequence number -> messageId
+
+    // Paced replay to lagging peers, resumable per (peer, origin)
+    struct CatchUpStream {
+        QString peerId;
+        QMap<QString, int> cursors;  // origin -> last sequence number sent
+        QStringList explicitIds;  // Specific messages requested (reconciliation, fetches)
+        double tokens;  // Byte budget; may dip below zero after a large message
+        qint64 lastRefill;
+    };
+    QTimer* catchUpTimer;
+    QMap<Endpoint, CatchUpStream> catchUpStreams;
+    int catchUpByteRate;
+
+    // Receive-path gap repair for messages delivered to us
+    struct GapRepair {
+        QSet<int> missing;  // Sequence numbers still outstanding
+        Endpoint previousHop;  // Where the message that exposed the gap came from
+        int attempts;
+        qint64 lastNackAt;
+    };
+    QTimer* gapRepairTimer;
+    QMap<QString, int> deliveredLow;  // origin -> first broadcast sequence number delivered to us
+    QMap<QString, GapRepair> gapRepairs;  // origin -> open gap
+
+    // Retention and compaction
+    struct StoredInfo {
+        qint64 storedAt;
+        int bytes;
+    };
+    QTimer* compactionTimer;
+    RetentionPolicy retentionPolicy;
+    QHash<QString, StoredInfo> storedInfo;  // messageId -> bookkeeping
+    QMap<QString, qint64> originBytes;  // origin -> live bytes
+    QMap<QString, int> lowWaterMarks;  // origin -> everything at or below is treated as seen
+    QMap<Endpoint, QVariantMap> peerClocks;  // neighbour -> last vector clock it reported (or implied)
+    quint64 reclaimedMessages;
+    quint64 reclaimedBytes;
+
+    // Persistence (optional)
+    QString dataDirectory;
+    MessageLog* messageLog;
+    QTimer* logSyncTimer;
+    bool restoringFromLog;  // Suppresses re-appending while hydrating from disk
+    int logSyncTicks;
+
+    PacketCapture* packetCapture;  // Optional received-datagram capture
+    bool transmitEnabled;
+    QRandomGenerator* randomGenerator;  // QRandomGenerator::global(), or seededRandom
+    QRandomGenerator seededRandom;
+    bool packetLogging;
+    EventTrace trace;
+    QString traceFile;  // Saved on destruction; empty = keep in memory only
+
+    // Delivery latency tracing
+    double deliveryTraceRate;
+    qint64 datagramArrivalUs;  // Receive time of the datagram being processed
+    QList<DeliveryTrace> deliveryTraces;
+
+    // Relayed private messages: IDs only, briefly, for loop and duplicate suppression
+    struct TransitEntry {
+        qint64 expiry;
+        quint32 hopLimit;  // Highest hop limit seen; a copy arriving with less has looped or detoured
+    };
+    QHash<QString, TransitEntry> transitCache;  // messageId -> entry
+    QQueue<QPair<qint64, QString>> transitOrder;  // Expiry order (uniform TTL, so insertion order)
 
     // Reliable delivery
     struct PendingMessage {
@@ -124,19 +526,80 @@ private:
         int retryCount;
     };
     QMap<QString, PendingMessage> pendingAcks;  // messageId -> PendingMessage
-    QMap<QString, int> nextSequenceNumbers;  // destination -> next sequence number
+    int nextSequenceNumber;  // Next chat sequence number; one counter per origin keeps IDs unique
+    int lastBroadcastSequence;  // Our latest broadcast; the next one links back to it for gap detection
 
     // PA3: Routing table
     QMap<QString, RouteInfo> routingTable;  // destination -> RouteInfo
-    int routeSeqNo;  // Our own route sequence number
+
+    // Route discovery
+    struct PendingRouteMessage {
+        Message message;
+        bool requireAck;
+        bool forwarded;  // Relayed traffic: hop limit already spent, send straight to the next hop
+        qint64 arrivalUs;  // Relayed traffic: when it reached us, for its delivery trace hop
+    };
+    struct RouteDiscovery {
+        qint64 startedAt;
+        int attempts;
+    };
+    QMap<QString, QList<PendingRouteMessage>> pendingRouteMessages;  // destination -> buffered messages
+    QMap<QString, RouteDiscovery> activeDiscoveries;  // destination -> discovery state
+    QMap<QString, qint64> seenRouteRequests;  // origin_requestId -> time first seen
+    int pendingRouteMessageCount;
+    int nextRouteRequestId;
+    int routeSeqNo;  // Our own route sequence number (always even; odd marks a broken route)
+    bool triggeredUpdatePending;
     bool noForwardMode;  // If true, don't forward chat messages (rendezvous mode)
 
     // Configuration
-    static const int ANTI_ENTROPY_INTERVAL = 2000;  // 2 seconds
+    static const int ANTI_ENTROPY_INTERVAL = 2000;  // 2 seconds (starting period)
+    static const int MIN_ANTI_ENTROPY_INTERVAL = 500;
+    static const int CATCH_UP_TICK = 50;
+    static const int STORE_COMPACTION_INTERVAL = 10000;
+    static const int LOG_SYNC_INTERVAL = 200;  // Batched fsync period
+    static const int LOG_SNAPSHOT_TICKS = 50;  // Snapshot every 50 sync ticks (10 s)
+    static const quint32 TOPOLOGY_SNAPSHOT_VERSION = 1;
+    static const int TRANSIT_CACHE_TTL = 30000;
+    static const int MAX_TRANSIT_CACHE_ENTRIES = 4096;
+    static const int NACK_INTERVAL = 200;  // At most one NACK per origin per interval
+    static const int MAX_NACK_ATTEMPTS = 3;  // Then leave the gap to anti-entropy
+    static const int MAX_NACK_GAP = 64;  // Only the most recent sequence numbers of a larger gap are NACKed
+    static const int DEFAULT_CATCH_UP_BYTE_RATE = 256 * 1024;  // Well under a default UDP receive buffer per tick
+    static const int MAX_ANTI_ENTROPY_INTERVAL = 30000;
+    static const int SYNC_AGE_CAP = 60;  // Seconds of staleness that still add selection weight
+    static const int DIVERGENCE_WEIGHT = 10;  // Selection weight per recent difference
     static const int ACK_CHECK_INTERVAL = 1000;  // 1 second
     static const int ACK_TIMEOUT = 2000;  // 2 seconds
     static const int MAX_RETRIES = 3;
+    static const int MAX_DELIVERY_TRACES = 100;
     static const int PEER_HEALTH_CHECK_INTERVAL = 5000;  // 5 seconds
     static const int PEER_TIMEOUT = 15000;  // 15 seconds
     static const int ROUTE_RUMOR_INTERVAL = 60000;  // 60 seconds (1 minute)
+    static const int ROUTE_TIMEOUT = 3 * ROUTE_RUMOR_INTERVAL;  // Routes not refreshed for three periods are stale
+    static const int PROVISIONAL_ROUTE_TTL = ROUTE_RUMOR_INTERVAL + 10000;  // One advertisement period to confirm a restored route
+    static const int TRIGGERED_UPDATE_DELAY = 500;  // Coalesce bursts of route changes
+    static const int MAX_EQUAL_COST_PATHS = 4;  // Primary next hop plus up to three alternates
+    static const int LINK_PROBE_INTERVAL = 5000;  // 5 seconds
+    static constexpr double LINK_EWMA_ALPHA = 0.2;  // Weight of the newest probe sample
+    static constexpr double RTT_COST_UNIT_MS = 50.0;  // Every 50 ms of RTT costs as much as one hop
+    static constexpr double LOSS_COST_WEIGHT = 4.0;  // 25% loss costs as much as one hop
+    static constexpr double ROUTE_COST_HYSTERESIS = 0.25;  // Avoid flapping between near-equal paths
+    static constexpr double ECMP_COST_SLACK = 1.0;  // Alternates this much worse than the best link are skipped
+    static const int ROUTE_DISCOVERY_TIMEOUT = 2000;  // Wait this long for a route reply before retrying
+    static const int MAX_ROUTE_DISCOVERY_ATTEMPTS = 3;
+    static const int ROUTE_REQUEST_TTL = 8;  // Hops a route request may travel
+    static const int ROUTE_REQUEST_MEMORY = 30000;  // Remember seen requests for duplicate suppression
+    static const int MAX_PENDING_PER_DESTINATION = 16;
+    static const int MAX_PENDING_ROUTE_MESSAGES = 256;
+    static const int RUMOR_ROUND_INTERVAL = 1000;  // 1 second
+    static const int DEFAULT_RUMOR_FANOUT = 2;
+    static const int DEFAULT_RUMOR_STOP_K = 2;  // Stop probability reaches 1 after k "already had" replies
+    static const int MAX_RUMOR_ROUNDS = 10;  // Hard bound on how long one rumor stays hot
+    static const int BROADCAST_TREE_TICK = 100;  // Lazy announcement batching
+    static const int GRAFT_TIMEOUT = 500;  // Wait this long for the eager copy before grafting
+    static const int MAX_IDS_PER_IHAVE = 100;
+    static const int INITIAL_IBLT_CELLS = 48;  // Decodes differences of ~30 messages
+    static const int MAX_IBLT_CELLS = 1536;  // ~40 KB once base64-encoded; beyond this fall back to vector clocks
+    static const int MAX_ROUTES_PER_ADVERTISEMENT = 200;  // Keeps advertisements well under the UDP limit
 };
@@ -0,0 +1,172 @@
+#include "nodeconfig.h"
+#include <QCommandLineParser>
+#include <QDebug>
+#include <cstring>
+
+const QList<int> NodeConfig::DEFAULT_PORTS = {9001, 9002, 9003, 9004};
+
+QString NodeConfig::nodeIdForPort(int port) {
+    int nodeNumber = DEFAULT_PORTS.indexOf(port);
+    if (nodeNumber >= 0) {
+        return QString("Node%1").arg(nodeNumber + 1);
+    }
+    return QString("Node%1").arg(port);
+}
+
+QList<int> NodeConfig::discoveryPorts() const {
+    // PA3: If in noforward mode (rendezvous server) and no peers specified, don't use defaults
+    if (noForwardMode && peerPorts.isEmpty()) {
+        return QList<int>();  // Empty - rendezvous waits for connections
+    }
+    return peerPorts.isEmpty() ? DEFAULT_PORTS : peerPorts;
+}
+
+bool NodeConfig::isHeadlessRequested(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+NodeConfig NodeConfig::fromArguments(const QStringList& arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("SimpleChat - P2P Messaging with DSDV Routing and NAT Traversal");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption portOption(QStringList() << "p" << "port",
+                                  "Port number for this node (9001-9004)", "port", "9001");
+    parser.addOption(portOption);
+
+    QCommandLineOption peersOption(QStringList() << "peers",
+                                   "Comma-separated list of peer ports (e.g., 9001,9002,9003,9004)", "peers");
+    parser.addOption(peersOption);
+
+    // PA3: Add -noforward option for rendezvous server mode
+    QCommandLineOption noforwardOption(QStringList() << "noforward",
+                                       "Run in rendezvous server mode (forward route rumors only, not chat messages)");
+    parser.addOption(noforwardOption);
+
+    // PA3: Add -connect option to connect to a specific peer
+    QCommandLineOption connectOption(QStringList() << "connect",
+                                     "Connect to a specific port (e.g., for rendezvous server)", "connect");
+    parser.addOption(connectOption);
+
+    QCommandLineOption dataDirOption(QStringList() << "data-dir",
+                                     "Persist messages in this directory and resume from it on restart", "dir");
+    parser.addOption(dataDirOption);
+
+    QCommandLineOption fsyncOption(QStringList() << "fsync",
+                                   "Message log fsync policy: always, batch (default) or none", "policy", "batch");
+    parser.addOption(fsyncOption);
+
+    QCommandLineOption headlessOption(QStringList() << "headless",
+                                      "Run without a window (QCoreApplication only), logging to stdout or --log-file");
+    parser.addOption(headlessOption);
+
+    QCommandLineOption logFileOption(QStringList() << "log-file",
+                                     "Headless mode: append log output to this file instead of stdout", "file");
+    parser.addOption(logFileOption);
+
+    QCommandLineOption controlSocketOption(QStringList() << "control-socket",
+                                           "Serve the line-delimited JSON control API on this local socket", "path");
+    parser.addOption(controlSocketOption);
+
+    QCommandLineOption captureOption(QStringList() << "capture",
+                                     "Record every received datagram to this pcap file (see simplechat_replay)", "file");
+    parser.addOption(captureOption);
+
+    QCommandLineOption metricsPortOption(QStringList() << "metrics-port",
+                                         "Serve Prometheus metrics at http://127.0.0.1:<port>/metrics", "port");
+    parser.addOption(metricsPortOption);
+
+    QCommandLineOption metricsFileOption(QStringList() << "metrics-file",
+                                         "Write Prometheus metrics to this file every 10 s and on exit", "file");
+    parser.addOption(metricsFileOption);
+
+    QCommandLineOption traceOption(QStringList() << "trace",
+                                   "Record packet events in a binary ring, saved to this file on exit "
+                                   "(see simplechat_tracedecode)", "file");
+    parser.addOption(traceOption);
+
+    QCommandLineOption verboseOption(QStringList() << "verbose",
+                                     "Log every sent, forwarded and gossiped packet and every route change");
+    parser.addOption(verboseOption);
+
+    QCommandLineOption deliveryTraceOption(QStringList() << "delivery-trace-rate",
+                                           "Fraction (0-1) of sent private messages that record per-hop timestamps",
+                                           "fraction", "0");
+    parser.addOption(deliveryTraceOption);
+
+    parser.process(arguments);
+
+    NodeConfig config;
+
+    bool ok;
+    config.port = parser.value(portOption).toInt(&ok);
+    if (!ok || config.port < 1024 || config.port > 65535) {
+        qDebug() << "Invalid port number. Using default port 9001.";
+        config.port = 9001;
+    }
+
+    // Parse peer ports if provided
+    if (parser.isSet(peersOption)) {
+        QStringList peersList = parser.value(peersOption).split(',');
+        for (const QString& peerStr : peersList) {
+            int peerPort = peerStr.trimmed().toInt(&ok);
+            if (ok && peerPort >= 1024 && peerPort <= 65535) {
+                config.peerPorts.append(peerPort);
+            }
+        }
+    }
+
+    // PA3: Add connect port if specified
+    if (parser.isSet(connectOption)) {
+        int connectPort = parser.value(connectOption).toInt(&ok);
+        if (ok && connectPort >= 1024 && connectPort <= 65535) {
+            config.peerPorts.append(connectPort);
+            qDebug() << "Connecting to rendezvous server on port" << connectPort;
+        }
+    }
+
+    // PA3: Check noforward mode
+    config.noForwardMode = parser.isSet(noforwardOption);
+    if (config.noForwardMode) {
+        qDebug() << "Running in NOFORWARD mode (rendezvous server)";
+    }
+
+    config.dataDir = parser.value(dataDirOption);
+    QString fsyncValue = parser.value(fsyncOption);
+    if (fsyncValue == "always") {
+        config.syncPolicy = MessageLog::SYNC_ALWAYS;
+    } else if (fsyncValue == "none") {
+        config.syncPolicy = MessageLog::SYNC_NONE;
+    }
+
+    config.headless = parser.isSet(headlessOption);
+    config.logFile = parser.value(logFileOption);
+    config.controlSocket = parser.value(controlSocketOption);
+    config.captureFile = parser.value(captureOption);
+
+    if (parser.isSet(metricsPortOption)) {
+        int metricsPort = parser.value(metricsPortOption).toInt(&ok);
+        if (ok && metricsPort >= 1024 && metricsPort <= 65535) {
+            config.metricsPort = metricsPort;
+        } else {
+            qDebug() << "Invalid metrics port" << parser.value(metricsPortOption) << "- metrics endpoint disabled";
+        }
+    }
+    config.metricsFile = parser.value(metricsFileOption);
+    config.traceFile = parser.value(traceOption);
+    config.verbose = parser.isSet(verboseOption);
+
+    double traceRate = parser.value(deliveryTraceOption).toDouble(&ok);
+    if (ok && traceRate >= 0.0 && traceRate <= 1.0) {
+        config.deliveryTraceRate = traceRate;
+    } else {
+        qDebug() << "Invalid delivery trace rate" << parser.value(deliveryTraceOption) << "- tracing disabled";
+    }
+    return config;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include "messagelog.h"
+
+// Command-line settings shared by the GUI and the headless daemon
+struct NodeConfig {
+    int port;
+    QList<int> peerPorts;  // Explicit --peers, plus the --connect port
+    bool noForwardMode;
+    QString dataDir;
+    MessageLog::SyncPolicy syncPolicy;
+    bool headless;
+    QString logFile;  // Headless only; empty = stdout
+    QString controlSocket;  // Local control API socket; empty = disabled
+    QString captureFile;  // pcap of received datagrams; empty = disabled
+    int metricsPort;  // Prometheus endpoint on 127.0.0.1; 0 = disabled
+    QString metricsFile;  // Periodic metrics dump; empty = disabled
+    QString traceFile;  // Binary packet-event trace, saved on exit; empty = disabled
+    bool verbose;  // Per-packet log lines
+    double deliveryTraceRate;  // Fraction of own private messages carrying a latency trace
+
+    NodeConfig() : port(9001), noForwardMode(false), syncPolicy(MessageLog::SYNC_BATCHED), headless(false),
+                   metricsPort(0), verbose(false), deliveryTraceRate(0.0) {}
+
+    QString nodeId() const { return nodeIdForPort(port); }
+    QList<int> discoveryPorts() const;  // Ports to probe at startup
+
+    // Parses (and on --help/--version, exits); needs a Q(Core)Application to exist
+    static NodeConfig fromArguments(const QStringList& arguments);
+
+    // Checked before any application object exists, to pick QCoreApplication over QApplication
+    static bool isHeadlessRequested(int argc, char* argv[]);
+
+    static QString nodeIdForPort(int port);  // Node1-Node4 for the default ports, else Node<port>
+
+    static const QList<int> DEFAULT_PORTS;
+};
@@ -0,0 +1,319 @@
+#include "packetcapture.h"
+#include <QDateTime>
+#include <QtEndian>
+
+namespace {
+
+const quint32 PCAP_MAGIC_MICRO = 0xa1b2c3d4;
+const quint32 PCAP_MAGIC_NANO = 0xa1b23c4d;
+const int PCAP_HEADER_SIZE = 24;
+const int RECORD_HEADER_SIZE = 16;
+const int IPV4_HEADER_SIZE = 20;
+const int IPV6_HEADER_SIZE = 40;
+const int UDP_HEADER_SIZE = 8;
+const quint8 IP_PROTO_UDP = 17;
+
+void appendLE32(QByteArray& out, quint32 value) {
+    char bytes[4];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, 4);
+}
+
+void appendLE16(QByteArray& out, quint16 value) {
+    char bytes[2];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, 2);
+}
+
+void appendBE16(QByteArray& out, quint16 value) {
+    char bytes[2];
+    qToBigEndian(value, bytes);
+    out.append(bytes, 2);
+}
+
+void appendBE32(QByteArray& out, quint32 value) {
+    char bytes[4];
+    qToBigEndian(value, bytes);
+    out.append(bytes, 4);
+}
+
+quint16 readBE16(const char* data) {
+    return qFromBigEndian<quint16>(reinterpret_cast<const uchar*>(data));
+}
+
+// RFC 1071 ones' complement sum, folded
+quint32 checksumAdd(quint32 sum, const char* data, int length) {
+    const uchar* bytes = reinterpret_cast<const uchar*>(data);
+    for (int i = 0; i + 1 < length; i += 2) {
+        sum += (bytes[i] << 8) | bytes[i + 1];
+    }
+    if (length % 2) {
+        sum += bytes[length - 1] << 8;
+    }
+    return sum;
+}
+
+quint16 checksumFinish(quint32 sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return static_cast<quint16>(~sum);
+}
+
+// IPv4-mapped IPv6 senders (::ffff:a.b.c.d) are stored as plain IPv4
+bool asIPv4(const QHostAddress& address, quint32* ipv4) {
+    bool ok = false;
+    *ipv4 = address.toIPv4Address(&ok);
+    return ok;
+}
+
+}
+
+PacketCapture::PacketCapture() : openedAtNs(0), lastFlushMs(0), records(0) {}
+
+PacketCapture::~PacketCapture() {
+    close();
+}
+
+bool PacketCapture::open(const QString& path) {
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    QByteArray header;
+    appendLE32(header, PCAP_MAGIC_NANO);
+    appendLE16(header, 2);  // Format version 2.4
+    appendLE16(header, 4);
+    appendLE32(header, 0);  // GMT offset
+    appendLE32(header, 0);  // Timestamp accuracy
+    appendLE32(header, SNAPLEN);
+    appendLE32(header, LINKTYPE_RAW);
+    if (file.write(header) != header.size()) {
+        file.close();
+        return false;
+    }
+
+    openedAtNs = QDateTime::currentMSecsSinceEpoch() * 1000000;
+    monotonic.start();
+    lastFlushMs = 0;
+    records = 0;
+    return true;
+}
+
+void PacketCapture::close() {
+    if (file.isOpen()) {
+        file.flush();
+        file.close();
+    }
+}
+
+void PacketCapture::record(const QByteArray& datagram, const QHostAddress& senderHost, quint16 senderPort,
+                           const QHostAddress& receiverHost, quint16 receiverPort) {
+    if (!file.isOpen()) {
+        return;
+    }
+
+    qint64 timestampNs = openedAtNs + monotonic.nsecsElapsed();
+    QByteArray packet = encapsulate(datagram, senderHost, senderPort, receiverHost, receiverPort);
+    quint32 capturedLength = qMin(static_cast<quint32>(packet.size()), static_cast<quint32>(SNAPLEN));
+
+    QByteArray out;
+    out.reserve(RECORD_HEADER_SIZE + static_cast<int>(capturedLength));
+    appendLE32(out, static_cast<quint32>(timestampNs / 1000000000));
+    appendLE32(out, static_cast<quint32>(timestampNs % 1000000000));
+    appendLE32(out, capturedLength);
+    appendLE32(out, static_cast<quint32>(packet.size()));
+    out.append(packet.constData(), static_cast<int>(capturedLength));
+    file.write(out);
+    records++;
+
+    qint64 nowMs = monotonic.elapsed();
+    if (nowMs - lastFlushMs >= FLUSH_INTERVAL) {
+        file.flush();
+        lastFlushMs = nowMs;
+    }
+}
+
+QByteArray PacketCapture::encapsulate(const QByteArray& datagram, const QHostAddress& senderHost, quint16 senderPort,
+                                      const QHostAddress& receiverHost, quint16 receiverPort) {
+    int udpLength = UDP_HEADER_SIZE + static_cast<int>(datagram.size());
+    QByteArray udp;
+    udp.reserve(udpLength);
+    appendBE16(udp, senderPort);
+    appendBE16(udp, receiverPort);
+    appendBE16(udp, static_cast<quint16>(qMin(udpLength, 0xffff)));
+    appendBE16(udp, 0);  // Checksum, filled in below
+    udp.append(datagram);
+
+    QByteArray packet;
+    quint32 source4 = 0;
+    quint32 destination4 = 0;
+    quint32 pseudoSum = 0;
+    if (asIPv4(senderHost, &source4) && asIPv4(receiverHost.isNull() ? QHostAddress(QHostAddress::LocalHost) : receiverHost,
+                                                &destination4)) {
+        packet.reserve(IPV4_HEADER_SIZE + udpLength);
+        packet.append(char(0x45));  // Version 4, 5-word header
+        packet.append(char(0));
+        appendBE16(packet, static_cast<quint16>(qMin(IPV4_HEADER_SIZE + udpLength, 0xffff)));
+        appendBE16(packet, 0);  // Identification
+        appendBE16(packet, 0x4000);  // Don't fragment
+        packet.append(char(64));  // TTL
+        packet.append(char(IP_PROTO_UDP));
+        appendBE16(packet, 0);  // Header checksum, filled in below
+        appendBE32(packet, source4);
+        appendBE32(packet, destination4);
+        qToBigEndian(checksumFinish(checksumAdd(0, packet.constData(), IPV4_HEADER_SIZE)),
+                     reinterpret_cast<uchar*>(packet.data() + 10));
+
+        pseudoSum = checksumAdd(pseudoSum, packet.constData() + 12, 8);
+    } else {
+        Q_IPV6ADDR source6 = senderHost.toIPv6Address();
+        Q_IPV6ADDR destination6 = (receiverHost.isNull() ? QHostAddress(QHostAddress::LocalHostIPv6) : receiverHost)
+                                      .toIPv6Address();
+        packet.reserve(IPV6_HEADER_SIZE + udpLength);
+        appendBE32(packet, 0x60000000);  // Version 6, no traffic class or flow label
+        appendBE16(packet, static_cast<quint16>(qMin(udpLength, 0xffff)));
+        packet.append(char(IP_PROTO_UDP));
+        packet.append(char(64));  // Hop limit
+        packet.append(reinterpret_cast<const char*>(source6.c), 16);
+        packet.append(reinterpret_cast<const char*>(destination6.c), 16);
+
+        pseudoSum = checksumAdd(pseudoSum, packet.constData() + 8, 32);
+    }
+
+    // UDP checksum over the pseudo-header (addresses, protocol, length) and the datagram
+    pseudoSum += IP_PROTO_UDP;
+    pseudoSum += static_cast<quint32>(udpLength);
+    quint16 udpChecksum = checksumFinish(checksumAdd(pseudoSum, udp.constData(), udp.size()));
+    qToBigEndian<quint16>(udpChecksum == 0 ? 0xffff : udpChecksum, reinterpret_cast<uchar*>(udp.data() + 6));
+
+    packet.append(udp);
+    return packet;
+}
+
+PacketCaptureReader::PacketCaptureReader() : swapped(false), nanosecond(false), linkType(0), skipped(0) {}
+
+quint32 PacketCaptureReader::readU32(const char* data) const {
+    quint32 value = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data));
+    return swapped ? qbswap(value) : value;
+}
+
+bool PacketCaptureReader::open(const QString& path) {
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+
+    QByteArray header = file.read(PCAP_HEADER_SIZE);
+    if (header.size() != PCAP_HEADER_SIZE) {
+        error = "truncated pcap header";
+        return false;
+    }
+
+    quint32 magic = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(header.constData()));
+    swapped = (magic == qbswap(PCAP_MAGIC_MICRO) || magic == qbswap(PCAP_MAGIC_NANO));
+    magic = swapped ? qbswap(magic) : magic;
+    if (magic != PCAP_MAGIC_MICRO && magic != PCAP_MAGIC_NANO) {
+        error = "not a pcap file (pcapng is not supported)";
+        return false;
+    }
+    nanosecond = (magic == PCAP_MAGIC_NANO);
+
+    linkType = readU32(header.constData() + 20) & 0x0fffffff;  // Upper bits carry FCS flags
+    if (linkType != PacketCapture::LINKTYPE_RAW && linkType != PacketCapture::LINKTYPE_ETHERNET) {
+        error = QString("unsupported link type %1").arg(linkType);
+        return false;
+    }
+    return true;
+}
+
+bool PacketCaptureReader::next(PacketCapture::Record* record) {
+    while (true) {
+        QByteArray header = file.read(RECORD_HEADER_SIZE);
+        if (header.size() != RECORD_HEADER_SIZE) {
+            return false;  // End of file (a torn last record is ignored)
+        }
+
+        quint32 seconds = readU32(header.constData());
+        quint32 fraction = readU32(header.constData() + 4);
+        quint32 capturedLength = readU32(header.constData() + 8);
+        quint32 originalLength = readU32(header.constData() + 12);
+        if (capturedLength > PacketCapture::SNAPLEN) {
+            error = "corrupt record length";
+            return false;
+        }
+
+        QByteArray packet = file.read(capturedLength);
+        if (packet.size() != static_cast<int>(capturedLength)) {
+            return false;
+        }
+        if (capturedLength < originalLength || !parsePacket(packet, record)) {
+            skipped++;  // Truncated by the snap length, or not a UDP datagram
+            continue;
+        }
+
+        record->timestampNs = static_cast<qint64>(seconds) * 1000000000 + (nanosecond ? fraction : fraction * qint64(1000));
+        return true;
+    }
+}
+
+bool PacketCaptureReader::parsePacket(const QByteArray& packet, PacketCapture::Record* record) const {
+    const char* data = packet.constData();
+    int length = static_cast<int>(packet.size());
+    int offset = 0;
+
+    if (linkType == PacketCapture::LINKTYPE_ETHERNET) {
+        if (length < 14) {
+            return false;
+        }
+        quint16 etherType = readBE16(data + 12);
+        offset = 14;
+        if (etherType == 0x8100 && length >= 18) {  // 802.1Q VLAN tag
+            etherType = readBE16(data + 16);
+            offset = 18;
+        }
+        if (etherType != 0x0800 && etherType != 0x86dd) {
+            return false;
+        }
+    }
+
+    if (length - offset < 1) {
+        return false;
+    }
+    int version = static_cast<uchar>(data[offset]) >> 4;
+    int udpOffset = 0;
+    if (version == 4) {
+        int headerLength = (static_cast<uchar>(data[offset]) & 0x0f) * 4;
+        if (headerLength < IPV4_HEADER_SIZE || length - offset < headerLength ||
+            static_cast<uchar>(data[offset + 9]) != IP_PROTO_UDP || (readBE16(data + offset + 6) & 0x3fff) != 0) {
+            return false;  // Not UDP, or a fragment
+        }
+        record->senderHost = QHostAddress(qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data + offset + 12)));
+        record->receiverHost = QHostAddress(qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data + offset + 16)));
+        udpOffset = offset + headerLength;
+    } else if (version == 6) {
+        if (length - offset < IPV6_HEADER_SIZE || static_cast<uchar>(data[offset + 6]) != IP_PROTO_UDP) {
+            return false;  // Extension headers are not followed
+        }
+        record->senderHost = QHostAddress(reinterpret_cast<const quint8*>(data + offset + 8));
+        record->receiverHost = QHostAddress(reinterpret_cast<const quint8*>(data + offset + 24));
+        udpOffset = offset + IPV6_HEADER_SIZE;
+    } else {
+        return false;
+    }
+
+    if (length - udpOffset < UDP_HEADER_SIZE) {
+        return false;
+    }
+    int udpLength = readBE16(data + udpOffset + 4);
+    if (udpLength < UDP_HEADER_SIZE || udpLength > length - udpOffset) {
+        return false;
+    }
+    record->senderPort = readBE16(data + udpOffset);
+    record->receiverPort = readBE16(data + udpOffset + 2);
+    record->datagram = QByteArray(data + udpOffset + UDP_HEADER_SIZE, udpLength - UDP_HEADER_SIZE);
+    return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QFile>
+#include <QHostAddress>
+#include <QElapsedTimer>
+
+// Received-datagram capture in pcap format, so Wireshark and tcpdump can open it.
+//
+// Each datagram is written as a raw IP packet (LINKTYPE_RAW) with synthesized
+// IPv4/IPv6 and UDP headers carrying the sender and receiver addresses.
+// Timestamps have nanosecond resolution: wall-clock time when the capture was
+// opened plus a monotonic offset, so they never run backwards within a file.
+class PacketCapture {
+public:
+    struct Record {
+        qint64 timestampNs;  // Since the Unix epoch
+        QHostAddress senderHost;
+        quint16 senderPort;
+        QHostAddress receiverHost;
+        quint16 receiverPort;
+        QByteArray datagram;  // UDP payload
+
+        Record() : timestampNs(0), senderPort(0), receiverPort(0) {}
+    };
+
+    static const quint32 LINKTYPE_ETHERNET = 1;
+    static const quint32 LINKTYPE_RAW = 101;
+    static const quint32 SNAPLEN = 262144;
+    static const int FLUSH_INTERVAL = 1000;  // ms; bounds what a crash can lose
+
+    PacketCapture();
+    ~PacketCapture();
+
+    bool open(const QString& path);  // Truncates an existing file
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+    QString fileName() const { return file.fileName(); }
+    quint64 recordCount() const { return records; }
+
+    void record(const QByteArray& datagram, const QHostAddress& senderHost, quint16 senderPort,
+                const QHostAddress& receiverHost, quint16 receiverPort);
+
+    // IP + UDP packet around a payload, as stored in the capture
+    static QByteArray encapsulate(const QByteArray& datagram, const QHostAddress& senderHost, quint16 senderPort,
+                                  const QHostAddress& receiverHost, quint16 receiverPort);
+
+private:
+    QFile file;
+    QElapsedTimer monotonic;
+    qint64 openedAtNs;
+    qint64 lastFlushMs;
+    quint64 records;
+};
+
+// Sequential reader for PacketCapture files and for tcpdump captures of
+// SimpleChat traffic (raw IP or Ethernet; microsecond or nanosecond
+// timestamps; either byte order). Packets that are not complete UDP
+// datagrams are skipped.
+class PacketCaptureReader {
+public:
+    PacketCaptureReader();
+
+    bool open(const QString& path);
+    bool next(PacketCapture::Record* record);
+    QString errorString() const { return error; }
+    quint64 skippedPackets() const { return skipped; }
+
+private:
+    quint32 readU32(const char* data) const;
+    bool parsePacket(const QByteArray& packet, PacketCapture::Record* record) const;
+
+    QFile file;
+    QString error;
+    bool swapped;  // File written on a machine of the other byte order
+    bool nanosecond;
+    quint32 linkType;
+    quint64 skipped;
+};
@@ -3,12 +3,12 @@
 #include <QMessageBox>
 #include <QDebug>
 
-const QList<int> SimpleChat::DEFAULT_PORTS = {9001, 9002, 9003, 9004};
+SimpleChat::SimpleChat(const NodeConfig& config, QObject* parent)
+    : QObject(parent), controlServer(nullptr), metricsServer(nullptr), serverPort(config.port) {
 
-SimpleChat::SimpleChat(int port, const QList<int>& peerPorts, bool noForwardMode, QObject* parent)
-    : QObject(parent), serverPort(port) {
-
-    nodeId = generateNodeId(port);
+    int port = config.port;
+    bool noForwardMode = config.noForwardMode;
+    nodeId = config.nodeId();
 
     window = new ChatWindow();
     window->setNodeId(nodeId);
@@ -21,26 +21,53 @@ SimpleChat::SimpleChat(int port, const QList<int>& peerPorts, bool noForwardMode
         networkManager->setNoForwardMode(true);
     }
 
-    connect(window, &ChatWindow::messageEntered, this, &SimpleChat::onMessageEntered);
-    connect(window, &ChatWindow::addPeerRequested, this, &SimpleChat::onAddPeerRequested);
+    // Connected first: the warm start below announces restored peers
     connect(networkManager, &NetworkManager::messageReceived, this, &SimpleChat::onMessageReceived);
     connect(networkManager, &NetworkManager::peerDiscovered, this, &SimpleChat::onPeerDiscovered);
     connect(networkManager, &NetworkManager::peerStatusChanged, this, &SimpleChat::onPeerStatusChanged);
 
+    // Resume from the on-disk log, if enabled
+    if (!config.dataDir.isEmpty() && !networkManager->enablePersistence(config.dataDir, config.syncPolicy)) {
+        qDebug() << "Failed to open message log in" << config.dataDir << "- running without persistence";
+    }
+
+    if (!config.captureFile.isEmpty() && !networkManager->enableCapture(config.captureFile)) {
+        qDebug() << "Failed to open capture file" << config.captureFile;
+    }
+
+    networkManager->setPacketLogging(config.verbose);
+    networkManager->setDeliveryTraceRate(config.deliveryTraceRate);
+    if (!config.traceFile.isEmpty()) {
+        networkManager->enableTrace(config.traceFile);
+    }
+
+    connect(window, &ChatWindow::messageEntered, this, &SimpleChat::onMessageEntered);
+    connect(window, &ChatWindow::addPeerRequested, this, &SimpleChat::onAddPeerRequested);
     if (!networkManager->startServer(port)) {
         QMessageBox::critical(nullptr, "Error", QString("Failed to start server on port %1").arg(port));
         QApplication::exit(1);
         return;
     }
 
-    // Use provided peer ports or defaults
-    // PA3: If in noforward mode (rendezvous server) and no peers specified, don't use defaults
-    if (noForwardMode && peerPorts.isEmpty()) {
-        discoveryPorts = QList<int>();  // Empty - rendezvous waits for connections
-    } else {
-        discoveryPorts = peerPorts.isEmpty() ? DEFAULT_PORTS : peerPorts;
+    // Scripting and health checks without the GUI
+    if (!config.controlSocket.isEmpty()) {
+        controlServer = new ControlServer(networkManager, this);
+        controlServer->listen(config.controlSocket);
+    }
+
+    if (config.metricsPort > 0 || !config.metricsFile.isEmpty()) {
+        metricsServer = new MetricsServer(networkManager, this);
+        if (config.metricsPort > 0) {
+            metricsServer->listen(static_cast<quint16>(config.metricsPort));
+        }
+        if (!config.metricsFile.isEmpty()) {
+            metricsServer->setDumpFile(config.metricsFile);
+        }
     }
 
+    // Use provided peer ports or defaults
+    discoveryPorts = config.discoveryPorts();
+
     QString modeStr = noForwardMode ? " (RENDEZVOUS SERVER MODE)" : " with DSDV Routing";
     window->appendMessage(QString("SimpleChat P2P Node %1 started on port %2%3").arg(nodeId).arg(port).arg(modeStr));
     window->appendMessage("Features: DSDV Routing, Private Messaging, Route Rumors, NAT Traversal");
@@ -62,14 +89,6 @@ void SimpleChat::show() {
     window->show();
 }
 
-QString SimpleChat::generateNodeId(int port) {
-    int nodeNumber = DEFAULT_PORTS.indexOf(port);
-    if (nodeNumber >= 0) {
-        return QString("Node%1").arg(nodeNumber + 1);
-    }
-    return QString("Node%1").arg(port);
-}
-
 void SimpleChat::setupPeerDiscovery() {
     if (discoveryPorts.isEmpty()) {
         return;  // No peers to discover
@@ -145,7 +164,7 @@ void SimpleChat::onPeerStatusChanged(const QString& peerId, bool active) {
 
 void SimpleChat::onAddPeerRequested(const QString& host, int port) {
     // Generate peer ID from port
-    QString peerId = generateNodeId(port);
+    QString peerId = NodeConfig::nodeIdForPort(port);
 
     window->appendMessage(QString("Manually adding peer %1 at %2:%3").arg(peerId).arg(host).arg(port));
 
@@ -5,12 +5,15 @@
 #include "chatwindow.h"
 #include "networkmanager.h"
 #include "message.h"
+#include "nodeconfig.h"
+#include "controlserver.h"
+#include "metrics.h"
 
 class SimpleChat : public QObject {
     Q_OBJECT
 
 public:
-    explicit SimpleChat(int port, const QList<int>& peerPorts = QList<int>(), bool noForwardMode = false, QObject* parent = nullptr);
+    explicit SimpleChat(const NodeConfig& config, QObject* parent = nullptr);
     ~SimpleChat();
 
     void show();
@@ -23,14 +26,13 @@ private slots:
     void onAddPeerRequested(const QString& host, int port);
 
 private:
-    QString generateNodeId(int port);
     void setupPeerDiscovery();
 
     ChatWindow* window;
     NetworkManager* networkManager;
+    ControlServer* controlServer;
+    MetricsServer* metricsServer;
     int serverPort;
     QString nodeId;
     QList<int> discoveryPorts;
-
-    static const QList<int> DEFAULT_PORTS;
 };
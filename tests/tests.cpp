@@ -1,6 +1,21 @@
 #include <QtTest/QtTest>
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
 #include "../src/message.h"
 #include "../src/networkmanager.h"
+#include "../src/iblt.h"
+#include "../src/messagelog.h"
+#include "../src/nodeconfig.h"
+#include "../src/chatdaemon.h"
+#include "../src/controlserver.h"
+#include "../src/packetcapture.h"
+#include "../src/metrics.h"
+#include "../src/eventtrace.h"
+#include "../tools/deliverystats.h"
+#include "../tools/meshtopology.h"
 
 class TestPA3 : public QObject {
     Q_OBJECT
@@ -376,10 +391,1394 @@ private slots:
         qDebug() << "  ✓ Message ready for forwarding with updated fields";
     }
 
+    // =========================================================================
+    // ROUTE ADVERTISEMENT TESTS
+    // =========================================================================
+
+    // Test 21: Route Advertisement Serialization
+    void testRouteAdvertisementSerialization() {
+        qDebug() << "\n[Test 21] Route Advertisement Serialization";
+        Message advertisement("", "Node1", "Node2", 4, Message::ROUTE_ADVERTISEMENT);
+
+        QVariantList entries;
+        QVariantMap entry;
+        entry["Dest"] = "Node3";
+        entry["SeqNo"] = 8;
+        entry["Hops"] = 2;
+        entries.append(entry);
+        advertisement.setRouteEntries(entries);
+
+        Message restored = Message::fromDatagram(advertisement.toDatagram());
+        QCOMPARE(restored.getType(), Message::ROUTE_ADVERTISEMENT);
+        QCOMPARE(restored.getRouteEntries().size(), 1);
+
+        QVariantMap restoredEntry = restored.getRouteEntries().first().toMap();
+        QCOMPARE(restoredEntry["Dest"].toString(), QString("Node3"));
+        QCOMPARE(restoredEntry["SeqNo"].toInt(), 8);
+        QCOMPARE(restoredEntry["Hops"].toInt(), 2);
+        qDebug() << "  ✓ Route entries preserved in serialization";
+    }
+
+    // Test 22: Route Advertisement Updates Routing Table
+    void testRouteAdvertisementUpdatesTable() {
+        qDebug() << "\n[Test 22] Route Advertisement Updates Routing Table";
+        NetworkManager nm;
+        nm.setNodeId("Node47001");
+        QVERIFY(nm.startServer(47001));
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47002));
+
+        QVariantList entries;
+        QVariantMap self;
+        self["Dest"] = "Node47002";
+        self["SeqNo"] = 2;
+        self["Hops"] = 0;
+        entries.append(self);
+        QVariantMap far;
+        far["Dest"] = "Node47003";
+        far["SeqNo"] = 6;
+        far["Hops"] = 1;
+        entries.append(far);
+
+        Message advertisement("", "Node47002", "Node47001", 2, Message::ROUTE_ADVERTISEMENT);
+        advertisement.setRouteEntries(entries);
+        neighbor.writeDatagram(advertisement.toDatagram(), QHostAddress::LocalHost, 47001);
+
+        QTRY_COMPARE(nm.getRoutingTable().size(), 2);
+        RouteInfo direct = nm.getRoutingTable().value("Node47002");
+        RouteInfo indirect = nm.getRoutingTable().value("Node47003");
+        QVERIFY(direct.isDirect);
+        QCOMPARE(direct.hopCount, 1);
+        QCOMPARE(indirect.nextHop, QString("Node47002"));
+        QCOMPARE(indirect.hopCount, 2);
+        qDebug() << "  ✓ All advertised routes installed with hop-count metrics";
+    }
+
+    // Test 23: Broken Route Advertisement Invalidates Route
+    void testBrokenRouteAdvertisement() {
+        qDebug() << "\n[Test 23] Broken Route Advertisement";
+        NetworkManager nm;
+        nm.setNodeId("Node47011");
+        QVERIFY(nm.startServer(47011));
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47012));
+
+        QVariantMap entry;
+        entry["Dest"] = "Node47013";
+        entry["SeqNo"] = 4;
+        entry["Hops"] = 1;
+
+        Message advertisement("", "Node47012", "Node47011", 2, Message::ROUTE_ADVERTISEMENT);
+        advertisement.setRouteEntries(QVariantList() << entry);
+        neighbor.writeDatagram(advertisement.toDatagram(), QHostAddress::LocalHost, 47011);
+        QTRY_VERIFY(nm.getRoutingTable().contains("Node47013"));
+        QVERIFY(nm.getRoutingTable().value("Node47013").isReachable());
+
+        // DSDV broken link: odd sequence number with infinite metric
+        entry["SeqNo"] = 5;
+        entry["Hops"] = RouteInfo::INFINITE_METRIC;
+        advertisement.setRouteEntries(QVariantList() << entry);
+        neighbor.writeDatagram(advertisement.toDatagram(), QHostAddress::LocalHost, 47011);
+
+        QTRY_COMPARE(nm.getRoutingTable().value("Node47013").seqNo, 5);
+        QVERIFY(!nm.getRoutingTable().value("Node47013").isReachable());
+        qDebug() << "  ✓ Route invalidated by infinite-metric advertisement";
+    }
+
+    // Test 24: Equal-Cost Next Hops Kept As Alternates
+    void testEqualCostAlternates() {
+        qDebug() << "\n[Test 24] Equal-Cost Next Hops";
+        NetworkManager nm;
+        nm.setNodeId("Node47021");
+        QVERIFY(nm.startServer(47021));
+
+        QUdpSocket neighborA;
+        QUdpSocket neighborB;
+        QVERIFY(neighborA.bind(QHostAddress::LocalHost, 47022));
+        QVERIFY(neighborB.bind(QHostAddress::LocalHost, 47023));
+
+        QVariantMap entry;
+        entry["Dest"] = "Node47029";
+        entry["SeqNo"] = 6;
+        entry["Hops"] = 2;
+
+        Message fromA("", "Node47022", "Node47021", 2, Message::ROUTE_ADVERTISEMENT);
+        fromA.setRouteEntries(QVariantList() << entry);
+        neighborA.writeDatagram(fromA.toDatagram(), QHostAddress::LocalHost, 47021);
+        QTRY_VERIFY(nm.getRoutingTable().contains("Node47029"));
+
+        Message fromB("", "Node47023", "Node47021", 2, Message::ROUTE_ADVERTISEMENT);
+        fromB.setRouteEntries(QVariantList() << entry);
+        neighborB.writeDatagram(fromB.toDatagram(), QHostAddress::LocalHost, 47021);
+
+        QTRY_COMPARE(nm.getRoutingTable().value("Node47029").alternates.size(), 1);
+        RouteInfo route = nm.getRoutingTable().value("Node47029");
+        QCOMPARE(route.nextHop, QString("Node47022"));
+        QCOMPARE(route.alternates.first().peerId, QString("Node47023"));
+        qDebug() << "  ✓ Second equal-cost next hop kept as an alternate";
+    }
+
+    // Test 25: Link Quality Defaults
+    void testLinkQualityDefaults() {
+        qDebug() << "\n[Test 25] Link Quality Defaults";
+        PeerInfo peer("Node2", "127.0.0.1", 9002);
+        QCOMPARE(peer.probeSamples, 0);
+        QCOMPARE(peer.pendingProbeSeq, 0);
+        QCOMPARE(peer.rttEwma, 0.0);
+        QCOMPARE(peer.lossEwma, 0.0);
+
+        NetworkManager nm;
+        nm.setNodeId("Node1");
+        QCOMPARE(nm.getLinkCost("Node2"), 1.0);
+        QVERIFY(nm.getPeers().isEmpty());
+        qDebug() << "  ✓ Unmeasured links cost exactly one hop";
+    }
+
+    // Test 26: Route Discovery For Unknown Destination
+    void testRouteDiscovery() {
+        qDebug() << "\n[Test 26] On-Demand Route Discovery";
+        NetworkManager nm;
+        nm.setNodeId("Node47031");
+        QVERIFY(nm.startServer(47031));
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47032));
+
+        auto waitForType = [&neighbor](Message::MessageType type) {
+            QElapsedTimer timer;
+            timer.start();
+            while (timer.elapsed() < 5000) {
+                while (neighbor.hasPendingDatagrams()) {
+                    QByteArray datagram;
+                    datagram.resize(neighbor.pendingDatagramSize());
+                    neighbor.readDatagram(datagram.data(), datagram.size());
+                    Message message = Message::fromDatagram(datagram);
+                    if (message.getType() == type) {
+                        return message;
+                    }
+                }
+                QTest::qWait(20);
+            }
+            return Message();
+        };
+
+        // Make the neighbour known, then send to a node nobody has advertised
+        Message hello("", "Node47032", "Node47031", 1, Message::LINK_PROBE);
+        neighbor.writeDatagram(hello.toDatagram(), QHostAddress::LocalHost, 47031);
+        QTRY_VERIFY(nm.getPeers().contains("Node47032"));
+
+        nm.sendMessage(Message("Hello", "Node47031", "Node47039", 1));
+        Message request = waitForType(Message::ROUTE_REQUEST);
+        QCOMPARE(request.getDestination(), QString("Node47039"));
+        qDebug() << "  ✓ Route request flooded for unknown destination";
+
+        // Answer on behalf of the destination, one hop behind the neighbour
+        QVariantMap target;
+        target["Dest"] = "Node47039";
+        target["SeqNo"] = 2;
+        target["Hops"] = 1;
+        QVariantMap lastHop;
+        lastHop["Dest"] = "Node47032";
+        lastHop["SeqNo"] = 2;
+        lastHop["Hops"] = 0;
+
+        Message reply("", "Node47032", "Node47031", request.getSequenceNumber(), Message::ROUTE_REPLY);
+        reply.setRouteEntries(QVariantList() << target << lastHop);
+        neighbor.writeDatagram(reply.toDatagram(), QHostAddress::LocalHost, 47031);
+
+        Message released = waitForType(Message::CHAT_MESSAGE);
+        QCOMPARE(released.getDestination(), QString("Node47039"));
+        QCOMPARE(released.getChatText(), QString("Hello"));
+        QCOMPARE(nm.getRoutingTable().value("Node47039").hopCount, 2);
+        qDebug() << "  ✓ Buffered message released over the discovered route";
+    }
+
+    // Test 27: Rumor Feedback For Duplicates
+    void testRumorFeedback() {
+        qDebug() << "\n[Test 27] Rumor Mongering Feedback";
+        NetworkManager nm;
+        nm.setNodeId("Node47041");
+        nm.setRumorFanout(0);
+        QCOMPARE(nm.getRumorFanout(), 1);
+        nm.setRumorFanout(3);
+        QCOMPARE(nm.getRumorFanout(), 3);
+        QCOMPARE(nm.getRumorMode(), NetworkManager::RUMOR_PUSH);
+        QVERIFY(nm.startServer(47041));
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47042));
+
+        Message rumor("", "Node47042", "broadcast", 4, Message::ROUTE_RUMOR);
+        neighbor.writeDatagram(rumor.toDatagram(), QHostAddress::LocalHost, 47041);
+        QTRY_COMPARE(nm.getGossipStats().rumorsReceived, (quint64)1);
+
+        neighbor.writeDatagram(rumor.toDatagram(), QHostAddress::LocalHost, 47041);
+        QTRY_COMPARE(nm.getGossipStats().duplicateRumors, (quint64)1);
+
+        bool gotFeedback = false;
+        QElapsedTimer timer;
+        timer.start();
+        while (!gotFeedback && timer.elapsed() < 5000) {
+            while (neighbor.hasPendingDatagrams()) {
+                QByteArray datagram;
+                datagram.resize(neighbor.pendingDatagramSize());
+                neighbor.readDatagram(datagram.data(), datagram.size());
+                Message reply = Message::fromDatagram(datagram);
+                if (reply.getType() == Message::RUMOR_FEEDBACK) {
+                    QCOMPARE(reply.getMessageId(), QString("Node47042"));
+                    QCOMPARE(reply.getSequenceNumber(), 4);
+                    gotFeedback = true;
+                }
+            }
+            QTest::qWait(20);
+        }
+        QVERIFY(gotFeedback);
+        qDebug() << "  ✓ Duplicate rumor answered with feedback";
+
+        // A pull from a neighbour that is behind on our own route returns it
+        QVERIFY(QMetaObject::invokeMethod(&nm, "sendRouteRumor", Qt::DirectConnection));
+        QTest::qWait(200);
+        while (neighbor.hasPendingDatagrams()) {
+            QByteArray datagram;
+            datagram.resize(neighbor.pendingDatagramSize());
+            neighbor.readDatagram(datagram.data(), datagram.size());
+        }
+
+        QVariantMap behind;
+        behind["Node47042"] = 4;
+        Message pull("", "Node47042", "Node47041", 1, Message::RUMOR_PULL);
+        pull.setVectorClock(behind);
+        neighbor.writeDatagram(pull.toDatagram(), QHostAddress::LocalHost, 47041);
+
+        Message pulled;
+        timer.restart();
+        while (pulled.getOrigin().isEmpty() && timer.elapsed() < 5000) {
+            while (neighbor.hasPendingDatagrams()) {
+                QByteArray datagram;
+                datagram.resize(neighbor.pendingDatagramSize());
+                neighbor.readDatagram(datagram.data(), datagram.size());
+                Message reply = Message::fromDatagram(datagram);
+                if (reply.getType() == Message::ROUTE_RUMOR && reply.getOrigin() == "Node47041") {
+                    pulled = reply;
+                }
+            }
+            QTest::qWait(20);
+        }
+        QVERIFY(pulled.getSequenceNumber() >= 2);
+        qDebug() << "  ✓ Pull answered with the responder's own route";
+    }
+
+    // Test 28: Broadcast Tree Pruning
+    void testBroadcastTreePrune() {
+        qDebug() << "\n[Test 28] Broadcast Tree Prune";
+        NetworkManager nm;
+        nm.setNodeId("Node47051");
+        QVERIFY(nm.startServer(47051));
+        QSignalSpy delivered(&nm, &NetworkManager::messageReceived);
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47052));
+
+        Message chat("hello tree", "Node47052", "broadcast", 1, Message::CHAT_MESSAGE);
+        chat.setMessageId(chat.generateMessageId());
+        neighbor.writeDatagram(chat.toDatagram(), QHostAddress::LocalHost, 47051);
+        QTRY_COMPARE(delivered.count(), 1);
+        QCOMPARE(nm.getGossipStats().broadcastDuplicates, (quint64)0);
+
+        // A second copy over the same link makes it redundant
+        neighbor.writeDatagram(chat.toDatagram(), QHostAddress::LocalHost, 47051);
+        QTRY_COMPARE(nm.getGossipStats().broadcastDuplicates, (quint64)1);
+        QCOMPARE(nm.getGossipStats().prunes, (quint64)1);
+
+        bool gotPrune = false;
+        QElapsedTimer timer;
+        timer.start();
+        while (!gotPrune && timer.elapsed() < 5000) {
+            while (neighbor.hasPendingDatagrams()) {
+                QByteArray datagram;
+                datagram.resize(neighbor.pendingDatagramSize());
+                neighbor.readDatagram(datagram.data(), datagram.size());
+                if (Message::fromDatagram(datagram).getType() == Message::GOSSIP_PRUNE) {
+                    gotPrune = true;
+                }
+            }
+            QTest::qWait(20);
+        }
+        QVERIFY(gotPrune);
+
+        // Further duplicates do not re-prune the link
+        neighbor.writeDatagram(chat.toDatagram(), QHostAddress::LocalHost, 47051);
+        QTRY_COMPARE(nm.getGossipStats().broadcastDuplicates, (quint64)2);
+        QCOMPARE(nm.getGossipStats().prunes, (quint64)1);
+        QCOMPARE(delivered.count(), 1);
+        qDebug() << "  ✓ Duplicate broadcast pruned the link once";
+
+        // Repair copies (catch-up, GRAFT and NACK replies) neither prune nor get pushed on
+        QUdpSocket repairer;
+        QVERIFY(repairer.bind(QHostAddress::LocalHost, 47053));
+        Message resent = chat;
+        resent.setRepair(true);
+        repairer.writeDatagram(resent.toDatagram(), QHostAddress::LocalHost, 47051);
+        QTRY_COMPARE(nm.getGossipStats().broadcastDuplicates, (quint64)3);
+        QCOMPARE(nm.getGossipStats().prunes, (quint64)1);
+
+        Message missed("missed it", "Node47052", "broadcast", 2, Message::CHAT_MESSAGE);
+        missed.setMessageId(missed.generateMessageId());
+        missed.setRepair(true);
+        repairer.writeDatagram(missed.toDatagram(), QHostAddress::LocalHost, 47051);
+        QTRY_COMPARE(delivered.count(), 2);
+        QTest::qWait(300);
+        QCOMPARE(nm.getGossipStats().ihavesSent, (quint64)0);
+        QCOMPARE(nm.getStoreStats().liveMessages, 2);
+        qDebug() << "  ✓ Repair copies delivered without reshaping the tree";
+    }
+
+    // Test 29: Digest Anti-Entropy
+    void testAntiEntropyDigest() {
+        qDebug() << "\n[Test 29] Digest Anti-Entropy";
+        QCOMPARE(Message::hashMessageId("Node1_1"), Message::hashMessageId("Node1_1"));
+        QVERIFY(Message::hashMessageId("Node1_1") != Message::hashMessageId("Node1_2"));
+
+        NetworkManager nm;
+        nm.setNodeId("Node47061");
+        QVERIFY(nm.startServer(47061));
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47062));
+
+        Message chat("digest me", "Node47062", "broadcast", 1, Message::CHAT_MESSAGE);
+        chat.setMessageId(chat.generateMessageId());
+        neighbor.writeDatagram(chat.toDatagram(), QHostAddress::LocalHost, 47061);
+        QString expected = QString::number(Message::hashMessageId(chat.getMessageId()), 16);
+
+        // Drains the neighbour socket and reports whether a detailed digest arrived
+        auto waitForDetail = [&neighbor](int timeoutMs, QVariantMap* detail) {
+            QElapsedTimer timer;
+            timer.start();
+            while (timer.elapsed() < timeoutMs) {
+                while (neighbor.hasPendingDatagrams()) {
+                    QByteArray datagram;
+                    datagram.resize(neighbor.pendingDatagramSize());
+                    neighbor.readDatagram(datagram.data(), datagram.size());
+                    Message reply = Message::fromDatagram(datagram);
+                    if (reply.getType() == Message::ANTI_ENTROPY_DIGEST && !reply.getDigests().isEmpty()) {
+                        *detail = reply.getDigests();
+                        return true;
+                    }
+                }
+                QTest::qWait(20);
+            }
+            return false;
+        };
+
+        // Matching summary: no reply
+        QTest::qWait(200);
+        Message same("", "Node47062", "Node47061", 0, Message::ANTI_ENTROPY_DIGEST);
+        same.setStoreDigest(expected);
+        neighbor.writeDatagram(same.toDatagram(), QHostAddress::LocalHost, 47061);
+        QVariantMap detail;
+        QVERIFY(!waitForDetail(500, &detail));
+
+        // Mismatching summary: per-origin detail comes back
+        Message differ("", "Node47062", "Node47061", 0, Message::ANTI_ENTROPY_DIGEST);
+        differ.setStoreDigest("0");
+        neighbor.writeDatagram(differ.toDatagram(), QHostAddress::LocalHost, 47061);
+        QVERIFY(waitForDetail(5000, &detail));
+        QCOMPARE(detail.value("Node47062").toString(), expected);
+        qDebug() << "  ✓ Matching digests stay silent, mismatches descend per origin";
+    }
+
+    // Test 30: IBLT Set Reconciliation
+    void testIbltReconciliation() {
+        qDebug() << "\n[Test 30] IBLT Set Reconciliation";
+        Iblt local(48);
+        Iblt remote(48);
+        QCOMPARE(local.cellCount(), 48);
+
+        // 200 shared keys, 3 only here, 2 only there
+        for (int i = 0; i < 200; ++i) {
+            quint64 key = Message::hashMessageId(QString("Shared_%1").arg(i));
+            local.insert(key);
+            remote.insert(key);
+        }
+        QList<quint64> expectedLocal;
+        for (int i = 0; i < 3; ++i) {
+            expectedLocal.append(Message::hashMessageId(QString("Local_%1").arg(i)));
+            local.insert(expectedLocal.last());
+        }
+        QList<quint64> expectedRemote;
+        for (int i = 0; i < 2; ++i) {
+            expectedRemote.append(Message::hashMessageId(QString("Remote_%1").arg(i)));
+            remote.insert(expectedRemote.last());
+        }
+
+        bool ok = false;
+        Iblt received = Iblt::fromByteArray(remote.toByteArray(), remote.cellCount(), &ok);
+        QVERIFY(ok);
+        local.subtract(received);
+
+        QList<quint64> localOnly;
+        QList<quint64> remoteOnly;
+        QVERIFY(local.decode(&localOnly, &remoteOnly));
+        std::sort(localOnly.begin(), localOnly.end());
+        std::sort(remoteOnly.begin(), remoteOnly.end());
+        std::sort(expectedLocal.begin(), expectedLocal.end());
+        std::sort(expectedRemote.begin(), expectedRemote.end());
+        QCOMPARE(localOnly, expectedLocal);
+        QCOMPARE(remoteOnly, expectedRemote);
+
+        // A difference far larger than the table cannot be decoded
+        Iblt crowded(6);
+        for (int i = 0; i < 50; ++i) {
+            crowded.insert(Message::hashMessageId(QString("Extra_%1").arg(i)));
+        }
+        localOnly.clear();
+        remoteOnly.clear();
+        QVERIFY(!crowded.decode(&localOnly, &remoteOnly));
+
+        // Sizes off the wire are checked against the payload before anything is allocated
+        Iblt::fromByteArray(remote.toByteArray(), 1000000000, &ok);
+        QVERIFY(!ok);
+        Iblt::fromByteArray(remote.toByteArray(), 0, &ok);
+        QVERIFY(!ok);
+        Iblt::fromByteArray(remote.toByteArray().left(100), remote.cellCount(), &ok);
+        QVERIFY(!ok);
+        qDebug() << "  ✓ Decoded exactly the keys each side lacks";
+    }
+
+    // Test 31: Adaptive Anti-Entropy Interval
+    void testAdaptiveAntiEntropy() {
+        qDebug() << "\n[Test 31] Adaptive Anti-Entropy Interval";
+        NetworkManager nm;
+        nm.setNodeId("Node47071");
+        QCOMPARE(nm.getAntiEntropyInterval(), 2000);
+        QVERIFY(nm.startServer(47071));
+
+        // Idle rounds back off
+        QTRY_VERIFY_WITH_TIMEOUT(nm.getAntiEntropyInterval() > 2000, 5000);
+
+        // A newly heard neighbour brings the period back down
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47072));
+        Message hello("", "Node47072", "Node47071", 0, Message::ANTI_ENTROPY_DIGEST);
+        neighbor.writeDatagram(hello.toDatagram(), QHostAddress::LocalHost, 47071);
+        QTRY_VERIFY(nm.getAntiEntropyInterval() < 2000);
+        qDebug() << "  ✓ Interval backs off when idle and resets for new peers";
+    }
+
+    // Test 32: Paced Catch-Up
+    void testPacedCatchUp() {
+        qDebug() << "\n[Test 32] Paced Catch-Up";
+        NetworkManager nm;
+        nm.setNodeId("Node47081");
+        QCOMPARE(nm.getCatchUpByteRate(), 256 * 1024);
+        nm.setCatchUpByteRate(2000);
+        QVERIFY(nm.startServer(47081));
+        QSignalSpy delivered(&nm, &NetworkManager::messageReceived);
+
+        QUdpSocket author;
+        QVERIFY(author.bind(QHostAddress::LocalHost, 47082));
+        for (int seq = 1; seq <= 20; ++seq) {
+            Message chat(QString("backlog %1").arg(seq), "Node47082", "broadcast", seq, Message::CHAT_MESSAGE);
+            chat.setMessageId(chat.generateMessageId());
+            author.writeDatagram(chat.toDatagram(), QHostAddress::LocalHost, 47081);
+        }
+        QTRY_COMPARE(delivered.count(), 20);
+
+        // A returning node asks for everything
+        QUdpSocket laggard;
+        QVERIFY(laggard.bind(QHostAddress::LocalHost, 47083));
+        Message request("", "Node47083", "Node47081", 0, Message::ANTI_ENTROPY_REQUEST);
+        laggard.writeDatagram(request.toDatagram(), QHostAddress::LocalHost, 47081);
+
+        QSet<QString> received;
+        int copies = 0;
+        bool resent = false;
+        QElapsedTimer timer;
+        timer.start();
+        while (received.size() < 20 && timer.elapsed() < 15000) {
+            while (laggard.hasPendingDatagrams()) {
+                QByteArray datagram;
+                datagram.resize(laggard.pendingDatagramSize());
+                laggard.readDatagram(datagram.data(), datagram.size());
+                Message msg = Message::fromDatagram(datagram);
+                if (msg.getType() == Message::CHAT_MESSAGE) {
+                    received.insert(msg.getMessageId());
+                    copies++;
+                }
+            }
+
+            // Paced: nowhere near the whole backlog in the first half second
+            if (timer.elapsed() > 500 && !resent) {
+                QVERIFY(received.size() < 20);
+
+                // Repeating the request mid-stream resumes instead of restarting
+                laggard.writeDatagram(request.toDatagram(), QHostAddress::LocalHost, 47081);
+                resent = true;
+            }
+            QTest::qWait(20);
+        }
+        QCOMPARE(received.size(), 20);
+        QCOMPARE(copies, 20);
+        qDebug() << "  ✓ Backlog streamed at the configured rate without restarts";
+    }
+
+    // Test 33: NACK Gap Repair
+    void testGapNack() {
+        qDebug() << "\n[Test 33] NACK Gap Repair";
+        NetworkManager nm;
+        nm.setNodeId("Node47091");
+        QVERIFY(nm.startServer(47091));
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47092));
+
+        // Sequence 2 was a private message to someone else: no gap. Broadcast 4 is lost on the way.
+        QList<QPair<int, int>> broadcasts = {{1, 0}, {3, 1}, {5, 4}};
+        for (const QPair<int, int>& sent : broadcasts) {
+            Message chat(QString("seq %1").arg(sent.first), "Node47092", "broadcast", sent.first, Message::CHAT_MESSAGE);
+            chat.setMessageId(chat.generateMessageId());
+            chat.setPreviousBroadcast(sent.second);
+            neighbor.writeDatagram(chat.toDatagram(), QHostAddress::LocalHost, 47091);
+            QTest::qWait(50);
+        }
+
+        QVariantMap range;
+        QElapsedTimer timer;
+        timer.start();
+        while (range.isEmpty() && timer.elapsed() < 5000) {
+            while (neighbor.hasPendingDatagrams()) {
+                QByteArray datagram;
+                datagram.resize(neighbor.pendingDatagramSize());
+                neighbor.readDatagram(datagram.data(), datagram.size());
+                Message reply = Message::fromDatagram(datagram);
+                if (reply.getType() == Message::GAP_NACK && !reply.getRanges().isEmpty()) {
+                    range = reply.getRanges().first().toMap();
+                }
+            }
+            QTest::qWait(20);
+        }
+        QCOMPARE(range.value("Origin").toString(), QString("Node47092"));
+        QCOMPARE(range.value("From").toInt(), 4);
+        QCOMPARE(range.value("To").toInt(), 4);
+        QVERIFY(nm.getGossipStats().nacksSent >= 1);
+
+        // Another node NACKing sequence 3 gets it back immediately
+        QUdpSocket requester;
+        QVERIFY(requester.bind(QHostAddress::LocalHost, 47093));
+        Message nack("", "Node47093", "Node47092", 0, Message::GAP_NACK);
+        QVariantMap wanted;
+        wanted["Origin"] = "Node47092";
+        wanted["From"] = 3;
+        wanted["To"] = 3;
+        nack.setRanges(QVariantList() << wanted);
+        requester.writeDatagram(nack.toDatagram(), QHostAddress::LocalHost, 47091);
+        QTRY_COMPARE(nm.getGossipStats().nackRetransmits, (quint64)1);
+        qDebug() << "  ✓ Gap detected, NACKed and answered";
+    }
+
+    // Test 34: Store Retention
+    void testStoreRetention() {
+        qDebug() << "\n[Test 34] Store Retention";
+        NetworkManager nm;
+        nm.setNodeId("Node47101");
+        RetentionPolicy policy;
+        policy.maxMessagesPerOrigin = 5;
+        nm.setRetentionPolicy(policy);
+        QCOMPARE(nm.getRetentionPolicy().maxMessagesPerOrigin, 5);
+        QVERIFY(nm.startServer(47101));
+        QSignalSpy delivered(&nm, &NetworkManager::messageReceived);
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47102));
+        for (int seq = 1; seq <= 8; ++seq) {
+            Message chat(QString("keep %1").arg(seq), "Node47102", "broadcast", seq, Message::CHAT_MESSAGE);
+            chat.setMessageId(chat.generateMessageId());
+            neighbor.writeDatagram(chat.toDatagram(), QHostAddress::LocalHost, 47101);
+        }
+        QTRY_COMPARE(delivered.count(), 8);
+
+        StoreStats stats = nm.getStoreStats();
+        QCOMPARE(stats.liveMessages, 5);
+        QCOMPARE(stats.reclaimedMessages, (quint64)3);
+        QVERIFY(stats.liveBytes > 0);
+        QVERIFY(stats.reclaimedBytes > 0);
+        QCOMPARE(nm.getLowWaterMark("Node47102"), 3);
+
+        // An evicted message is still recognised as seen
+        Message old("keep 2", "Node47102", "broadcast", 2, Message::CHAT_MESSAGE);
+        old.setMessageId(old.generateMessageId());
+        neighbor.writeDatagram(old.toDatagram(), QHostAddress::LocalHost, 47101);
+        QTRY_COMPARE(nm.getGossipStats().broadcastDuplicates, (quint64)1);
+        QCOMPARE(delivered.count(), 8);
+        QCOMPARE(nm.getStoreStats().liveMessages, 5);
+        qDebug() << "  ✓ Store bounded per origin; evicted prefix kept as low water mark";
+    }
+
+    // Test 35: Transit Cache For Relayed Messages
+    void testTransitCache() {
+        qDebug() << "\n[Test 35] Transit Cache";
+        NetworkManager nm;
+        nm.setNodeId("Node47111");
+        QVERIFY(nm.startServer(47111));
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47112));
+
+        Message relay("pass through", "Node47112", "Node47119", 1, Message::CHAT_MESSAGE);
+        relay.setMessageId(relay.generateMessageId());
+        neighbor.writeDatagram(relay.toDatagram(), QHostAddress::LocalHost, 47111);
+        QTRY_COMPARE(nm.getGossipStats().transitForwarded, (quint64)1);
+        QCOMPARE(nm.getTransitCacheSize(), 1);
+        QCOMPARE(nm.getStoreStats().liveMessages, 0);
+
+        // The origin's retry (same hop limit) is relayed again
+        neighbor.writeDatagram(relay.toDatagram(), QHostAddress::LocalHost, 47111);
+        QTRY_COMPARE(nm.getGossipStats().transitForwarded, (quint64)2);
+
+        // A looped copy (lower hop limit) is suppressed
+        Message looped = relay;
+        looped.setHopLimit(relay.getHopLimit() - 3);
+        neighbor.writeDatagram(looped.toDatagram(), QHostAddress::LocalHost, 47111);
+        QTRY_COMPARE(nm.getGossipStats().transitDuplicates, (quint64)1);
+        QCOMPARE(nm.getGossipStats().transitForwarded, (quint64)2);
+        QCOMPARE(nm.getStoreStats().liveMessages, 0);
+        qDebug() << "  ✓ Relayed messages tracked by ID only";
+    }
+
+    // Test 36: Persistent Message Log
+    void testPersistentMessageLog() {
+        qDebug() << "\n[Test 36] Persistent Message Log";
+        QTemporaryDir dataDir;
+        QVERIFY(dataDir.isValid());
+
+        {
+            NetworkManager nm;
+            nm.setNodeId("Node47121");
+            QVERIFY(nm.enablePersistence(dataDir.path(), MessageLog::SYNC_ALWAYS));
+            QVERIFY(nm.isPersistent());
+            QVERIFY(nm.startServer(47121));
+            QSignalSpy delivered(&nm, &NetworkManager::messageReceived);
+
+            QUdpSocket neighbor;
+            QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47122));
+            for (int seq = 1; seq <= 3; ++seq) {
+                Message chat(QString("durable %1").arg(seq), "Node47122", "broadcast", seq, Message::CHAT_MESSAGE);
+                chat.setMessageId(chat.generateMessageId());
+                neighbor.writeDatagram(chat.toDatagram(), QHostAddress::LocalHost, 47121);
+            }
+            QTRY_COMPARE(delivered.count(), 3);
+            nm.sendMessage(Message("mine", "Node47121", "broadcast", 1));
+        }
+
+        // Simulate a torn write at the tail of the last segment
+        QStringList segments = QDir(dataDir.path()).entryList(QStringList() << "segment-*.log", QDir::Files, QDir::Name);
+        QVERIFY(!segments.isEmpty());
+        QFile tail(QDir(dataDir.path()).filePath(segments.last()));
+        QVERIFY(tail.open(QIODevice::Append));
+        tail.write("SCLGtorn-record");
+        tail.close();
+
+        NetworkManager restarted;
+        restarted.setNodeId("Node47121");
+        QVERIFY(restarted.enablePersistence(dataDir.path()));
+        QCOMPARE(restarted.getStoreStats().liveMessages, 4);
+        QCOMPARE(restarted.getVectorClock().value("Node47122").toInt(), 3);
+        QCOMPARE(restarted.getVectorClock().value("Node47121").toInt(), 1);
+
+        // Records are framed with a standard CRC-32
+        QCOMPARE(MessageLog::crc32("123456789", 9), 0xCBF43926u);
+
+        // A fully reclaimed segment stays on disk until the owner has saved its snapshot
+        QTemporaryDir logDir;
+        MessageLog log(MessageLog::SYNC_NONE, 16);
+        QVERIFY(log.open(logDir.path(), [](const MessageLog::Entry&, const char*, int) { return true; }));
+        QVERIFY(log.append("Node47123_1", "Node47123", 1, QByteArray(32, 'a')));
+        QVERIFY(log.append("Node47123_2", "Node47123", 2, QByteArray(32, 'b')));
+        QCOMPARE(log.segmentCount(), 2);
+        QVERIFY(log.markRemoved("Node47123_1"));
+        QCOMPARE(log.segmentCount(), 2);
+        log.dropReclaimedSegments();
+        QCOMPARE(log.segmentCount(), 1);
+        QVERIFY(!log.markRemoved("Node47123_2"));  // The active segment is kept
+        qDebug() << "  ✓ Store and clock restored from disk, torn tail discarded";
+    }
+
+    // Test 37: Warm-Start Peers And Routes
+    void testWarmStartTopology() {
+        qDebug() << "\n[Test 37] Warm-Start Peers And Routes";
+        QTemporaryDir dataDir;
+        QVERIFY(dataDir.isValid());
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47132));
+
+        // The neighbour advertises itself and a node behind it
+        Message advertisement("", "Node47132", "Node47131", 2, Message::ROUTE_ADVERTISEMENT);
+        QVariantMap self;
+        self["Dest"] = "Node47132";
+        self["SeqNo"] = 2;
+        self["Hops"] = 0;
+        QVariantMap behind;
+        behind["Dest"] = "Node47199";
+        behind["SeqNo"] = 4;
+        behind["Hops"] = 1;
+        advertisement.setRouteEntries(QVariantList() << self << behind);
+
+        {
+            NetworkManager nm;
+            nm.setNodeId("Node47131");
+            QVERIFY(nm.enablePersistence(dataDir.path()));
+            QVERIFY(nm.startServer(47131));
+            neighbor.writeDatagram(advertisement.toDatagram(), QHostAddress::LocalHost, 47131);
+            QTRY_VERIFY(nm.getRoutingTable().contains("Node47199"));
+        }
+        QVERIFY(QFile::exists(QDir(dataDir.path()).filePath("topology.dat")));
+
+        // Before any traffic the restart already knows where to send
+        NetworkManager restarted;
+        restarted.setNodeId("Node47131");
+        QVERIFY(restarted.enablePersistence(dataDir.path()));
+        QVERIFY(restarted.getPeers().value("Node47132").provisional);
+        RouteInfo route = restarted.getRoutingTable().value("Node47199");
+        QVERIFY(route.provisional);
+        QCOMPARE(route.nextHop, QString("Node47132"));
+        QCOMPARE(route.hopCount, 2);
+
+        // Restored peers are probed at once; live traffic confirms them and their routes
+        QVERIFY(restarted.startServer(47131));
+        bool probed = false;
+        QElapsedTimer timer;
+        timer.start();
+        while (!probed && timer.elapsed() < 2000) {
+            while (neighbor.hasPendingDatagrams()) {
+                QByteArray datagram;
+                datagram.resize(neighbor.pendingDatagramSize());
+                neighbor.readDatagram(datagram.data(), datagram.size());
+                probed = probed || Message::fromDatagram(datagram).getType() == Message::LINK_PROBE;
+            }
+            QTest::qWait(20);
+        }
+        QVERIFY(probed);
+
+        neighbor.writeDatagram(advertisement.toDatagram(), QHostAddress::LocalHost, 47131);
+        QTRY_VERIFY(!restarted.getPeers().value("Node47132").provisional);
+        QTRY_VERIFY(!restarted.getRoutingTable().value("Node47199").provisional);
+        qDebug() << "  ✓ Peers and routes restored provisionally, then confirmed by live traffic";
+    }
+
+    // Test 38: Headless Daemon Configuration
+    void testHeadlessDaemon() {
+        qDebug() << "\n[Test 38] Headless Daemon Configuration";
+        NodeConfig config = NodeConfig::fromArguments(QStringList() << "SimpleChat_PA3" << "--headless"
+                                                      << "-p" << "47141" << "--noforward"
+                                                      << "--fsync" << "always" << "--log-file" << "relay.log");
+        QVERIFY(config.headless);
+        QCOMPARE(config.port, 47141);
+        QCOMPARE(config.nodeId(), QString("Node47141"));
+        QCOMPARE(config.logFile, QString("relay.log"));
+        QCOMPARE(config.syncPolicy, MessageLog::SYNC_ALWAYS);
+        QVERIFY(config.discoveryPorts().isEmpty());  // Rendezvous waits for connections
+        QCOMPARE(NodeConfig::nodeIdForPort(9002), QString("Node2"));
+
+        // The daemon runs the full node without any widgets
+        ChatDaemon daemon(config);
+        QVERIFY(daemon.start());
+        QCOMPARE(daemon.getNetworkManager()->getNodeId(), QString("Node47141"));
+        QVERIFY(daemon.getNetworkManager()->isNoForwardMode());
+        qDebug() << "  ✓ Options parsed and node started under QCoreApplication";
+    }
+
+    // Test 39: Control Socket API
+    void testControlSocket() {
+        qDebug() << "\n[Test 39] Control Socket API";
+        NetworkManager nm;
+        nm.setNodeId("Node47151");
+        QVERIFY(nm.startServer(47151));
+
+        QTemporaryDir socketDir;
+        QVERIFY(socketDir.isValid());
+        ControlServer control(&nm);
+        QVERIFY(control.listen(QDir(socketDir.path()).filePath("control.sock")));
+
+        QLocalSocket client;
+        client.connectToServer(control.serverName());
+        QVERIFY(client.waitForConnected(1000));
+
+        // Four pipelined requests in one write, answered in order
+        client.write("{\"id\":1,\"cmd\":\"subscribe\"}\n"
+                     "{\"id\":2,\"cmd\":\"send\",\"dest\":\"broadcast\",\"text\":\"scripted\"}\n"
+                     "{\"id\":3,\"cmd\":\"stats\"}\n"
+                     "{\"id\":4,\"cmd\":\"bogus\"}\n");
+        QList<QJsonObject> lines;
+        QElapsedTimer timer;
+        timer.start();
+        while (lines.size() < 4 && timer.elapsed() < 2000) {
+            QTest::qWait(10);
+            while (client.canReadLine()) {
+                lines.append(QJsonDocument::fromJson(client.readLine()).object());
+            }
+        }
+        QCOMPARE(lines.size(), 4);
+        for (int i = 0; i < 4; ++i) {
+            QCOMPARE(lines[i].value("id").toInt(), i + 1);
+        }
+        QVERIFY(lines[1].value("ok").toBool());
+        QVERIFY(!lines[1].value("messageId").toString().isEmpty());
+        QCOMPARE(lines[2].value("vectorClock").toObject().value("Node47151").toInt(), 1);
+        QVERIFY(!lines[3].value("ok").toBool());
+
+        // Subscribed clients see deliveries as they happen
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47152));
+        Message chat("pushed", "Node47152", "broadcast", 1, Message::CHAT_MESSAGE);
+        chat.setMessageId(chat.generateMessageId());
+        neighbor.writeDatagram(chat.toDatagram(), QHostAddress::LocalHost, 47151);
+
+        QJsonObject event;
+        timer.restart();
+        while (event.isEmpty() && timer.elapsed() < 2000) {
+            QTest::qWait(10);
+            while (client.canReadLine()) {
+                QJsonObject line = QJsonDocument::fromJson(client.readLine()).object();
+                if (line.value("event").toString() == "delivered") {
+                    event = line;
+                }
+            }
+        }
+        QCOMPARE(event.value("origin").toString(), QString("Node47152"));
+        QCOMPARE(event.value("text").toString(), QString("pushed"));
+        qDebug() << "  ✓ Pipelined requests answered in order, deliveries streamed";
+    }
+
+    // Test 40: Load Generator Delivery Accounting
+    void testDeliveryStats() {
+        qDebug() << "\n[Test 40] Load Generator Delivery Accounting";
+        DeliveryStats stats;
+        const qint64 ms = 1000000;
+
+        // 100 private messages with latencies 1..100 ms, one of them lost
+        for (int i = 1; i <= 100; ++i) {
+            QString id = QString("p%1").arg(i);
+            stats.recordSend(id, false, 1, 0);
+            if (i != 50) {
+                stats.recordDelivery(id, "NodeB", i * ms);
+            }
+        }
+
+        // A broadcast to three receivers, one of whom hears it twice
+        stats.recordSend("b1", true, 3, 0);
+        stats.recordDelivery("b1", "NodeB", 5 * ms);
+        stats.recordDelivery("b1", "NodeC", 6 * ms);
+        stats.recordDelivery("b1", "NodeC", 7 * ms);
+        stats.recordDelivery("b1", "NodeD", 8 * ms);
+        stats.recordDelivery("unknown", "NodeB", 1 * ms);  // Traffic we did not send is ignored
+
+        DeliveryStats::Summary summary = stats.summarize();
+        QCOMPARE(summary.sent, (quint64)101);
+        QCOMPARE(summary.expected, (quint64)103);
+        QCOMPARE(summary.delivered, (quint64)102);
+        QCOMPARE(summary.dropped, (quint64)1);
+        QCOMPARE(summary.duplicates, (quint64)1);
+        QCOMPARE(summary.maxMs, 100.0);
+        QVERIFY(summary.p50Ms >= 45.0 && summary.p50Ms <= 55.0);
+        QCOMPARE(summary.p99Ms, 99.0);
+        QCOMPARE(DeliveryStats::percentile(QVector<qint64>() << 1 << 2 << 3 << 4, 0.5), (qint64)2);
+        qDebug() << "  ✓ Drops, duplicates and latency percentiles accounted";
+    }
+
+    // Test 41: Mesh Harness Topologies
+    void testMeshTopology() {
+        qDebug() << "\n[Test 41] Mesh Harness Topologies";
+        MeshTopology::Adjacency line = MeshTopology::build("line", 5, 0, 1);
+        QCOMPARE(MeshTopology::linkCount(line), 4);
+        QCOMPARE(line[0], QVector<int>() << 1);
+        QCOMPARE(line[2], QVector<int>() << 1 << 3);
+
+        MeshTopology::Adjacency ring = MeshTopology::build("ring", 5, 0, 1);
+        QCOMPARE(MeshTopology::linkCount(ring), 5);
+        QCOMPARE(ring[0], QVector<int>() << 1 << 4);
+
+        // 10 nodes on a 4-column grid; the partial last row still hangs off the row above
+        MeshTopology::Adjacency grid = MeshTopology::build("grid", 10, 0, 1);
+        QCOMPARE(grid[5], QVector<int>() << 1 << 4 << 6 << 9);
+        QCOMPARE(grid[9], QVector<int>() << 5 << 8);
+        QVERIFY(MeshTopology::isConnected(grid));
+
+        // Random graphs are connected, symmetric, near the mean degree and reproducible by seed
+        MeshTopology::Adjacency random = MeshTopology::build("random", 200, 4, 7);
+        QVERIFY(MeshTopology::isConnected(random));
+        QCOMPARE(MeshTopology::linkCount(random), 400);
+        for (int node = 0; node < random.size(); ++node) {
+            for (int neighbour : random[node]) {
+                QVERIFY(neighbour != node);
+                QVERIFY(random[neighbour].contains(node));
+            }
+        }
+        QCOMPARE(MeshTopology::build("random", 200, 4, 7), random);
+        QVERIFY(!MeshTopology::isKnownKind("star"));
+        qDebug() << "  ✓ Line, ring, grid and seeded random meshes are connected and symmetric";
+    }
+
+    // Test 42: Packet Capture and Replay
+    void testPacketCaptureReplay() {
+        qDebug() << "\n[Test 42] Packet Capture and Replay";
+        QTemporaryDir captureDir;
+        QVERIFY(captureDir.isValid());
+        QString capturePath = QDir(captureDir.path()).filePath("node.pcap");
+
+        NetworkManager nm;
+        nm.setNodeId("Node47161");
+        QVERIFY(nm.startServer(47161));
+        QVERIFY(nm.enableCapture(capturePath));
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47162));
+        QList<QByteArray> sent;
+        for (int seq = 1; seq <= 2; ++seq) {
+            Message chat(QString("captured %1").arg(seq), "Node47162", "broadcast", seq, Message::CHAT_MESSAGE);
+            chat.setMessageId(chat.generateMessageId());
+            sent.append(chat.toDatagram());
+            neighbor.writeDatagram(sent.last(), QHostAddress::LocalHost, 47161);
+        }
+        QTRY_COMPARE(nm.getVectorClock().value("Node47162").toInt(), 2);
+        nm.disableCapture();
+
+        // A standard nanosecond pcap of raw IP packets
+        QFile file(capturePath);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.read(4), QByteArray("\x4d\x3c\xb2\xa1", 4));
+        file.close();
+
+        PacketCaptureReader reader;
+        QVERIFY(reader.open(capturePath));
+        QList<PacketCapture::Record> records;
+        PacketCapture::Record record;
+        while (reader.next(&record)) {
+            records.append(record);
+        }
+        QCOMPARE(records.size(), 2);
+        QCOMPARE(records[0].datagram, sent[0]);
+        QCOMPARE(records[1].datagram, sent[1]);
+        QCOMPARE(records[0].senderPort, (quint16)47162);
+        QCOMPARE(records[0].receiverPort, (quint16)47161);
+        QCOMPARE(records[0].senderHost, QHostAddress(QHostAddress::LocalHost));
+        QVERIFY(records[1].timestampNs >= records[0].timestampNs);
+
+        // The synthesized IPv4 header carries a valid checksum
+        QByteArray packet = PacketCapture::encapsulate(sent[0], QHostAddress::LocalHost, 47162, QHostAddress::LocalHost, 47161);
+        quint32 sum = 0;
+        for (int i = 0; i < 20; i += 2) {
+            sum += (static_cast<quint8>(packet[i]) << 8) | static_cast<quint8>(packet[i + 1]);
+        }
+        while (sum >> 16) {
+            sum = (sum & 0xffff) + (sum >> 16);
+        }
+        QCOMPARE(sum, (quint32)0xffff);
+
+        // Replayed offline, the same datagrams rebuild the same state without touching the network
+        NetworkManager replay;
+        replay.setNodeId("Node47161");
+        replay.setTransmitEnabled(false);
+        for (const PacketCapture::Record& captured : records) {
+            replay.injectDatagram(captured.datagram, captured.senderHost, captured.senderPort);
+        }
+        QCOMPARE(replay.getVectorClock().value("Node47162").toInt(), 2);
+        QCOMPARE(replay.getStoreStats().liveMessages, nm.getStoreStats().liveMessages);
+        qDebug() << "  ✓ Received datagrams captured as pcap and replayed into identical state";
+    }
+
+    // Test 43: Metrics Export
+    void testMetricsExport() {
+        qDebug() << "\n[Test 43] Metrics Export";
+
+        // Buckets are stored per bucket and exported cumulatively, with +Inf last
+        Histogram histogram(QVector<double>() << 1.0 << 10.0);
+        histogram.observe(0.5);
+        histogram.observe(1.0);
+        histogram.observe(5.0);
+        histogram.observe(50.0);
+        QCOMPARE(histogram.bucketCounts(), QVector<quint64>() << 2 << 1 << 1);
+        QCOMPARE(histogram.count(), (quint64)4);
+        PrometheusWriter writer;
+        writer.histogram("test_value", "Test values", histogram);
+        QByteArray text = writer.text();
+        QVERIFY(text.contains("# TYPE test_value histogram\n"));
+        QVERIFY(text.contains("test_value_bucket{le=\"1\"} 2\n"));
+        QVERIFY(text.contains("test_value_bucket{le=\"10\"} 3\n"));
+        QVERIFY(text.contains("test_value_bucket{le=\"+Inf\"} 4\n"));
+        QVERIFY(text.contains("test_value_sum 56.5\n"));
+        QCOMPARE(PrometheusWriter::label("peer", "a\"b"), QString("peer=\"a\\\"b\""));
+
+        // Received datagrams are counted by type; garbage as a decode failure
+        NetworkManager nm;
+        nm.setNodeId("Node47171");
+        nm.setTransmitEnabled(false);
+        Message chat("metered", "Node47172", "broadcast", 1, Message::CHAT_MESSAGE);
+        chat.setMessageId(chat.generateMessageId());
+        QByteArray datagram = chat.toDatagram();
+        nm.injectDatagram(datagram, QHostAddress::LocalHost, 47172);
+        nm.injectDatagram("not json", QHostAddress::LocalHost, 47172);
+        QCOMPARE(nm.getMetrics().packetsIn[Message::CHAT_MESSAGE], (quint64)1);
+        QCOMPARE(nm.getMetrics().bytesIn[Message::CHAT_MESSAGE], (quint64)datagram.size());
+        QCOMPARE(nm.getMetrics().decodeFailures, (quint64)1);
+        QCOMPARE(nm.getMetrics().datagramBytes.count(), (quint64)2);
+
+        // A message waiting for route discovery is parked, not dropped
+        nm.sendMessage(Message("later", "Node47171", "Node47179", 1));
+        QCOMPARE(nm.getMetrics().parkedNoRoute, (quint64)1);
+        QCOMPARE(nm.getMetrics().dropsNoRoute, (quint64)0);
+
+        // Scraped over HTTP from the loopback endpoint
+        MetricsServer metricsServer(&nm);
+        QVERIFY(metricsServer.listen(47171));
+        QTcpSocket client;
+        client.connectToHost(QHostAddress::LocalHost, 47171);
+        QVERIFY(client.waitForConnected(1000));
+        client.write("GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        QByteArray response;
+        QTRY_VERIFY((response += client.readAll()).contains("simplechat_decode_failures_total 1\n"));
+        QVERIFY(response.startsWith("HTTP/1.1 200 OK\r\n"));
+        QVERIFY(response.contains("simplechat_packets_received_total{type=\"CHAT_MESSAGE\"} 1\n"));
+
+        // And dumped to a file
+        QTemporaryDir dumpDir;
+        QVERIFY(dumpDir.isValid());
+        QString dumpPath = QDir(dumpDir.path()).filePath("metrics.prom");
+        QVERIFY(metricsServer.writeFile(dumpPath));
+        QFile dump(dumpPath);
+        QVERIFY(dump.open(QIODevice::ReadOnly));
+        QVERIFY(dump.readAll().contains("# TYPE simplechat_link_rtt_seconds histogram"));
+        qDebug() << "  ✓ Per-type counters and histograms exported over HTTP and to a file";
+    }
+
+    // Test 44: Binary Event Trace
+    void testEventTrace() {
+        qDebug() << "\n[Test 44] Binary Event Trace";
+
+        // Disabled, nothing is kept; enabled, the ring keeps the newest events, oldest first
+        EventTrace trace;
+        trace.record(EventTrace::FORWARD, "Node3", "Node2", 1, 9);
+        QVERIFY(trace.snapshot().events.isEmpty());
+        trace.enable("Node1", 3);  // Rounded up to 4
+        for (quint32 seq = 1; seq <= 6; ++seq) {
+            trace.record(EventTrace::FORWARD, "Node3", seq % 2 ? "Node2" : "Node4", seq, 9);
+        }
+        EventTrace::Snapshot snapshot = trace.snapshot();
+        QCOMPARE(snapshot.events.size(), 4);
+        QCOMPARE(snapshot.overwritten, (quint64)2);
+        QCOMPARE(snapshot.events.first().sequence, (quint32)3);
+        QCOMPARE(snapshot.events.last().sequence, (quint32)6);
+        QVERIFY(snapshot.events.last().timestampNs >= snapshot.events.first().timestampNs);
+        QCOMPARE(snapshot.nodes, QStringList() << "Node3" << "Node2" << "Node4");
+
+        // Saved and loaded back unchanged
+        QTemporaryDir traceDir;
+        QVERIFY(traceDir.isValid());
+        QString tracePath = QDir(traceDir.path()).filePath("node1.trace");
+        QVERIFY(trace.save(tracePath));
+        EventTrace::Snapshot loaded;
+        QVERIFY(EventTrace::load(tracePath, &loaded));
+        QCOMPARE(loaded.ownerId, QString("Node1"));
+        QCOMPARE(loaded.events.size(), 4);
+        QCOMPARE(loaded.events[1].sequence, snapshot.events[1].sequence);
+        QCOMPARE(loaded.nodes.value(loaded.events[1].peer), QString("Node2"));
+        QCOMPARE(QString(EventTrace::eventName(loaded.events[1].event)), QString("FORWARD"));
+
+        // A node records its receive and routing events instead of formatting log lines
+        NetworkManager nm;
+        nm.setNodeId("Node47181");
+        nm.setTransmitEnabled(false);
+        nm.enableTrace();
+        Message rumor("", "Node47182", "broadcast", 5, Message::ROUTE_RUMOR);
+        nm.injectDatagram(rumor.toDatagram(), QHostAddress::LocalHost, 47182);
+        QStringList names;
+        for (const TraceEvent& event : nm.getTrace().snapshot().events) {
+            names.append(EventTrace::eventName(event.event));
+        }
+        QVERIFY(names.contains("RECEIVE"));
+        QVERIFY(names.contains("RUMOR_RECEIVED"));
+        QVERIFY(names.contains("ROUTE_CHANGED"));
+        qDebug() << "  ✓ Packet events recorded in a fixed ring and saved in binary form";
+    }
+
+    // Test 45: Delivery Latency Tracing
+    void testDeliveryTracing() {
+        qDebug() << "\n[Test 45] Delivery Latency Tracing";
+
+        // Line: origin (47191) -> relay (47192) -> destination socket (47193)
+        NetworkManager origin;
+        origin.setNodeId("Node47191");
+        QVERIFY(origin.startServer(47191));
+        origin.setDeliveryTraceRate(1.0);
+        NetworkManager relay;
+        relay.setNodeId("Node47192");
+        QVERIFY(relay.startServer(47192));
+        QUdpSocket destination;
+        QVERIFY(destination.bind(QHostAddress::LocalHost, 47193));
+
+        // The relay learns the destination directly; the origin learns it via the relay
+        Message destinationRumor("", "Node47193", "broadcast", 1, Message::ROUTE_RUMOR);
+        destination.writeDatagram(destinationRumor.toDatagram(), QHostAddress::LocalHost, 47192);
+        QTRY_VERIFY(relay.getRoutingTable().contains("Node47193"));
+        Message relayRumor("", "Node47192", "broadcast", 1, Message::ROUTE_RUMOR);
+        origin.injectDatagram(relayRumor.toDatagram(), QHostAddress::LocalHost, 47192);
+        Message relayedRumor = destinationRumor;
+        relayedRumor.setHopLimit(Message::DEFAULT_HOP_LIMIT - 1);
+        origin.injectDatagram(relayedRumor.toDatagram(), QHostAddress::LocalHost, 47192);
+        QCOMPARE(origin.getRoutingTable().value("Node47193").nextHop, QString("Node47192"));
+
+        origin.sendMessage(Message("traced", "Node47191", "Node47193", 1));
+        Message forwarded;
+        auto receiveChat = [&destination, &forwarded]() {
+            while (destination.hasPendingDatagrams()) {
+                QByteArray datagram(static_cast<int>(destination.pendingDatagramSize()), 0);
+                destination.readDatagram(datagram.data(), datagram.size());
+                Message message = Message::fromDatagram(datagram);
+                if (message.getType() == Message::CHAT_MESSAGE) {
+                    forwarded = message;
+                }
+            }
+            return forwarded.getChatText() == "traced";
+        };
+        QTRY_VERIFY(receiveChat());
+
+        // The relay appended its arrival and departure times
+        QVariantList hops = forwarded.getDeliveryTrace().value("Hops").toList();
+        QCOMPARE(hops.size(), 1);
+        QVariantList relayHop = hops.first().toList();
+        QCOMPARE(relayHop.value(0).toString(), QString("Node47192"));
+        qint64 sentUs = forwarded.getDeliveryTrace().value("Sent").toLongLong();
+        QVERIFY(sentUs > 0);
+        QVERIFY(relayHop.value(1).toLongLong() >= sentUs);
+        QVERIFY(relayHop.value(2).toLongLong() >= relayHop.value(1).toLongLong());
+
+        // The destination turns the header into histograms and an exportable path
+        NetworkManager receiver;
+        receiver.setNodeId("Node47193");
+        receiver.setTransmitEnabled(false);
+        receiver.injectDatagram(forwarded.toDatagram(), QHostAddress::LocalHost, 47192);
+        QCOMPARE(receiver.getDeliveryTraces().size(), 1);
+        DeliveryTrace trace = receiver.getDeliveryTraces().first();
+        QCOMPARE(trace.origin, QString("Node47191"));
+        QCOMPARE(trace.hops.size(), 1);
+        QCOMPARE(trace.hops.first().nodeId, QString("Node47192"));
+        QVERIFY(trace.deliveredUs >= trace.hops.first().departureUs);
+        QCOMPARE(receiver.getMetrics().deliveryLatencySeconds.count(), (quint64)1);
+        QCOMPARE(receiver.getMetrics().hopQueueSeconds.count(), (quint64)1);
+
+        // The header is not kept with the stored message
+        receiver.injectDatagram(forwarded.toDatagram(), QHostAddress::LocalHost, 47192);
+        QCOMPARE(receiver.getDeliveryTraces().size(), 1);
+
+        // A relay that parks a traced message during route discovery charges the wait to itself
+        Message parked("parked", "Node47191", "Node47194", 2);
+        QVariantMap header;
+        header["Sent"] = QDateTime::currentMSecsSinceEpoch() * 1000;
+        parked.setDeliveryTrace(header);
+        relay.injectDatagram(parked.toDatagram(), QHostAddress::LocalHost, 47191);
+        QTest::qWait(50);
+        QUdpSocket late;
+        QVERIFY(late.bind(QHostAddress::LocalHost, 47194));
+        Message lateRumor("", "Node47194", "broadcast", 1, Message::ROUTE_RUMOR);
+        late.writeDatagram(lateRumor.toDatagram(), QHostAddress::LocalHost, 47192);
+        Message flushed;
+        auto receiveParked = [&late, &flushed]() {
+            while (late.hasPendingDatagrams()) {
+                QByteArray datagram(static_cast<int>(late.pendingDatagramSize()), 0);
+                late.readDatagram(datagram.data(), datagram.size());
+                Message message = Message::fromDatagram(datagram);
+                if (message.getType() == Message::CHAT_MESSAGE) {
+                    flushed = message;
+                }
+            }
+            return flushed.getChatText() == "parked";
+        };
+        QTRY_VERIFY(receiveParked());
+        QVariantList parkedHops = flushed.getDeliveryTrace().value("Hops").toList();
+        QCOMPARE(parkedHops.size(), 1);
+        QVariantList parkedHop = parkedHops.first().toList();
+        QCOMPARE(parkedHop.value(0).toString(), QString("Node47192"));
+        QVERIFY(parkedHop.value(2).toLongLong() - parkedHop.value(1).toLongLong() >= 40000);
+        qDebug() << "  ✓ Per-hop timestamps recorded by relays and measured at the destination";
+    }
+
+    // Test 46: Private Messages Stay Out Of Anti-Entropy
+    void testPrivateAntiEntropy() {
+        qDebug() << "\n[Test 46] Private Messages Stay Out Of Anti-Entropy";
+        NetworkManager alice;
+        alice.setNodeId("Node47201");
+        NetworkManager bob;
+        bob.setNodeId("Node47202");
+        NetworkManager carol;
+        carol.setNodeId("Node47203");
+        QVERIFY(alice.startServer(47201));
+        QVERIFY(bob.startServer(47202));
+        QVERIFY(carol.startServer(47203));
+        QSignalSpy bobReceived(&bob, &NetworkManager::messageReceived);
+        QSignalSpy carolReceived(&carol, &NetworkManager::messageReceived);
+
+        // Alice is a neighbour of both; Bob and Carol only know Alice
+        alice.addPeer("Node47202", "127.0.0.1", 47202);
+        alice.addPeer("Node47203", "127.0.0.1", 47203);
+        bob.addPeer("Node47201", "127.0.0.1", 47201);
+        carol.addPeer("Node47201", "127.0.0.1", 47201);
+
+        alice.sendMessage(Message("just for bob", "Node47201", "Node47202", 1));
+        QTRY_COMPARE(bobReceived.count(), 1);
+
+        // Every pair agrees once both endpoints hold it, so all three back off
+        QTRY_VERIFY_WITH_TIMEOUT(alice.getAntiEntropyInterval() > 2000 && bob.getAntiEntropyInterval() > 2000 &&
+                                 carol.getAntiEntropyInterval() > 2000, 20000);
+        QCOMPARE(carolReceived.count(), 0);
+        QCOMPARE(carol.getStoreStats().liveMessages, 0);
+        QCOMPARE(carol.getGossipStats().transitForwarded, (quint64)0);
+        QCOMPARE(alice.getGossipStats().catchUpMessagesSent, (quint64)0);
+        qDebug() << "  ✓ Endpoints converge on their conversation without replaying it to others";
+    }
+
+    // Test 47: Anti-Entropy Across Different Retention Settings
+    void testAntiEntropyRetentionMismatch() {
+        qDebug() << "\n[Test 47] Anti-Entropy Across Different Retention Settings";
+        NetworkManager nm;
+        nm.setNodeId("Node47211");
+        RetentionPolicy policy;
+        policy.maxMessagesPerOrigin = 3;
+        nm.setRetentionPolicy(policy);
+        QVERIFY(nm.startServer(47211));
+        QSignalSpy delivered(&nm, &NetworkManager::messageReceived);
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47212));
+        auto digestOf = [](int from, int to) {
+            quint64 digest = 0;
+            for (int seq = from; seq <= to; ++seq) {
+                digest ^= Message::hashMessageId(QString("Node47212_%1").arg(seq));
+            }
+            return QString::number(digest, 16);
+        };
+        for (int seq = 1; seq <= 6; ++seq) {
+            Message chat(QString("history %1").arg(seq), "Node47212", "broadcast", seq, Message::CHAT_MESSAGE);
+            chat.setMessageId(chat.generateMessageId());
+            neighbor.writeDatagram(chat.toDatagram(), QHostAddress::LocalHost, 47211);
+        }
+        QTRY_COMPARE(delivered.count(), 6);
+        QCOMPARE(nm.getLowWaterMark("Node47212"), 3);
+
+        // Reports whether anything beyond a summary digest came back
+        auto waitForReply = [&neighbor](int timeoutMs) {
+            QElapsedTimer timer;
+            timer.start();
+            while (timer.elapsed() < timeoutMs) {
+                while (neighbor.hasPendingDatagrams()) {
+                    QByteArray datagram;
+                    datagram.resize(neighbor.pendingDatagramSize());
+                    neighbor.readDatagram(datagram.data(), datagram.size());
+                    Message reply = Message::fromDatagram(datagram);
+                    if (reply.getType() == Message::ANTI_ENTROPY_IBLT ||
+                        (reply.getType() == Message::ANTI_ENTROPY_DIGEST && !reply.getDigests().isEmpty())) {
+                        return true;
+                    }
+                }
+                QTest::qWait(20);
+            }
+            return false;
+        };
+
+        // The neighbour compacted further (mark 5): summaries agree above it
+        QVariantMap higherMark;
+        higherMark["Node47212"] = 5;
+        Message summary("", "Node47212", "Node47211", 0, Message::ANTI_ENTROPY_DIGEST);
+        summary.setStoreDigest(digestOf(6, 6));
+        summary.setLowWaterMarks(higherMark);
+        neighbor.writeDatagram(summary.toDatagram(), QHostAddress::LocalHost, 47211);
+        QVERIFY(!waitForReply(500));
+
+        // The neighbour keeps everything (mark 0) and answers with detail above our mark 3: no reconciliation
+        Message detail("", "Node47212", "Node47211", 0, Message::ANTI_ENTROPY_DIGEST);
+        QVariantMap digests;
+        digests["Node47212"] = digestOf(4, 6);
+        detail.setDigests(digests);
+        neighbor.writeDatagram(detail.toDatagram(), QHostAddress::LocalHost, 47211);
+        QVERIFY(!waitForReply(500));
+        QCOMPARE(nm.getGossipStats().digestMismatches, (quint64)0);
+
+        // A real difference is still found
+        Message differ("", "Node47212", "Node47211", 0, Message::ANTI_ENTROPY_DIGEST);
+        differ.setStoreDigest("0");
+        neighbor.writeDatagram(differ.toDatagram(), QHostAddress::LocalHost, 47211);
+        QVERIFY(waitForReply(5000));
+        QCOMPARE(nm.getGossipStats().digestMismatches, (quint64)1);
+        qDebug() << "  ✓ Digests compared above the higher low water mark stay quiet";
+    }
+
+    // Test 48: Compaction Stops At Holes
+    void testCompactionKeepsHoles() {
+        qDebug() << "\n[Test 48] Compaction Stops At Holes";
+        NetworkManager nm;
+        nm.setNodeId("Node47221");
+        QVERIFY(nm.startServer(47221));
+        QSignalSpy delivered(&nm, &NetworkManager::messageReceived);
+
+        QUdpSocket neighbor;
+        QVERIFY(neighbor.bind(QHostAddress::LocalHost, 47222));
+
+        // Sequence 2 is a private message to us that is still on its way; 3 overtakes it
+        QList<QPair<int, int>> broadcasts = {{1, 0}, {3, 1}};
+        for (const QPair<int, int>& sent : broadcasts) {
+            Message chat(QString("seq %1").arg(sent.first), "Node47222", "broadcast", sent.first, Message::CHAT_MESSAGE);
+            chat.setMessageId(chat.generateMessageId());
+            chat.setPreviousBroadcast(sent.second);
+            neighbor.writeDatagram(chat.toDatagram(), QHostAddress::LocalHost, 47221);
+        }
+        QTRY_COMPARE(delivered.count(), 2);
+
+        // The only neighbour reports having seen up to 3
+        QVariantMap clock;
+        clock["Node47222"] = 3;
+        Message request("", "Node47222", "Node47221", 0, Message::ANTI_ENTROPY_REQUEST);
+        request.setVectorClock(clock);
+        neighbor.writeDatagram(request.toDatagram(), QHostAddress::LocalHost, 47221);
+        QTest::qWait(200);
+
+        QVERIFY(QMetaObject::invokeMethod(&nm, "compactStore", Qt::DirectConnection));
+        QCOMPARE(nm.getLowWaterMark("Node47222"), 1);
+
+        // The late private message is still delivered and acknowledged
+        Message late("finally", "Node47222", "Node47221", 2, Message::CHAT_MESSAGE);
+        late.setMessageId(late.generateMessageId());
+        neighbor.writeDatagram(late.toDatagram(), QHostAddress::LocalHost, 47221);
+        QTRY_COMPARE(delivered.count(), 3);
+
+        bool acked = false;
+        QElapsedTimer timer;
+        timer.start();
+        while (!acked && timer.elapsed() < 5000) {
+            while (neighbor.hasPendingDatagrams()) {
+                QByteArray datagram;
+                datagram.resize(neighbor.pendingDatagramSize());
+                neighbor.readDatagram(datagram.data(), datagram.size());
+                Message reply = Message::fromDatagram(datagram);
+                if (reply.getType() == Message::ACK && reply.getMessageId() == late.getMessageId()) {
+                    acked = true;
+                }
+            }
+            QTest::qWait(20);
+        }
+        QVERIFY(acked);
+
+        // With the hole filled the prefix can move up
+        QVERIFY(QMetaObject::invokeMethod(&nm, "compactStore", Qt::DirectConnection));
+        QCOMPARE(nm.getLowWaterMark("Node47222"), 3);
+        qDebug() << "  ✓ Low water mark never covers a sequence number we lack";
+    }
+
     void cleanupTestCase() {
         qDebug() << "\n=================================================";
         qDebug() << "PA3 Tests Completed Successfully";
-        qDebug() << "Total: 20 tests (10 Message + 10 Routing)";
+        qDebug() << "Total: 48 tests (10 Message + 10 Routing + 28 Advertisement)";
         qDebug() << "=================================================";
     }
 };
@@ -0,0 +1,105 @@
+#include "deliverystats.h"
+#include <algorithm>
+#include <cmath>
+
+DeliveryStats::DeliveryStats()
+    : privateSent(0), broadcastSent(0), expected(0), duplicates(0), firstSendNs(-1), lastDeliveryNs(-1) {}
+
+void DeliveryStats::recordSend(const QString& messageId, bool broadcast, int expectedDeliveries, qint64 sentAtNs) {
+    if (messageId.isEmpty()) {
+        return;
+    }
+
+    Pending pending;
+    pending.sentAtNs = sentAtNs;
+    inFlight.insert(messageId, pending);
+
+    if (broadcast) {
+        broadcastSent++;
+    } else {
+        privateSent++;
+    }
+    expected += static_cast<quint64>(expectedDeliveries);
+    if (firstSendNs < 0) {
+        firstSendNs = sentAtNs;
+    }
+}
+
+void DeliveryStats::recordDelivery(const QString& messageId, const QString& receiver, qint64 deliveredAtNs) {
+    auto it = inFlight.find(messageId);
+    if (it == inFlight.end()) {
+        return;  // Not ours (e.g. warm-up traffic)
+    }
+
+    if (it->receivers.contains(receiver)) {
+        duplicates++;
+        return;
+    }
+
+    it->receivers.insert(receiver);
+    latenciesNs.append(deliveredAtNs - it->sentAtNs);
+    lastDeliveryNs = qMax(lastDeliveryNs, deliveredAtNs);
+}
+
+qint64 DeliveryStats::percentile(const QVector<qint64>& sorted, double q) {
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+
+    int rank = static_cast<int>(std::ceil(q * sorted.size()));
+    return sorted[qBound(0, rank - 1, static_cast<int>(sorted.size()) - 1)];
+}
+
+DeliveryStats::Summary DeliveryStats::summarize() const {
+    Summary summary;
+    summary.privateSent = privateSent;
+    summary.broadcastSent = broadcastSent;
+    summary.sent = privateSent + broadcastSent;
+    summary.expected = expected;
+    summary.delivered = static_cast<quint64>(latenciesNs.size());
+    summary.duplicates = duplicates;
+    summary.dropped = expected > summary.delivered ? expected - summary.delivered : 0;
+
+    if (latenciesNs.isEmpty()) {
+        return summary;
+    }
+
+    QVector<qint64> sorted = latenciesNs;
+    std::sort(sorted.begin(), sorted.end());
+
+    double total = 0.0;
+    for (qint64 latency : sorted) {
+        total += static_cast<double>(latency);
+    }
+
+    const double nsPerMs = 1e6;
+    summary.meanMs = total / sorted.size() / nsPerMs;
+    summary.p50Ms = percentile(sorted, 0.50) / nsPerMs;
+    summary.p99Ms = percentile(sorted, 0.99) / nsPerMs;
+    summary.p999Ms = percentile(sorted, 0.999) / nsPerMs;
+    summary.maxMs = sorted.last() / nsPerMs;
+
+    double windowSeconds = (lastDeliveryNs - firstSendNs) / 1e9;
+    if (windowSeconds > 0.0) {
+        summary.throughput = summary.delivered / windowSeconds;
+    }
+    return summary;
+}
+
+QJsonObject DeliveryStats::Summary::toJson() const {
+    QJsonObject json;
+    json["sent"] = static_cast<double>(sent);
+    json["privateSent"] = static_cast<double>(privateSent);
+    json["broadcastSent"] = static_cast<double>(broadcastSent);
+    json["expectedDeliveries"] = static_cast<double>(expected);
+    json["delivered"] = static_cast<double>(delivered);
+    json["duplicates"] = static_cast<double>(duplicates);
+    json["dropped"] = static_cast<double>(dropped);
+    json["throughputPerSec"] = throughput;
+    json["latencyMeanMs"] = meanMs;
+    json["latencyP50Ms"] = p50Ms;
+    json["latencyP99Ms"] = p99Ms;
+    json["latencyP999Ms"] = p999Ms;
+    json["latencyMaxMs"] = maxMs;
+    return json;
+}
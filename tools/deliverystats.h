@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QString>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QJsonObject>
+
+// Send-to-delivery bookkeeping for the load generator.
+// Every send registers how many deliveries it should produce (1 for a
+// private message, every other node for a broadcast); deliveries are
+// matched by message ID and receiver so duplicates are counted, not timed.
+class DeliveryStats {
+public:
+    struct Summary {
+        quint64 sent;
+        quint64 privateSent;
+        quint64 broadcastSent;
+        quint64 expected;  // Deliveries the sends should have produced
+        quint64 delivered;  // Unique (message, receiver) deliveries
+        quint64 duplicates;
+        quint64 dropped;  // expected - delivered
+        double throughput;  // Deliveries per second over the measured window
+        double meanMs;
+        double p50Ms;
+        double p99Ms;
+        double p999Ms;
+        double maxMs;
+
+        Summary() : sent(0), privateSent(0), broadcastSent(0), expected(0), delivered(0), duplicates(0),
+                    dropped(0), throughput(0.0), meanMs(0.0), p50Ms(0.0), p99Ms(0.0), p999Ms(0.0), maxMs(0.0) {}
+
+        QJsonObject toJson() const;
+    };
+
+    DeliveryStats();
+
+    void recordSend(const QString& messageId, bool broadcast, int expectedDeliveries, qint64 sentAtNs);
+    void recordDelivery(const QString& messageId, const QString& receiver, qint64 deliveredAtNs);
+
+    Summary summarize() const;
+
+    // Nearest-rank percentile of an ascending sample (q in 0..1)
+    static qint64 percentile(const QVector<qint64>& sorted, double q);
+
+private:
+    struct Pending {
+        qint64 sentAtNs;
+        QSet<QString> receivers;
+    };
+
+    QHash<QString, Pending> inFlight;  // messageId -> send time and who has it
+    QVector<qint64> latenciesNs;
+    quint64 privateSent;
+    quint64 broadcastSent;
+    quint64 expected;
+    quint64 duplicates;
+    qint64 firstSendNs;
+    qint64 lastDeliveryNs;
+};
@@ -0,0 +1,361 @@
+// simplechat_loadgen: drives a local mesh of embedded NetworkManager nodes
+// with an open-loop workload and reports throughput, latency percentiles,
+// retransmits and drops.
+//
+//   ./build/tools/simplechat_loadgen --nodes 5 --topology line --duration 20 \
+//       --private-rate 200 --broadcast-rate 10 --payload uniform:64-1024 --zipf 1.1
+//
+// All nodes live in one process, so send and delivery times come from the
+// same monotonic clock.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "networkmanager.h"
+#include "deliverystats.h"
+
+namespace {
+
+bool verboseLogging = false;
+
+void filterLog(QtMsgType type, const QMessageLogContext&, const QString& text) {
+    // Per-message [SEND]/[FORWARD] lines would dominate the run
+    if (type == QtDebugMsg && !verboseLogging) {
+        return;
+    }
+    std::fprintf(stderr, "%s\n", qPrintable(text));
+}
+
+// Payload size distribution: fixed:N, uniform:MIN-MAX or pareto:MIN (alpha 1.5, heavy tail)
+struct PayloadSpec {
+    enum Kind { FIXED, UNIFORM, PARETO };
+    Kind kind;
+    int minSize;
+    int maxSize;
+
+    static const int MAX_PAYLOAD = 8000;  // Keeps a message in one UDP datagram
+
+    PayloadSpec() : kind(UNIFORM), minSize(64), maxSize(512) {}
+
+    bool parse(const QString& spec) {
+        QStringList parts = spec.split(':');
+        if (parts.size() != 2) {
+            return false;
+        }
+
+        bool ok = false;
+        if (parts[0] == "fixed") {
+            kind = FIXED;
+            minSize = maxSize = parts[1].toInt(&ok);
+        } else if (parts[0] == "uniform") {
+            QStringList bounds = parts[1].split('-');
+            bool okMax = false;
+            kind = UNIFORM;
+            minSize = bounds.value(0).toInt(&ok);
+            maxSize = bounds.value(1).toInt(&okMax);
+            ok = ok && okMax && bounds.size() == 2 && minSize <= maxSize;
+        } else if (parts[0] == "pareto") {
+            kind = PARETO;
+            minSize = parts[1].toInt(&ok);
+            maxSize = MAX_PAYLOAD;
+        }
+        ok = ok && minSize >= 1 && maxSize <= MAX_PAYLOAD;
+        return ok;
+    }
+
+    int sample() const {
+        QRandomGenerator* random = QRandomGenerator::global();
+        switch (kind) {
+            case FIXED:
+                return minSize;
+            case UNIFORM:
+                return minSize + static_cast<int>(random->bounded(maxSize - minSize + 1));
+            case PARETO: {
+                double u = 1.0 - random->generateDouble();  // (0, 1]
+                double size = minSize / std::pow(u, 1.0 / 1.5);
+                return static_cast<int>(qMin(size, static_cast<double>(maxSize)));
+            }
+        }
+        return minSize;
+    }
+};
+
+class LoadGenerator {
+public:
+    struct Options {
+        int nodeCount;
+        int basePort;
+        QString topology;
+        double durationSec;
+        double warmupSec;
+        double drainSec;
+        double privateRate;
+        double broadcastRate;
+        double zipfExponent;
+        PayloadSpec payload;
+        bool json;
+    };
+
+    explicit LoadGenerator(const Options& opts) : options(opts), privateCredit(0.0), broadcastCredit(0.0) {}
+
+    ~LoadGenerator() {
+        qDeleteAll(nodes);
+    }
+
+    bool start() {
+        for (int i = 0; i < options.nodeCount; ++i) {
+            NetworkManager* node = new NetworkManager();
+            QString nodeId = QString("Node%1").arg(options.basePort + i);
+            node->setNodeId(nodeId);
+            node->setPacketLogging(verboseLogging);
+            if (!node->startServer(options.basePort + i)) {
+                delete node;
+                return false;
+            }
+
+            QObject::connect(node, &NetworkManager::messageReceived, [this, nodeId](const Message& message) {
+                stats.recordDelivery(message.getMessageId(), nodeId, clock.nsecsElapsed());
+            });
+            nodes.append(node);
+            nodeIds.append(nodeId);
+        }
+
+        // Neighbour links
+        for (int i = 0; i < nodes.size(); ++i) {
+            for (int j = 0; j < nodes.size(); ++j) {
+                if (i != j && isLinked(i, j)) {
+                    nodes[i]->addPeer(nodeIds[j], "127.0.0.1", options.basePort + j);
+                }
+            }
+        }
+
+        buildDestinationCdf();
+        clock.start();
+        return true;
+    }
+
+    void run() {
+        // Let routes converge (or give up waiting after the warm-up period)
+        QElapsedTimer warmup;
+        warmup.start();
+        while (!routesConverged() && warmup.elapsed() < options.warmupSec * 1000) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        }
+
+        const int tickMs = 2;
+        QElapsedTimer phase;
+        phase.start();
+        qint64 lastTickNs = phase.nsecsElapsed();
+        while (phase.elapsed() < options.durationSec * 1000) {
+            qint64 nowNs = phase.nsecsElapsed();
+            double dt = (nowNs - lastTickNs) / 1e9;
+            lastTickNs = nowNs;
+
+            // Open loop: sends are due on the clock, whether or not earlier ones were delivered
+            privateCredit += options.privateRate * dt;
+            broadcastCredit += options.broadcastRate * dt;
+            while (privateCredit >= 1.0) {
+                sendOne(false);
+                privateCredit -= 1.0;
+            }
+            while (broadcastCredit >= 1.0) {
+                sendOne(true);
+                broadcastCredit -= 1.0;
+            }
+
+            QCoreApplication::processEvents(QEventLoop::AllEvents, tickMs);
+        }
+
+        // Let retransmits and anti-entropy finish what they can
+        QElapsedTimer drain;
+        drain.start();
+        while (drain.elapsed() < options.drainSec * 1000) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        }
+    }
+
+    void report() const {
+        DeliveryStats::Summary summary = stats.summarize();
+
+        quint64 ackRetransmits = 0;
+        quint64 ackFailures = 0;
+        quint64 nackRetransmits = 0;
+        quint64 transitDuplicates = 0;
+        for (const NetworkManager* node : nodes) {
+            GossipStats gossip = node->getGossipStats();
+            ackRetransmits += gossip.ackRetransmits;
+            ackFailures += gossip.ackFailures;
+            nackRetransmits += gossip.nackRetransmits;
+            transitDuplicates += gossip.transitDuplicates;
+        }
+
+        QTextStream out(stdout);
+        if (options.json) {
+            QJsonObject json = summary.toJson();
+            json["nodes"] = options.nodeCount;
+            json["topology"] = options.topology;
+            json["durationSec"] = options.durationSec;
+            json["privateRate"] = options.privateRate;
+            json["broadcastRate"] = options.broadcastRate;
+            json["zipf"] = options.zipfExponent;
+            json["ackRetransmits"] = static_cast<double>(ackRetransmits);
+            json["ackFailures"] = static_cast<double>(ackFailures);
+            json["nackRetransmits"] = static_cast<double>(nackRetransmits);
+            json["transitDuplicates"] = static_cast<double>(transitDuplicates);
+            out << QJsonDocument(json).toJson(QJsonDocument::Indented);
+            return;
+        }
+
+        out << "=== SimpleChat load test ===\n";
+        out << QString("Nodes:        %1 (%2), %3 s, offered %4 private/s + %5 broadcast/s, zipf %6\n")
+                   .arg(options.nodeCount).arg(options.topology).arg(options.durationSec)
+                   .arg(options.privateRate).arg(options.broadcastRate).arg(options.zipfExponent, 0, 'f', 2);
+        out << QString("Sent:         %1 (%2 private, %3 broadcast)\n")
+                   .arg(summary.sent).arg(summary.privateSent).arg(summary.broadcastSent);
+        out << QString("Deliveries:   %1 / %2 expected (%3 dropped, %4 duplicates)\n")
+                   .arg(summary.delivered).arg(summary.expected).arg(summary.dropped).arg(summary.duplicates);
+        out << QString("Throughput:   %1 deliveries/s\n").arg(summary.throughput, 0, 'f', 1);
+        out << QString("Latency (ms): mean %1  p50 %2  p99 %3  p999 %4  max %5\n")
+                   .arg(summary.meanMs, 0, 'f', 2).arg(summary.p50Ms, 0, 'f', 2).arg(summary.p99Ms, 0, 'f', 2)
+                   .arg(summary.p999Ms, 0, 'f', 2).arg(summary.maxMs, 0, 'f', 2);
+        out << QString("Retransmits:  %1 ACK timeout, %2 NACK repair; %3 ACK failures, %4 transit duplicates\n")
+                   .arg(ackRetransmits).arg(nackRetransmits).arg(ackFailures).arg(transitDuplicates);
+    }
+
+private:
+    bool isLinked(int a, int b) const {
+        if (options.topology == "full") {
+            return true;
+        }
+        int distance = qAbs(a - b);
+        if (options.topology == "ring") {
+            return distance == 1 || distance == static_cast<int>(nodes.size()) - 1;
+        }
+        return distance == 1;  // line
+    }
+
+    bool routesConverged() const {
+        for (const NetworkManager* node : nodes) {
+            QMap<QString, RouteInfo> table = node->getRoutingTable();
+            for (const QString& nodeId : nodeIds) {
+                if (nodeId != node->getNodeId() &&
+                    (!table.contains(nodeId) || !table.value(nodeId).isReachable())) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Zipf over destination rank: weight 1 / rank^s (s = 0 is uniform)
+    void buildDestinationCdf() {
+        double total = 0.0;
+        for (int rank = 1; rank < nodes.size(); ++rank) {
+            total += 1.0 / std::pow(rank, options.zipfExponent);
+            destinationCdf.append(total);
+        }
+        for (double& value : destinationCdf) {
+            value /= total;
+        }
+    }
+
+    int pickDestination(int sender) const {
+        double u = QRandomGenerator::global()->generateDouble();
+        int rank = static_cast<int>(std::lower_bound(destinationCdf.begin(), destinationCdf.end(), u) -
+                                    destinationCdf.begin());
+        rank = qMin(rank, static_cast<int>(destinationCdf.size()) - 1);
+
+        // The same popular nodes for every sender, skipping the sender itself
+        return rank >= sender ? rank + 1 : rank;
+    }
+
+    void sendOne(bool broadcast) {
+        int nodeCount = static_cast<int>(nodes.size());
+        int sender = QRandomGenerator::global()->bounded(nodeCount);
+        QString destination = broadcast ? QString("broadcast") : nodeIds[pickDestination(sender)];
+        QString text(options.payload.sample(), QChar('x'));
+
+        qint64 sentAt = clock.nsecsElapsed();
+        QString messageId = nodes[sender]->sendMessage(Message(text, nodeIds[sender], destination, 1));
+        stats.recordSend(messageId, broadcast, broadcast ? nodeCount - 1 : 1, sentAt);
+    }
+
+    Options options;
+    QList<NetworkManager*> nodes;
+    QStringList nodeIds;
+    QVector<double> destinationCdf;
+    DeliveryStats stats;
+    QElapsedTimer clock;
+    double privateCredit;
+    double broadcastCredit;
+};
+
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("simplechat_loadgen");
+    QCoreApplication::setApplicationVersion("3.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Synthetic load generator for a local SimpleChat mesh");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption nodesOption("nodes", "Number of nodes in the mesh", "n", "4");
+    QCommandLineOption basePortOption("base-port", "First UDP port; nodes use consecutive ports", "port", "47600");
+    QCommandLineOption topologyOption("topology", "line, ring or full", "shape", "line");
+    QCommandLineOption durationOption("duration", "Seconds of load", "sec", "10");
+    QCommandLineOption warmupOption("warmup", "Max seconds to wait for route convergence", "sec", "10");
+    QCommandLineOption drainOption("drain", "Seconds to wait for stragglers after the load stops", "sec", "3");
+    QCommandLineOption privateRateOption("private-rate", "Private messages per second", "rate", "50");
+    QCommandLineOption broadcastRateOption("broadcast-rate", "Broadcasts per second", "rate", "5");
+    QCommandLineOption payloadOption("payload", "Payload size: fixed:N, uniform:MIN-MAX or pareto:MIN",
+                                     "spec", "uniform:64-512");
+    QCommandLineOption zipfOption("zipf", "Destination skew exponent (0 = uniform)", "s", "0");
+    QCommandLineOption jsonOption("json", "Print the report as JSON");
+    QCommandLineOption verboseOption("verbose", "Keep the nodes' debug logging");
+    parser.addOptions({nodesOption, basePortOption, topologyOption, durationOption, warmupOption, drainOption,
+                       privateRateOption, broadcastRateOption, payloadOption, zipfOption, jsonOption, verboseOption});
+    parser.process(app);
+
+    LoadGenerator::Options options;
+    options.nodeCount = qMax(2, parser.value(nodesOption).toInt());
+    options.basePort = parser.value(basePortOption).toInt();
+    options.topology = parser.value(topologyOption);
+    options.durationSec = parser.value(durationOption).toDouble();
+    options.warmupSec = parser.value(warmupOption).toDouble();
+    options.drainSec = parser.value(drainOption).toDouble();
+    options.privateRate = qMax(0.0, parser.value(privateRateOption).toDouble());
+    options.broadcastRate = qMax(0.0, parser.value(broadcastRateOption).toDouble());
+    options.zipfExponent = qMax(0.0, parser.value(zipfOption).toDouble());
+    options.json = parser.isSet(jsonOption);
+
+    if (options.topology != "line" && options.topology != "ring" && options.topology != "full") {
+        std::fprintf(stderr, "Unknown topology '%s'\n", qPrintable(options.topology));
+        return 2;
+    }
+    if (!options.payload.parse(parser.value(payloadOption))) {
+        std::fprintf(stderr, "Bad payload spec '%s'\n", qPrintable(parser.value(payloadOption)));
+        return 2;
+    }
+
+    verboseLogging = parser.isSet(verboseOption);
+    qInstallMessageHandler(filterLog);
+
+    LoadGenerator generator(options);
+    if (!generator.start()) {
+        std::fprintf(stderr, "Could not bind ports %d-%d\n", options.basePort, options.basePort + options.nodeCount - 1);
+        return 1;
+    }
+    generator.run();
+    generator.report();
+    return 0;
+}
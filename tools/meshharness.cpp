@@ -0,0 +1,634 @@
+// simplechat_meshharness: launches N headless SimpleChat processes on
+// loopback in a chosen topology, waits for routing convergence by polling
+// every node's control socket, runs a traffic phase, then kills and
+// restarts nodes to time reconvergence.
+//
+//   ./build/tools/simplechat_meshharness --nodes 200 --topology random --degree 4 \
+//       --duration 30 --rate 100 --restarts 3 --json
+//
+// Unlike simplechat_loadgen, every node is a separate process with its own
+// UDP socket, so the results include scheduling and kernel costs.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QDebug>
+#include <cstdio>
+#include <functional>
+#include "deliverystats.h"
+#include "meshtopology.h"
+
+namespace {
+
+typedef std::function<void(const QJsonObject&)> ReplyHandler;
+
+// One headless node: its process, its control connection and the last observations
+struct MeshNode {
+    int index;
+    int port;
+    QString nodeId;
+    QString socketPath;
+    QProcess* process;
+    QLocalSocket* control;
+    QByteArray buffer;
+    QHash<int, ReplyHandler> pending;  // Request id -> reply handler
+    int restarts;
+    QSet<QString> reachable;  // Destinations from the last dump-routes
+    QJsonObject traffic;  // Datagram counters from the last stats
+    qint64 rssKb;
+    qint64 peakRssKb;
+
+    MeshNode() : index(0), port(0), process(nullptr), control(nullptr), restarts(0), rssKb(-1), peakRssKb(-1) {}
+
+    bool isConnected() const { return control && control->state() == QLocalSocket::ConnectedState; }
+};
+
+// A field such as VmRSS from /proc/<pid>/status, in kB (-1 where /proc is unavailable)
+qint64 readProcStatusKb(qint64 pid, const QByteArray& field) {
+    QFile status(QString("/proc/%1/status").arg(pid));
+    if (pid <= 0 || !status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return -1;
+    }
+
+    QByteArray prefix = field + ':';
+    while (!status.atEnd()) {
+        QByteArray line = status.readLine();
+        if (line.startsWith(prefix)) {
+            return line.mid(prefix.size()).simplified().split(' ').value(0).toLongLong();
+        }
+    }
+    return -1;
+}
+
+class MeshHarness {
+public:
+    struct Options {
+        int nodeCount;
+        int basePort;
+        QString topology;
+        int degree;
+        quint32 seed;
+        QString binary;
+        double convergeTimeoutSec;
+        double durationSec;
+        double rate;
+        int payloadSize;
+        double drainSec;
+        int restarts;
+        double reconvergeTimeoutSec;
+        bool keep;
+        bool json;
+    };
+
+    struct ChurnRound {
+        QString nodeId;
+        qint64 withdrawalMs;  // Kill until no node routes to it (-1: timed out)
+        qint64 rejoinMs;  // Restart until every node routes to every other (-1: timed out)
+    };
+
+    static const int POLL_INTERVAL = 500;  // Between dump-routes sweeps
+    static const int REPLY_TIMEOUT = 5000;
+    static const int CONNECT_TIMEOUT = 30000;
+
+    explicit MeshHarness(const Options& opts)
+        : options(opts), nextRequestId(1), failedSends(0), convergenceMs(-1),
+          randomSource(opts.seed) {}
+
+    ~MeshHarness() {
+        shutdown();
+        qDeleteAll(nodes);
+    }
+
+    bool launch() {
+        if (!workDir.isValid()) {
+            qDebug() << "Cannot create a working directory";
+            return false;
+        }
+        workDir.setAutoRemove(!options.keep);
+
+        topology = MeshTopology::build(options.topology, options.nodeCount, options.degree, options.seed);
+        for (int i = 0; i < options.nodeCount; ++i) {
+            MeshNode* node = new MeshNode();
+            node->index = i;
+            node->port = options.basePort + i;
+            node->socketPath = workDir.filePath(QString("node%1.sock").arg(node->port));
+            nodes.append(node);
+        }
+
+        qDebug().noquote() << QString("[MESH] Launching %1 nodes (%2, %3 links) in %4")
+                                  .arg(options.nodeCount).arg(options.topology)
+                                  .arg(MeshTopology::linkCount(topology)).arg(workDir.path());
+        clock.start();
+        for (MeshNode* node : nodes) {
+            if (!startNode(node)) {
+                return false;
+            }
+        }
+        return connectNodes(nodes);
+    }
+
+    bool waitForConvergence() {
+        convergenceMs = waitFor([this]() { return fullyConverged(); }, clock, options.convergeTimeoutSec);
+        if (convergenceMs < 0) {
+            qDebug().noquote() << QString("[MESH] No convergence within %1 s").arg(options.convergeTimeoutSec);
+            return false;
+        }
+        qDebug().noquote() << QString("[MESH] Converged after %1 s").arg(convergenceMs / 1000.0, 0, 'f', 2);
+        return true;
+    }
+
+    void runTraffic() {
+        qDebug().noquote() << QString("[MESH] Traffic: %1 private messages/s for %2 s")
+                                  .arg(options.rate).arg(options.durationSec);
+        QElapsedTimer phase;
+        phase.start();
+        double credit = 0.0;
+        qint64 lastTickNs = 0;
+        while (phase.elapsed() < options.durationSec * 1000) {
+            qint64 nowNs = phase.nsecsElapsed();
+            credit += options.rate * (nowNs - lastTickNs) / 1e9;
+            lastTickNs = nowNs;
+            while (credit >= 1.0) {
+                sendOne();
+                credit -= 1.0;
+            }
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 5);
+        }
+
+        // Let ACK retransmits finish what they can
+        QElapsedTimer drain;
+        drain.start();
+        while (drain.elapsed() < options.drainSec * 1000) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        }
+        earlyDeliveries.clear();
+    }
+
+    void runChurn() {
+        for (int round = 0; round < options.restarts; ++round) {
+            MeshNode* victim = nodes[static_cast<int>(randomSource.bounded(static_cast<int>(nodes.size())))];
+            ChurnRound result;
+            result.nodeId = victim->nodeId;
+            result.rejoinMs = -1;
+
+            qDebug().noquote() << QString("[MESH] Round %1: killing %2").arg(round + 1).arg(victim->nodeId);
+            victim->control->abort();
+            victim->process->kill();
+            victim->process->waitForFinished(5000);
+
+            QElapsedTimer down;
+            down.start();
+            QString victimId = victim->nodeId;
+            result.withdrawalMs = waitFor([this, victimId]() { return withdrawn(victimId); },
+                                          down, options.reconvergeTimeoutSec);
+
+            // Same port and data directory, so the node warm-starts as it would after a crash
+            QElapsedTimer up;
+            up.start();
+            victim->restarts++;
+            if (startNode(victim) && connectNodes(QList<MeshNode*>() << victim)) {
+                result.rejoinMs = waitFor([this]() { return fullyConverged(); }, up, options.reconvergeTimeoutSec);
+            }
+            qDebug().noquote() << QString("[MESH] Round %1: withdrawn in %2 ms, rejoined in %3 ms")
+                                      .arg(round + 1).arg(result.withdrawalMs).arg(result.rejoinMs);
+            churnRounds.append(result);
+        }
+    }
+
+    void collect() {
+        for (MeshNode* node : nodes) {
+            request(node, QJsonObject{{"cmd", "stats"}}, [node](const QJsonObject& reply) {
+                node->traffic = reply.value("traffic").toObject();
+            });
+        }
+        waitForReplies(REPLY_TIMEOUT);
+
+        for (MeshNode* node : nodes) {
+            qint64 pid = node->process ? node->process->processId() : 0;
+            node->rssKb = readProcStatusKb(pid, "VmRSS");
+            node->peakRssKb = readProcStatusKb(pid, "VmHWM");
+        }
+    }
+
+    void report() const {
+        DeliveryStats::Summary summary = stats.summarize();
+        double deliveryRatio = summary.expected > 0 ? static_cast<double>(summary.delivered) / summary.expected : 0.0;
+
+        QJsonArray nodeReports;
+        double sentTotal = 0.0;
+        double receivedTotal = 0.0;
+        double sentMax = 0.0;
+        double receivedMax = 0.0;
+        double rssTotalKb = 0.0;
+        qint64 rssMaxKb = -1;
+        qint64 peakMaxKb = -1;
+        for (const MeshNode* node : nodes) {
+            double sent = node->traffic.value("datagramsSent").toDouble();
+            double received = node->traffic.value("datagramsReceived").toDouble();
+            sentTotal += sent;
+            receivedTotal += received;
+            sentMax = qMax(sentMax, sent);
+            receivedMax = qMax(receivedMax, received);
+            rssTotalKb += qMax<qint64>(0, node->rssKb);
+            rssMaxKb = qMax(rssMaxKb, node->rssKb);
+            peakMaxKb = qMax(peakMaxKb, node->peakRssKb);
+
+            QJsonObject entry = node->traffic;
+            entry["nodeId"] = node->nodeId;
+            entry["port"] = node->port;
+            entry["neighbours"] = static_cast<int>(topology[node->index].size());
+            entry["restarts"] = node->restarts;
+            entry["rssKb"] = static_cast<double>(node->rssKb);
+            entry["peakRssKb"] = static_cast<double>(node->peakRssKb);
+            nodeReports.append(entry);
+        }
+        int count = static_cast<int>(nodes.size());
+
+        QTextStream out(stdout);
+        if (options.json) {
+            QJsonObject json;
+            json["nodes"] = options.nodeCount;
+            json["topology"] = options.topology;
+            json["links"] = MeshTopology::linkCount(topology);
+            json["seed"] = static_cast<double>(options.seed);
+            json["convergenceMs"] = static_cast<double>(convergenceMs);
+            QJsonObject traffic = summary.toJson();
+            traffic["durationSec"] = options.durationSec;
+            traffic["rate"] = options.rate;
+            traffic["failedSends"] = failedSends;
+            traffic["deliveryRatio"] = deliveryRatio;
+            json["traffic"] = traffic;
+            QJsonArray churn;
+            for (const ChurnRound& round : churnRounds) {
+                QJsonObject entry;
+                entry["nodeId"] = round.nodeId;
+                entry["withdrawalMs"] = static_cast<double>(round.withdrawalMs);
+                entry["rejoinMs"] = static_cast<double>(round.rejoinMs);
+                churn.append(entry);
+            }
+            json["churn"] = churn;
+            json["perNode"] = nodeReports;
+            out << QJsonDocument(json).toJson(QJsonDocument::Indented);
+            return;
+        }
+
+        out << "=== SimpleChat mesh harness ===\n";
+        out << QString("Nodes:        %1 processes (%2, %3 links, seed %4)\n")
+                   .arg(options.nodeCount).arg(options.topology).arg(MeshTopology::linkCount(topology)).arg(options.seed);
+        out << QString("Convergence:  %1\n")
+                   .arg(convergenceMs < 0 ? QString("timed out") : QString("%1 s").arg(convergenceMs / 1000.0, 0, 'f', 2));
+        out << QString("Delivery:     %1 / %2 (%3%), %4 failed sends\n")
+                   .arg(summary.delivered).arg(summary.expected).arg(deliveryRatio * 100.0, 0, 'f', 2).arg(failedSends);
+        out << QString("Latency (ms): p50 %1  p99 %2  max %3\n")
+                   .arg(summary.p50Ms, 0, 'f', 2).arg(summary.p99Ms, 0, 'f', 2).arg(summary.maxMs, 0, 'f', 2);
+        out << QString("Datagrams:    sent per node mean %1 max %2; received per node mean %3 max %4\n")
+                   .arg(sentTotal / count, 0, 'f', 0).arg(sentMax, 0, 'f', 0)
+                   .arg(receivedTotal / count, 0, 'f', 0).arg(receivedMax, 0, 'f', 0);
+        if (rssMaxKb >= 0) {
+            out << QString("RSS (MB):     mean %1  max %2  peak %3\n")
+                       .arg(rssTotalKb / count / 1024.0, 0, 'f', 1).arg(rssMaxKb / 1024.0, 0, 'f', 1)
+                       .arg(peakMaxKb / 1024.0, 0, 'f', 1);
+        }
+        for (const ChurnRound& round : churnRounds) {
+            out << QString("Churn:        %1 withdrawn in %2, rejoined in %3\n").arg(round.nodeId)
+                       .arg(round.withdrawalMs < 0 ? QString("(timed out)") : QString("%1 s").arg(round.withdrawalMs / 1000.0, 0, 'f', 2))
+                       .arg(round.rejoinMs < 0 ? QString("(timed out)") : QString("%1 s").arg(round.rejoinMs / 1000.0, 0, 'f', 2));
+        }
+    }
+
+    void shutdown() {
+        for (MeshNode* node : nodes) {
+            if (node->control) {
+                node->control->abort();
+            }
+            if (node->process && node->process->state() != QProcess::NotRunning) {
+                node->process->terminate();  // SIGTERM: the daemon flushes its log and exits
+            }
+        }
+        for (MeshNode* node : nodes) {
+            if (node->process && !node->process->waitForFinished(3000)) {
+                node->process->kill();
+                node->process->waitForFinished(1000);
+            }
+            delete node->control;
+            delete node->process;
+            node->control = nullptr;
+            node->process = nullptr;
+        }
+    }
+
+private:
+    bool startNode(MeshNode* node) {
+        QStringList peerPorts;
+        for (int neighbour : topology[node->index]) {
+            peerPorts << QString::number(options.basePort + neighbour);
+        }
+
+        QString dataDir = workDir.filePath(QString("node%1").arg(node->port));
+        QStringList arguments;
+        arguments << "--headless" << "-p" << QString::number(node->port) << "--peers" << peerPorts.join(',')
+                  << "--data-dir" << dataDir << "--control-socket" << node->socketPath
+                  << "--log-file" << dataDir + ".log";
+
+        if (!node->process) {
+            node->process = new QProcess();
+            node->process->setStandardInputFile(QProcess::nullDevice());
+            node->process->setStandardOutputFile(QProcess::nullDevice());
+            node->process->setStandardErrorFile(QProcess::nullDevice());
+        }
+        node->process->start(options.binary, arguments);
+        if (!node->process->waitForStarted(5000)) {
+            qDebug().noquote() << QString("[MESH] Cannot start %1: %2").arg(options.binary, node->process->errorString());
+            return false;
+        }
+        return true;
+    }
+
+    // Connect the control sockets, subscribe to deliveries and learn each node's ID
+    bool connectNodes(const QList<MeshNode*>& targets) {
+        QList<MeshNode*> waiting = targets;
+        QElapsedTimer timer;
+        timer.start();
+        while (!waiting.isEmpty() && timer.elapsed() < CONNECT_TIMEOUT) {
+            for (auto it = waiting.begin(); it != waiting.end();) {
+                if (tryConnect(*it)) {
+                    it = waiting.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        }
+        if (!waiting.isEmpty()) {
+            qDebug().noquote() << QString("[MESH] %1 control sockets did not come up").arg(waiting.size());
+            return false;
+        }
+
+        for (MeshNode* node : targets) {
+            request(node, QJsonObject{{"cmd", "subscribe"}}, ReplyHandler());
+            request(node, QJsonObject{{"cmd", "stats"}}, [node](const QJsonObject& reply) {
+                node->nodeId = reply.value("nodeId").toString();
+            });
+        }
+        return waitForReplies(REPLY_TIMEOUT);
+    }
+
+    bool tryConnect(MeshNode* node) {
+        if (!QFile::exists(node->socketPath)) {
+            return false;  // Daemon not listening yet
+        }
+        if (!node->control) {
+            node->control = new QLocalSocket();
+            QObject::connect(node->control, &QLocalSocket::readyRead, [this, node]() { onControlData(node); });
+        }
+        node->control->abort();
+        node->buffer.clear();
+        node->pending.clear();
+        node->control->connectToServer(node->socketPath);
+        return node->control->waitForConnected(200);
+    }
+
+    void request(MeshNode* node, QJsonObject command, const ReplyHandler& handler) {
+        if (!node->isConnected()) {
+            return;
+        }
+        int id = nextRequestId++;
+        command["id"] = id;
+        node->pending.insert(id, handler);
+        node->control->write(QJsonDocument(command).toJson(QJsonDocument::Compact) + '\n');
+    }
+
+    bool waitForReplies(int timeoutMs) {
+        QElapsedTimer timer;
+        timer.start();
+        while (timer.elapsed() < timeoutMs) {
+            bool outstanding = false;
+            for (const MeshNode* node : nodes) {
+                if (node->isConnected() && !node->pending.isEmpty()) {
+                    outstanding = true;
+                    break;
+                }
+            }
+            if (!outstanding) {
+                return true;
+            }
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        }
+        return false;
+    }
+
+    void onControlData(MeshNode* node) {
+        node->buffer += node->control->readAll();
+        int newline;
+        while ((newline = node->buffer.indexOf('\n')) >= 0) {
+            QJsonObject line = QJsonDocument::fromJson(node->buffer.left(newline)).object();
+            node->buffer.remove(0, newline + 1);
+
+            if (line.value("event").toString() == "delivered") {
+                onDelivered(node, line.value("messageId").toString());
+                continue;
+            }
+            ReplyHandler handler = node->pending.take(line.value("id").toInt());
+            if (handler) {
+                handler(line);
+            }
+        }
+    }
+
+    void onDelivered(MeshNode* node, const QString& messageId) {
+        qint64 now = clock.nsecsElapsed();
+        if (sentIds.contains(messageId)) {
+            stats.recordDelivery(messageId, node->nodeId, now);
+        } else {
+            // Delivered before the sender's reply gave us the ID; matched up in sendOne()
+            earlyDeliveries[messageId].append(qMakePair(node->nodeId, now));
+        }
+    }
+
+    void sendOne() {
+        int count = static_cast<int>(nodes.size());
+        int sender = static_cast<int>(randomSource.bounded(count));
+        int receiver = static_cast<int>(randomSource.bounded(count - 1));
+        if (receiver >= sender) {
+            receiver++;
+        }
+
+        qint64 sentAt = clock.nsecsElapsed();
+        QJsonObject command{{"cmd", "send"}, {"dest", nodes[receiver]->nodeId},
+                            {"text", QString(options.payloadSize, QChar('x'))}};
+        request(nodes[sender], command, [this, sentAt](const QJsonObject& reply) {
+            QString messageId = reply.value("messageId").toString();
+            if (messageId.isEmpty()) {
+                failedSends++;
+                return;
+            }
+            stats.recordSend(messageId, false, 1, sentAt);
+            sentIds.insert(messageId);
+            for (const QPair<QString, qint64>& early : earlyDeliveries.take(messageId)) {
+                stats.recordDelivery(messageId, early.first, early.second);
+            }
+        });
+    }
+
+    // Refresh every reachable node's route set
+    void pollRoutes() {
+        for (MeshNode* node : nodes) {
+            request(node, QJsonObject{{"cmd", "dump-routes"}}, [node](const QJsonObject& reply) {
+                node->reachable.clear();
+                for (const QJsonValue& value : reply.value("routes").toArray()) {
+                    QJsonObject route = value.toObject();
+                    if (route.value("reachable").toBool()) {
+                        node->reachable.insert(route.value("dest").toString());
+                    }
+                }
+            });
+        }
+        waitForReplies(REPLY_TIMEOUT);
+    }
+
+    // Every running node has a reachable route to every other running node
+    bool fullyConverged() const {
+        for (const MeshNode* node : nodes) {
+            if (!node->isConnected()) {
+                continue;
+            }
+            for (const MeshNode* other : nodes) {
+                if (other != node && other->isConnected() && !node->reachable.contains(other->nodeId)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool withdrawn(const QString& nodeId) const {
+        for (const MeshNode* node : nodes) {
+            if (node->isConnected() && node->reachable.contains(nodeId)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Poll until the predicate holds; milliseconds since `since`, or -1 on timeout
+    qint64 waitFor(const std::function<bool()>& predicate, const QElapsedTimer& since, double timeoutSec) {
+        while (since.elapsed() < timeoutSec * 1000) {
+            pollRoutes();
+            if (predicate()) {
+                return since.elapsed();
+            }
+            QElapsedTimer pause;
+            pause.start();
+            while (pause.elapsed() < POLL_INTERVAL) {
+                QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+            }
+        }
+        return -1;
+    }
+
+    Options options;
+    QTemporaryDir workDir;
+    MeshTopology::Adjacency topology;
+    QList<MeshNode*> nodes;
+    int nextRequestId;
+    QElapsedTimer clock;
+
+    DeliveryStats stats;
+    QSet<QString> sentIds;
+    QHash<QString, QList<QPair<QString, qint64>>> earlyDeliveries;
+    int failedSends;
+    qint64 convergenceMs;
+    QList<ChurnRound> churnRounds;
+    QRandomGenerator randomSource;
+};
+
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("simplechat_meshharness");
+    QCoreApplication::setApplicationVersion("3.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Multi-process mesh harness for headless SimpleChat nodes");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption nodesOption("nodes", "Number of node processes", "n", "10");
+    QCommandLineOption basePortOption("base-port", "First UDP port; nodes use consecutive ports", "port", "48000");
+    QCommandLineOption topologyOption("topology", "line, ring, grid or random", "shape", "ring");
+    QCommandLineOption degreeOption("degree", "Mean neighbour count for the random topology", "k", "4");
+    QCommandLineOption seedOption("seed", "Seed for the random topology, traffic and churn", "seed", "1");
+    QCommandLineOption binaryOption("binary", "Headless node executable", "path",
+                                    QDir(QCoreApplication::applicationDirPath()).filePath("../SimpleChat_PA3_headless"));
+    QCommandLineOption convergeOption("converge-timeout", "Max seconds to wait for initial convergence", "sec", "120");
+    QCommandLineOption durationOption("duration", "Seconds of traffic", "sec", "20");
+    QCommandLineOption rateOption("rate", "Private messages per second across the mesh", "rate", "50");
+    QCommandLineOption payloadOption("payload", "Message size in bytes", "bytes", "64");
+    QCommandLineOption drainOption("drain", "Seconds to wait for stragglers after the traffic stops", "sec", "5");
+    QCommandLineOption restartsOption("restarts", "Kill/restart rounds after the traffic phase", "n", "1");
+    QCommandLineOption reconvergeOption("reconverge-timeout", "Max seconds per withdrawal or rejoin", "sec", "120");
+    QCommandLineOption keepOption("keep", "Keep the working directory (node logs and data)");
+    QCommandLineOption jsonOption("json", "Print the report as JSON");
+    parser.addOptions({nodesOption, basePortOption, topologyOption, degreeOption, seedOption, binaryOption,
+                       convergeOption, durationOption, rateOption, payloadOption, drainOption, restartsOption,
+                       reconvergeOption, keepOption, jsonOption});
+    parser.process(app);
+
+    MeshHarness::Options options;
+    options.nodeCount = qMax(2, parser.value(nodesOption).toInt());
+    options.basePort = parser.value(basePortOption).toInt();
+    options.topology = parser.value(topologyOption);
+    options.degree = qMax(1, parser.value(degreeOption).toInt());
+    options.seed = parser.value(seedOption).toUInt();
+    options.binary = parser.value(binaryOption);
+    options.convergeTimeoutSec = parser.value(convergeOption).toDouble();
+    options.durationSec = parser.value(durationOption).toDouble();
+    options.rate = qMax(0.0, parser.value(rateOption).toDouble());
+    options.payloadSize = qBound(1, parser.value(payloadOption).toInt(), 8000);
+    options.drainSec = parser.value(drainOption).toDouble();
+    options.restarts = qMax(0, parser.value(restartsOption).toInt());
+    options.reconvergeTimeoutSec = parser.value(reconvergeOption).toDouble();
+    options.keep = parser.isSet(keepOption);
+    options.json = parser.isSet(jsonOption);
+
+    if (!MeshTopology::isKnownKind(options.topology)) {
+        std::fprintf(stderr, "Unknown topology '%s'\n", qPrintable(options.topology));
+        return 1;
+    }
+    if (options.basePort < 1024 || options.basePort + options.nodeCount - 1 > 65535) {
+        std::fprintf(stderr, "Ports %d-%d are out of range\n", options.basePort, options.basePort + options.nodeCount - 1);
+        return 1;
+    }
+    if (!QFileInfo(options.binary).isExecutable()) {
+        std::fprintf(stderr, "Headless node binary not found: %s (use --binary)\n", qPrintable(options.binary));
+        return 1;
+    }
+
+    MeshHarness harness(options);
+    if (!harness.launch()) {
+        return 1;
+    }
+
+    // A mesh that never converges is reported too, with exit status 2
+    bool converged = harness.waitForConvergence();
+    if (converged) {
+        harness.runTraffic();
+        harness.runChurn();
+    }
+    harness.collect();
+    harness.report();
+    harness.shutdown();
+    return converged ? 0 : 2;
+}
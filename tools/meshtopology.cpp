@@ -0,0 +1,103 @@
+#include "meshtopology.h"
+#include <QRandomGenerator>
+#include <QSet>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+void link(QVector<QSet<int>>& neighbours, int a, int b) {
+    if (a != b) {
+        neighbours[a].insert(b);
+        neighbours[b].insert(a);
+    }
+}
+
+}
+
+bool MeshTopology::isKnownKind(const QString& kind) {
+    return kind == "line" || kind == "ring" || kind == "grid" || kind == "random";
+}
+
+MeshTopology::Adjacency MeshTopology::build(const QString& kind, int nodeCount, int meanDegree, quint32 seed) {
+    QVector<QSet<int>> neighbours(qMax(0, nodeCount));
+
+    if (kind == "grid") {
+        int columns = qMax(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(nodeCount)))));
+        for (int i = 0; i < nodeCount; ++i) {
+            if ((i + 1) % columns != 0 && i + 1 < nodeCount) {
+                link(neighbours, i, i + 1);
+            }
+            if (i + columns < nodeCount) {
+                link(neighbours, i, i + columns);
+            }
+        }
+    } else if (kind == "random") {
+        QRandomGenerator random(seed);
+
+        // Spanning tree first so the graph is connected whatever the degree
+        for (int i = 1; i < nodeCount; ++i) {
+            link(neighbours, i, static_cast<int>(random.bounded(i)));
+        }
+
+        int targetLinks = qMin(nodeCount * qMax(2, meanDegree) / 2, nodeCount * (nodeCount - 1) / 2);
+        int links = nodeCount - 1;
+        int attempts = 0;
+        while (links < targetLinks && attempts < targetLinks * 20) {
+            attempts++;
+            int a = static_cast<int>(random.bounded(nodeCount));
+            int b = static_cast<int>(random.bounded(nodeCount));
+            if (a != b && !neighbours[a].contains(b)) {
+                link(neighbours, a, b);
+                links++;
+            }
+        }
+    } else {
+        for (int i = 0; i + 1 < nodeCount; ++i) {
+            link(neighbours, i, i + 1);
+        }
+        if (kind == "ring" && nodeCount > 2) {
+            link(neighbours, nodeCount - 1, 0);
+        }
+    }
+
+    Adjacency adjacency(neighbours.size());
+    for (int i = 0; i < neighbours.size(); ++i) {
+        for (int neighbour : neighbours[i]) {
+            adjacency[i].append(neighbour);
+        }
+        std::sort(adjacency[i].begin(), adjacency[i].end());
+    }
+    return adjacency;
+}
+
+bool MeshTopology::isConnected(const Adjacency& adjacency) {
+    if (adjacency.isEmpty()) {
+        return true;
+    }
+
+    QVector<bool> seen(adjacency.size(), false);
+    QVector<int> frontier;
+    frontier.append(0);
+    seen[0] = true;
+    int reached = 1;
+    while (!frontier.isEmpty()) {
+        int node = frontier.takeLast();
+        for (int neighbour : adjacency[node]) {
+            if (!seen[neighbour]) {
+                seen[neighbour] = true;
+                reached++;
+                frontier.append(neighbour);
+            }
+        }
+    }
+    return reached == adjacency.size();
+}
+
+int MeshTopology::linkCount(const Adjacency& adjacency) {
+    int ends = 0;
+    for (const QVector<int>& neighbours : adjacency) {
+        ends += static_cast<int>(neighbours.size());
+    }
+    return ends / 2;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+// Neighbour lists for the mesh harness. Nodes are numbered 0..n-1; every
+// topology is symmetric (a links b iff b links a) and connected.
+class MeshTopology {
+public:
+    typedef QVector<QVector<int>> Adjacency;
+
+    // line, ring, grid (4-neighbour, ceil(sqrt(n)) columns) or random
+    // (a random spanning tree plus extra links up to the given mean degree)
+    static Adjacency build(const QString& kind, int nodeCount, int meanDegree, quint32 seed);
+    static bool isKnownKind(const QString& kind);
+
+    static bool isConnected(const Adjacency& adjacency);
+    static int linkCount(const Adjacency& adjacency);
+};
@@ -0,0 +1,221 @@
+// simplechat_replay: feeds a capture (written by --capture, or tcpdump of
+// SimpleChat traffic) back through NetworkManager's receive path and reports
+// how long each datagram took to process, by message type.
+//
+//   ./build/tools/simplechat_replay node1.pcap                 # as fast as possible
+//   ./build/tools/simplechat_replay node1.pcap --speed 1       # original timing
+//   ./build/tools/simplechat_replay node1.pcap --json > a.json # compare builds
+//
+// Replay is offline: replies are built and counted but never sent. The
+// node's clock is pinned to each datagram's capture time and its random
+// choices (fanout, peer picks) come from a fixed --seed, so at full speed two
+// runs take the same decisions on the same input. What still differs from
+// the original run: timer-driven work (ACK retries, peer timeouts, gossip and
+// anti-entropy rounds, route expiry sweeps) never runs at full speed, and at
+// --speed it fires on real time and so depends on how fast the host is.
+// Only delivery-trace and event-trace timestamps use the real clock.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QMap>
+#include <algorithm>
+#include <cstdio>
+#include "networkmanager.h"
+#include "nodeconfig.h"
+#include "packetcapture.h"
+#include "deliverystats.h"
+
+namespace {
+
+bool verboseLogging = false;
+
+void filterLog(QtMsgType type, const QMessageLogContext&, const QString& text) {
+    // Per-message [RECV]/[FORWARD] lines would swamp the timing
+    if (type == QtDebugMsg && !verboseLogging) {
+        return;
+    }
+    std::fprintf(stderr, "%s\n", qPrintable(text));
+}
+
+// Per-datagram processing times for one message type
+struct TypeTiming {
+    QVector<qint64> samplesNs;
+    qint64 totalNs;
+
+    TypeTiming() : totalNs(0) {}
+
+    QJsonObject toJson(const QString& name) const {
+        QVector<qint64> sorted = samplesNs;
+        std::sort(sorted.begin(), sorted.end());
+        QJsonObject json;
+        json["type"] = name;
+        json["count"] = static_cast<int>(sorted.size());
+        json["totalUs"] = totalNs / 1000.0;
+        json["meanUs"] = sorted.isEmpty() ? 0.0 : totalNs / 1000.0 / sorted.size();
+        json["p50Us"] = DeliveryStats::percentile(sorted, 0.50) / 1000.0;
+        json["p99Us"] = DeliveryStats::percentile(sorted, 0.99) / 1000.0;
+        json["maxUs"] = sorted.isEmpty() ? 0.0 : sorted.last() / 1000.0;
+        return json;
+    }
+};
+
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("simplechat_replay");
+    QCoreApplication::setApplicationVersion("3.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replay a SimpleChat packet capture through NetworkManager");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("capture", "pcap file to replay");
+
+    QCommandLineOption portOption("port", "Replay datagrams sent to this port (default: the first one's)", "port");
+    QCommandLineOption nodeIdOption("node-id", "Identity of the replaying node (default: derived from the port)", "id");
+    QCommandLineOption speedOption("speed", "max, or a factor of the original timing (1 = real time)", "speed", "max");
+    QCommandLineOption jsonOption("json", "Print the report as JSON");
+    QCommandLineOption verboseOption("verbose", "Keep the node's debug logging");
+    QCommandLineOption seedOption("seed", "Seed for the node's random choices", "seed", "1");
+    parser.addOptions({portOption, nodeIdOption, speedOption, jsonOption, verboseOption, seedOption});
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+    QString capturePath = parser.positionalArguments().first();
+
+    double speed = 0.0;  // 0 = as fast as possible
+    if (parser.value(speedOption) != "max") {
+        bool ok = false;
+        speed = parser.value(speedOption).toDouble(&ok);
+        if (!ok || speed <= 0.0) {
+            std::fprintf(stderr, "Bad --speed '%s'\n", qPrintable(parser.value(speedOption)));
+            return 1;
+        }
+    }
+    verboseLogging = parser.isSet(verboseOption);
+    qInstallMessageHandler(filterLog);
+
+    PacketCaptureReader reader;
+    if (!reader.open(capturePath)) {
+        std::fprintf(stderr, "Cannot read %s: %s\n", qPrintable(capturePath), qPrintable(reader.errorString()));
+        return 1;
+    }
+
+    PacketCapture::Record record;
+    if (!reader.next(&record)) {
+        std::fprintf(stderr, "%s holds no UDP datagrams\n", qPrintable(capturePath));
+        return 1;
+    }
+
+    int port = parser.isSet(portOption) ? parser.value(portOption).toInt() : record.receiverPort;
+    QString nodeId = parser.isSet(nodeIdOption) ? parser.value(nodeIdOption) : NodeConfig::nodeIdForPort(port);
+
+    NetworkManager node;
+    node.setNodeId(nodeId);
+    node.setTransmitEnabled(false);
+    node.setPacketLogging(verboseLogging);
+    node.setRandomSeed(parser.value(seedOption).toUInt());
+    int deliveries = 0;
+    QObject::connect(&node, &NetworkManager::messageReceived, [&deliveries](const Message&) { deliveries++; });
+
+    QMap<QString, TypeTiming> timings;
+    TypeTiming overall;
+    int filtered = 0;
+    qint64 firstTimestampNs = record.timestampNs;
+    qint64 lastTimestampNs = record.timestampNs;
+
+    QElapsedTimer wall;
+    wall.start();
+    QElapsedTimer timer;
+    do {
+        if (record.receiverPort != port) {
+            filtered++;
+            continue;
+        }
+        lastTimestampNs = record.timestampNs;
+
+        // Original timing: hold each datagram until its offset (scaled) has elapsed
+        if (speed > 0.0) {
+            qint64 dueNs = static_cast<qint64>((record.timestampNs - firstTimestampNs) / speed);
+            while (wall.nsecsElapsed() < dueNs) {
+                int remainingMs = static_cast<int>((dueNs - wall.nsecsElapsed()) / 1000000);
+                QCoreApplication::processEvents(QEventLoop::AllEvents, qMax(0, remainingMs));
+            }
+        }
+
+        QString type = Message::typeName(Message::fromDatagram(record.datagram).getType());
+        setReplayClockMs(record.timestampNs / 1000000);
+        timer.start();
+        node.injectDatagram(record.datagram, record.senderHost, record.senderPort);
+        qint64 elapsedNs = timer.nsecsElapsed();
+
+        TypeTiming& timing = timings[type];
+        timing.samplesNs.append(elapsedNs);
+        timing.totalNs += elapsedNs;
+        overall.samplesNs.append(elapsedNs);
+        overall.totalNs += elapsedNs;
+    } while (reader.next(&record));
+    qint64 wallNs = wall.nsecsElapsed();
+    setReplayClockMs(0);
+
+    int replayed = static_cast<int>(overall.samplesNs.size());
+    TrafficStats traffic = node.getTrafficStats();
+    QJsonObject json;
+    json["capture"] = capturePath;
+    json["nodeId"] = nodeId;
+    json["port"] = port;
+    json["speed"] = speed > 0.0 ? QJsonValue(speed) : QJsonValue("max");
+    json["replayed"] = replayed;
+    json["otherPorts"] = filtered;
+    json["skippedPackets"] = static_cast<double>(reader.skippedPackets());
+    json["captureSpanSec"] = (lastTimestampNs - firstTimestampNs) / 1e9;
+    json["wallSec"] = wallNs / 1e9;
+    json["datagramsPerSec"] = overall.totalNs > 0 ? replayed / (overall.totalNs / 1e9) : 0.0;
+    json["repliesBuilt"] = static_cast<double>(traffic.datagramsSent);
+    json["deliveries"] = deliveries;
+    json["routes"] = node.getRoutingTable().size();
+    json["storedMessages"] = node.getStoreStats().liveMessages;
+    json["processing"] = overall.toJson("ALL");
+    QJsonArray byType;
+    for (auto it = timings.constBegin(); it != timings.constEnd(); ++it) {
+        byType.append(it.value().toJson(it.key()));
+    }
+    json["byType"] = byType;
+
+    QTextStream out(stdout);
+    if (parser.isSet(jsonOption)) {
+        out << QJsonDocument(json).toJson(QJsonDocument::Indented);
+        return 0;
+    }
+
+    QJsonObject processing = json["processing"].toObject();
+    out << "=== SimpleChat capture replay ===\n";
+    out << QString("Capture:      %1 (%2 datagrams to port %3 as %4; %5 to other ports, %6 non-UDP skipped)\n")
+               .arg(capturePath).arg(replayed).arg(port).arg(nodeId).arg(filtered).arg(reader.skippedPackets());
+    out << QString("Timing:       %1 s captured, replayed in %2 s at %3 speed\n")
+               .arg(json["captureSpanSec"].toDouble(), 0, 'f', 2).arg(json["wallSec"].toDouble(), 0, 'f', 2)
+               .arg(speed > 0.0 ? QString("%1x").arg(speed) : QString("max"));
+    out << QString("Processing:   %1 datagrams/s; per datagram mean %2 us  p50 %3 us  p99 %4 us  max %5 us\n")
+               .arg(json["datagramsPerSec"].toDouble(), 0, 'f', 0).arg(processing["meanUs"].toDouble(), 0, 'f', 2)
+               .arg(processing["p50Us"].toDouble(), 0, 'f', 2).arg(processing["p99Us"].toDouble(), 0, 'f', 2)
+               .arg(processing["maxUs"].toDouble(), 0, 'f', 2);
+    out << QString("Effects:      %1 replies built (not sent), %2 deliveries, %3 routes, %4 stored messages\n")
+               .arg(traffic.datagramsSent).arg(deliveries).arg(json["routes"].toInt()).arg(json["storedMessages"].toInt());
+    out << "By type:\n";
+    for (const QJsonValue& value : byType) {
+        QJsonObject entry = value.toObject();
+        out << QString("  %1 %2 x  mean %3 us  p99 %4 us  total %5 ms\n")
+                   .arg(entry["type"].toString(), -22).arg(entry["count"].toInt(), 7)
+                   .arg(entry["meanUs"].toDouble(), 8, 'f', 2).arg(entry["p99Us"].toDouble(), 8, 'f', 2)
+                   .arg(entry["totalUs"].toDouble() / 1000.0, 0, 'f', 2);
+    }
+    return 0;
+}
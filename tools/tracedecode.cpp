@@ -0,0 +1,166 @@
+// simplechat_tracedecode: turns --trace files (EventTrace snapshots) into
+// readable text or Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+//
+//   ./build/tools/simplechat_tracedecode node1.trace
+//   ./build/tools/simplechat_tracedecode node*.trace --chrome > mesh.json
+//
+// Several files are merged on wall-clock time, one process row per node.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <algorithm>
+#include <cstdio>
+#include "eventtrace.h"
+#include "message.h"
+
+namespace {
+
+struct DecodedEvent {
+    qint64 epochNs;
+    int file;
+    TraceEvent event;
+};
+
+QString nodeName(const EventTrace::Snapshot& trace, quint16 index) {
+    if (index == EventTrace::NO_NODE) {
+        return QString();
+    }
+    return index < trace.nodes.size() ? trace.nodes[index] : QString("#%1").arg(index);
+}
+
+QString describe(const EventTrace::Snapshot& trace, const TraceEvent& event) {
+    QString node = nodeName(trace, event.node);
+    QString peer = nodeName(trace, event.peer);
+    QString type = Message::typeName(static_cast<Message::MessageType>(event.value));
+    switch (event.event) {
+    case EventTrace::SEND:
+        return QString("%1 to %2 seq %3").arg(type, node).arg(event.sequence);
+    case EventTrace::RECEIVE:
+        return QString("%1 from %2 seq %3").arg(type, node).arg(event.sequence);
+    case EventTrace::FORWARD:
+        return QString("to %1 via %2 seq %3 hop-limit %4").arg(node, peer).arg(event.sequence).arg(event.value);
+    case EventTrace::DROP_HOP_LIMIT:
+    case EventTrace::DROP_NO_ROUTE:
+        return QString("to %1 seq %2").arg(node).arg(event.sequence);
+    case EventTrace::RUMOR_RECEIVED:
+        return QString("route to %1 from %2 seq %3 hop-limit %4").arg(node, peer).arg(event.sequence).arg(event.value);
+    case EventTrace::RUMOR_FORWARDED:
+        return QString("route to %1 to %2 seq %3 hop-limit %4").arg(node, peer).arg(event.sequence).arg(event.value);
+    case EventTrace::ROUTE_CHANGED:
+        return QString("%1 via %2 seq %3 hops %4").arg(node, peer).arg(event.sequence).arg(event.value);
+    case EventTrace::ROUTE_UNREACHABLE:
+        return QString("%1 (was via %2) seq %3").arg(node, peer).arg(event.sequence);
+    default:
+        return QString("node %1 peer %2 seq %3 value %4").arg(node, peer).arg(event.sequence).arg(event.value);
+    }
+}
+
+QJsonObject eventArgs(const EventTrace::Snapshot& trace, const TraceEvent& event) {
+    QJsonObject args;
+    if (event.node != EventTrace::NO_NODE) {
+        args["node"] = nodeName(trace, event.node);
+    }
+    if (event.peer != EventTrace::NO_NODE) {
+        args["peer"] = nodeName(trace, event.peer);
+    }
+    args["seq"] = static_cast<double>(event.sequence);
+    args["value"] = event.value;
+    return args;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("simplechat_tracedecode");
+    QCoreApplication::setApplicationVersion("3.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Decode SimpleChat binary packet-event traces");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("traces", "Trace files written by --trace or the trace control command", "<file>...");
+
+    QCommandLineOption chromeOption("chrome", "Print Chrome trace JSON instead of text");
+    parser.addOption(chromeOption);
+    parser.process(app);
+
+    QStringList paths = parser.positionalArguments();
+    if (paths.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    QList<EventTrace::Snapshot> traces;
+    QVector<DecodedEvent> merged;
+    for (const QString& path : paths) {
+        EventTrace::Snapshot trace;
+        QString error;
+        if (!EventTrace::load(path, &trace, &error)) {
+            std::fprintf(stderr, "Cannot read %s: %s\n", qPrintable(path), qPrintable(error));
+            return 1;
+        }
+        if (trace.overwritten > 0) {
+            std::fprintf(stderr, "%s: %llu older events were overwritten\n", qPrintable(path),
+                         static_cast<unsigned long long>(trace.overwritten));
+        }
+        for (const TraceEvent& event : trace.events) {
+            DecodedEvent decoded;
+            decoded.epochNs = trace.startEpochNs + event.timestampNs;
+            decoded.file = static_cast<int>(traces.size());
+            decoded.event = event;
+            merged.append(decoded);
+        }
+        traces.append(trace);
+    }
+    std::stable_sort(merged.begin(), merged.end(), [](const DecodedEvent& a, const DecodedEvent& b) {
+        return a.epochNs < b.epochNs;
+    });
+
+    QTextStream out(stdout);
+    qint64 originNs = merged.isEmpty() ? 0 : merged.first().epochNs;
+
+    if (parser.isSet(chromeOption)) {
+        QJsonArray events;
+        for (int i = 0; i < traces.size(); ++i) {
+            QJsonObject processName;
+            processName["ph"] = "M";
+            processName["name"] = "process_name";
+            processName["pid"] = i;
+            processName["args"] = QJsonObject{{"name", traces[i].ownerId}};
+            events.append(processName);
+        }
+        for (const DecodedEvent& decoded : merged) {
+            QJsonObject event;
+            event["name"] = EventTrace::eventName(decoded.event.event);
+            event["cat"] = "simplechat";
+            event["ph"] = "i";
+            event["s"] = "t";
+            event["ts"] = (decoded.epochNs - originNs) / 1000.0;  // Microseconds
+            event["pid"] = decoded.file;
+            event["tid"] = 0;
+            event["args"] = eventArgs(traces[decoded.file], decoded.event);
+            events.append(event);
+        }
+        QJsonObject json;
+        json["traceEvents"] = events;
+        json["displayTimeUnit"] = "ns";
+        out << QJsonDocument(json).toJson(QJsonDocument::Compact) << "\n";
+        return 0;
+    }
+
+    for (const DecodedEvent& decoded : merged) {
+        const EventTrace::Snapshot& trace = traces[decoded.file];
+        out << QString("%1 %2 %3 %4 %5\n")
+                   .arg(QDateTime::fromMSecsSinceEpoch(decoded.epochNs / 1000000).toString("HH:mm:ss.zzz"))
+                   .arg((decoded.epochNs - originNs) / 1e6, 12, 'f', 3)
+                   .arg(trace.ownerId, -10)
+                   .arg(QString(EventTrace::eventName(decoded.event.event)), -18)
+                   .arg(describe(trace, decoded.event));
+    }
+    return 0;
+}